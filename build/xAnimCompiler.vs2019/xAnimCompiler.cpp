@@ -1,20 +1,106 @@
-// GeomCompiler.vs2019.cpp : This file contains the 'main' function. Program execution begins and ends there.
-//
+#include "xanim_compiler.h"
+#include <filesystem>
 
-#include <iostream>
+//---------------------------------------------------------------------------------------
 
-int main()
+struct anim_pipeline_compiler : xresource_pipeline::compiler::base
 {
-    std::cout << "Hello World!\n";
-}
+    static constexpr xcore::guid::rcfull<> full_guid_v
+    { .m_Type       = xcore::guid::rctype<>         { "resource.pipeline", "plugin" }
+    , .m_Instance   = xcore::guid::rcinstance<>     { "anim" }
+    };
+
+    virtual xcore::guid::rcfull<> getResourcePipelineFullGuid() const noexcept override
+    {
+        return full_guid_v;
+    }
+
+    virtual xcore::err onCompile( void ) noexcept override
+    {
+        if( auto Err = xanim_compiler::descriptor::Serialize( m_CompilerOptions, m_ResourceDescriptorPathFile.data(), true ); Err )
+            return Err;
+
+        try
+        {
+            m_Compiler->LoadRaw( xcore::string::Fmt( "%s/%s", m_AssetsRootPath.data(), m_CompilerOptions.m_Main.m_AnimAsset.data() ).data() );
+            m_Compiler->Compile( m_CompilerOptions );
+            for( auto& T : m_Target )
+            {
+                if( T.m_bValid ) m_Compiler->Serialize( T.m_DataPath.data() );
+            }
+        }
+        catch( const std::exception& Error )
+        {
+            printf( "%s\n", Error.what() );
+            return xerr_failure_s( "Exception while compiling the animation" );
+        }
+
+        return {};
+    }
 
-// Run program: Ctrl + F5 or Debug > Start Without Debugging menu
-// Debug program: F5 or Debug > Start Debugging menu
+    xanim_compiler::descriptor                  m_CompilerOptions   {};
+    std::unique_ptr<xanim_compiler::instance>   m_Compiler          = xanim_compiler::MakeInstance();
+};
+
+
+//---------------------------------------------------------------------------------------
+
+int main( int argc, const char* argv[] )
+{
+    xcore::Init("xanim_compiler");
 
-// Tips for Getting Started: 
-//   1. Use the Solution Explorer window to add/manage files
-//   2. Use the Team Explorer window to connect to source control
-//   3. Use the Output window to see build output and other messages
-//   4. Use the Error List window to view errors
-//   5. Go to Project > Add New Item to create new code files, or Project > Add Existing Item to add existing code files to the project
-//   6. In the future, to open this project again, go to File > Open > Project and select the .sln file
+    auto AnimCompilerPipeline = std::make_unique<anim_pipeline_compiler>();
+
+    //
+    // Example, please turn off when no needed...
+    // Use the following command line: -OPTIMIZATION "O1" -DEBUG "D0" -TARGET "WINDOWS" -EDITOR ".\x64\test.lion_editor" -PROJECT ".\x64\test.lion_project" -ASSETS "./../../dependencies/xraw3D/dependencies/assimp/test/models/FBX" -INPUT "FF.FF/FF" -OUTPUT "./x64/test.lion_rcdbase"
+    //
+    if constexpr (true)
+    {
+        std::filesystem::create_directories("x64/test.lion_project/Config");
+        std::filesystem::create_directories("x64/test.lion_project/Resources/xanim/FF");
+        std::filesystem::create_directories("x64/test.lion_rcdbase/0.0-0/WINDOWS.platform/Data");
+
+        //
+        // drescriptor file
+        //
+        xanim_compiler::descriptor Option;
+        Option.m_Main.m_AnimAsset = xcore::string::Fmt("spider.fbx");
+        (void)xanim_compiler::descriptor::Serialize(Option, "./x64/test.lion_project/Resources/xanim/FF/ResourceDesc.txt", false);
+
+        //
+        // Create config file
+        //
+        xresource_pipeline::config::info Info
+        { .m_RootAssetsPath = "x64/Assets"
+        };
+        Info.m_ResourceTypes.push_back
+        ( xresource_pipeline::config::resource_type
+        { .m_FullGuid                   = anim_pipeline_compiler::full_guid_v
+        , .m_ResourceTypeName           = "xanim"
+        , .m_bDefaultSettingInEditor    = true
+        });
+
+        (void)xresource_pipeline::config::Serialize( Info, "./x64/test.lion_project/Config/ResourcePipeline.config", false );
+    }
+
+    //
+    // Parse parameters
+    //
+    if( auto Err = AnimCompilerPipeline->Parse( argc, argv ); Err )
+    {
+        printf( "%s\nERROR: Fail to compile\n", Err.getCode().m_pString );
+        return -1;
+    }
+
+    //
+    // Start compilation
+    //
+    if( auto Err = AnimCompilerPipeline->Compile(); Err )
+    {
+        printf("%s\nERROR: Fail to compile(2)\n", Err.getCode().m_pString);
+        return -1;
+    }
+
+    return 0;
+}
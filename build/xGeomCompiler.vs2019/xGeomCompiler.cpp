@@ -1,6 +1,18 @@
 
 #include "xgeom_compiler.h"
 #include <filesystem>
+#include <optional>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+    #include <psapi.h>
+    #pragma comment( lib, "psapi.lib" )
+#else
+    #include <sys/resource.h>
+#endif
 
 //---------------------------------------------------------------------------------------
 
@@ -16,24 +28,425 @@ struct geom_pipeline_compiler : xresource_pipeline::compiler::base
         return full_guid_v;
     }
 
+    geom_pipeline_compiler( void ) = default;
+    geom_pipeline_compiler( std::shared_ptr<xgeom_compiler::instance> Compiler ) : m_Compiler{ std::move(Compiler) } {}
+
     virtual xcore::err onCompile( void ) noexcept override
     {
         if( auto Err = xgeom_compiler::descriptor::Serialize( m_CompilerOptions, m_ResourceDescriptorPathFile.data(), true ); Err )
             return Err;
 
-        m_Compiler->LoadRaw( xcore::string::Fmt( "%s/%s", m_AssetsRootPath.data(), m_CompilerOptions.m_Main.m_MeshAsset.data() ).data() );
-        m_Compiler->Compile(m_CompilerOptions);
+        //
+        // Shared artifact store (build farm), reuse what someone else already compiled
+        //
+        std::uint64_t InputKey  = 0;
+        bool          bUseStore = m_StorePath.empty() == false;
+        if( bUseStore && xgeom_compiler::distributed::ComputeInputKey( InputKey, m_ResourceDescriptorPathFile.data(), m_AssetsRootPath.data(), m_KeyArgs ) == false )
+        {
+            printf( "WARNING: Some inputs could not be read, compiling without the artifact store\n" );
+            bUseStore = false;
+        }
+
+        if( bUseStore )
+        {
+            bool bFetchedAll = true;
+            for( int i = 0; bFetchedAll && i < int(m_Target.size()); ++i )
+            {
+                if( m_Target[i].m_bValid ) bFetchedAll = xgeom_compiler::distributed::FetchArtifact( m_StorePath, InputKey, i, m_Target[i].m_DataPath.data() );
+            }
+
+            if( bFetchedAll )
+            {
+                printf( "INFO: Reusing the compiled geometry from the artifact store\n" );
+                return {};
+            }
+        }
+
+        //
+        // Each platform may want its own stream layout
+        //
+        std::vector<xgeom_compiler::target_output> Outputs;
         for( auto& T : m_Target )
         {
-            if( T.m_bValid) m_Compiler->Serialize(T.m_DataPath.data());
+            if( T.m_bValid == false ) continue;
+
+            auto& Output = Outputs.emplace_back( xgeom_compiler::target_output{ .m_FilePath = T.m_DataPath.data(), .m_pStreams = nullptr } );
+            for( auto& L : m_CompilerOptions.m_TargetLayouts )
+            {
+                if( std::strcmp( L.m_Platform.data(), xcore::target::getPlatformString(T.m_Platform) ) == 0 ) Output.m_pStreams = &L.m_Streams;
+            }
+        }
+
+        try
+        {
+            m_Compiler->LoadRaw( getMeshAssetPath(), m_CompilerOptions );
+            if( hasSharedSkeleton() ) m_Compiler->BindSkeleton( getSkeletonAssetPath() );
+            m_Compiler->CompileTargets( m_CompilerOptions, Outputs );
+            m_Compiler->Flush();
+        }
+        catch( const std::exception& Error )
+        {
+            printf( "%s\n", Error.what() );
+            return xerr_failure_s( "Exception while compiling the geometry" );
+        }
+
+        if( bUseStore )
+        {
+            for( int i = 0; i < int(m_Target.size()); ++i )
+            {
+                if( m_Target[i].m_bValid ) xgeom_compiler::distributed::PublishArtifact( m_StorePath, InputKey, i, m_Target[i].m_DataPath.data() );
+            }
         }
+
         return {};
     }
 
+    std::string getMeshAssetPath( void ) const noexcept
+    {
+        return xcore::string::Fmt( "%s/%s", m_AssetsRootPath.data(), m_CompilerOptions.m_Main.m_MeshAsset.data() ).data();
+    }
+
+    // Skinned meshes can take their bones from a skeleton file shared by all the variants of a character
+    bool hasSharedSkeleton( void ) const noexcept
+    {
+        return m_CompilerOptions.m_Main.m_UseSkeletonFile.empty() == false && m_CompilerOptions.m_Cleanup.m_bRemoveBones == false;
+    }
+
+    std::string getSkeletonAssetPath( void ) const noexcept
+    {
+        return xcore::string::Fmt( "%s/%s", m_AssetsRootPath.data(), m_CompilerOptions.m_Main.m_UseSkeletonFile.data() ).data();
+    }
+
+    // Files that when changed require this resource to be recompiled
+    std::vector<std::string> getDependencies( void ) const noexcept
+    {
+        std::vector<std::string> Dependencies{ std::string(m_ResourceDescriptorPathFile.data()), getMeshAssetPath() };
+        if( hasSharedSkeleton() ) Dependencies.push_back( getSkeletonAssetPath() );
+        return Dependencies;
+    }
+
+    std::vector<std::string> getOutputs( void ) const noexcept
+    {
+        std::vector<std::string> Outputs;
+        for( auto& T : m_Target )
+        {
+            if( T.m_bValid ) Outputs.emplace_back( T.m_DataPath.data() );
+        }
+        return Outputs;
+    }
+
     xgeom_compiler::descriptor                  m_CompilerOptions   {};
-    std::unique_ptr<xgeom_compiler::instance>   m_Compiler          = xgeom_compiler::MakeInstance();
+    std::shared_ptr<xgeom_compiler::instance>   m_Compiler          = xgeom_compiler::MakeInstance();
+    std::string                                 m_StorePath         {};     // Shared artifact store, empty when not used
+    std::vector<std::string>                    m_KeyArgs           {};     // Pipeline arguments that take part in the artifact key
 };
 
+//---------------------------------------------------------------------------------------
+// Removes a front end switch (-NAME VALUE) from the arguments so the pipeline parser never sees it
+
+std::optional<std::string> ExtractOption( std::vector<const char*>& Args, std::string_view Name ) noexcept
+{
+    for( auto i = 1u; i + 1 < Args.size(); ++i )
+    {
+        if( Name != Args[i] ) continue;
+
+        std::string Value = Args[i + 1];
+        Args.erase( Args.begin() + i, Args.begin() + i + 2 );
+        return Value;
+    }
+
+    return {};
+}
+
+//---------------------------------------------------------------------------------------
+
+std::string FindOption( const std::vector<const char*>& Args, std::string_view Name ) noexcept
+{
+    for( auto i = 1u; i + 1 < Args.size(); ++i )
+        if( Name == Args[i] ) return Args[i + 1];
+    return {};
+}
+
+//---------------------------------------------------------------------------------------
+// "FIELD:BITS,FIELD:BITS,..." most significant first, see xgeom::sort_key_layout
+
+xcore::err ParseSortKeyLayout( std::string_view String, xgeom::sort_key_layout& Layout ) noexcept
+{
+    constexpr std::array<std::string_view, static_cast<int>(xgeom::sort_key_layout::field::ENUM_COUNT)> names_v
+    { "MATERIAL", "VERTEX_FORMAT", "SKINNED", "INDEX_WIDTH", "LOD" };
+
+    Layout.m_nEntries = 0;
+    int nTotalBits = 0;
+
+    while( String.empty() == false )
+    {
+        const auto Comma = std::min( String.find(','), String.size() );
+        const auto Entry = String.substr( 0, Comma );
+        const auto Colon = Entry.find(':');
+        String.remove_prefix( std::min( Comma + 1, String.size() ) );
+
+        if( Colon == std::string_view::npos ) return xerr_failure_s( "-SORT_KEY_LAYOUT entries must be FIELD:BITS" );
+
+        const auto It = std::find( names_v.begin(), names_v.end(), Entry.substr( 0, Colon ) );
+        if( It == names_v.end() ) return xerr_failure_s( "-SORT_KEY_LAYOUT has an unknown field" );
+
+        const auto Field = static_cast<xgeom::sort_key_layout::field>( It - names_v.begin() );
+        for( int i = 0; i < Layout.m_nEntries; ++i )
+            if( Layout.m_Entries[i].m_Field == Field ) return xerr_failure_s( "-SORT_KEY_LAYOUT has the same field twice" );
+
+        const int nBits = std::atoi( std::string( Entry.substr( Colon + 1 ) ).c_str() );
+        if( nBits <= 0 ) return xerr_failure_s( "-SORT_KEY_LAYOUT fields need at least one bit" );
+
+        nTotalBits += nBits;
+        Layout.m_Entries[Layout.m_nEntries++] = { Field, std::uint8_t(nBits) };
+    }
+
+    if( nTotalBits > 32 ) return xerr_failure_s( "-SORT_KEY_LAYOUT does not fit in 32 bits" );
+    return {};
+}
+
+//---------------------------------------------------------------------------------------
+
+struct front_end_options
+{
+    std::optional<std::string>  m_Daemon;           // -DAEMON          "unix:<path>" | "tcp:<host>:<port>"     Stay alive and serve compile requests
+    std::optional<std::string>  m_UseDaemon;        // -USE_DAEMON      "unix:<path>"                           Forward the compilation to a running daemon
+    std::optional<std::string>  m_Coordinator;      // -COORDINATOR     "tcp:<host>:<port>,..."                 Distribute all the project's xgeoms to these workers, remote ones need -STORE
+    std::optional<std::string>  m_LocalWorkers;     // -LOCAL_WORKERS   "<count>"                               Workers the coordinator starts in this machine
+    std::optional<std::string>  m_Store;            // -STORE           "<path>"                                Shared artifact store
+    std::optional<std::string>  m_OutputFormat;     // -OUTPUT_FORMAT   "SERIALIZER" | "IMAGE"                  How the compiled xgeom is written
+    std::optional<std::string>  m_Fsync;            // -FSYNC           "NONE" | "DATA" | "FULL"                Flush the outputs to disk before finishing
+    std::optional<std::string>  m_MemoryMode;       // -MEMORY_MODE     "DEFAULT" | "LEAN"                      LEAN releases data as soon as it is not needed
+    std::optional<std::string>  m_Threads;          // -THREADS         "<count>"                               Threads each compile may use (default 4)
+    std::optional<std::string>  m_PeakMemory;       // -PEAK_MEMORY     "<MB>"                                  Fail the compile if the process peak memory goes above this
+    std::optional<std::string>  m_SortKeyLayout;    // -SORT_KEY_LAYOUT "MATERIAL:16,VERTEX_FORMAT:8,..."       Layout of the render sort keys, must match the renderer
+
+    static front_end_options Extract( std::vector<const char*>& Args ) noexcept
+    {
+        front_end_options Options;
+        Options.m_Daemon        = ExtractOption( Args, "-DAEMON" );
+        Options.m_UseDaemon     = ExtractOption( Args, "-USE_DAEMON" );
+        Options.m_Coordinator   = ExtractOption( Args, "-COORDINATOR" );
+        Options.m_LocalWorkers  = ExtractOption( Args, "-LOCAL_WORKERS" );
+        Options.m_Store         = ExtractOption( Args, "-STORE" );
+        Options.m_OutputFormat  = ExtractOption( Args, "-OUTPUT_FORMAT" );
+        Options.m_Fsync         = ExtractOption( Args, "-FSYNC" );
+        Options.m_MemoryMode    = ExtractOption( Args, "-MEMORY_MODE" );
+        Options.m_Threads       = ExtractOption( Args, "-THREADS" );
+        Options.m_PeakMemory    = ExtractOption( Args, "-PEAK_MEMORY" );
+        Options.m_SortKeyLayout = ExtractOption( Args, "-SORT_KEY_LAYOUT" );
+        return Options;
+    }
+
+    // Switches that also need to reach a daemon or a worker compiling on our behalf
+    std::vector<std::string> getForwardedArgs( void ) const noexcept
+    {
+        std::vector<std::string> Args;
+        if( m_Store )         Args.insert( Args.end(), { "-STORE",           *m_Store } );
+        if( m_OutputFormat )  Args.insert( Args.end(), { "-OUTPUT_FORMAT",   *m_OutputFormat } );
+        if( m_Fsync )         Args.insert( Args.end(), { "-FSYNC",           *m_Fsync } );
+        if( m_MemoryMode )    Args.insert( Args.end(), { "-MEMORY_MODE",     *m_MemoryMode } );
+        if( m_Threads )       Args.insert( Args.end(), { "-THREADS",         *m_Threads } );
+        if( m_SortKeyLayout ) Args.insert( Args.end(), { "-SORT_KEY_LAYOUT", *m_SortKeyLayout } );
+        return Args;
+    }
+
+    xcore::err Apply( geom_pipeline_compiler& Pipeline, const std::vector<const char*>& Args ) const noexcept
+    {
+        xgeom_compiler::write_options WriteOptions;
+
+        if( m_OutputFormat )
+        {
+            if(      *m_OutputFormat == "SERIALIZER" ) WriteOptions.m_Format = xgeom_compiler::write_options::format::SERIALIZER;
+            else if( *m_OutputFormat == "IMAGE" )      WriteOptions.m_Format = xgeom_compiler::write_options::format::IMAGE;
+            else return xerr_failure_s( "Unknown -OUTPUT_FORMAT, expecting SERIALIZER or IMAGE" );
+        }
+
+        if( m_Fsync )
+        {
+            if(      *m_Fsync == "NONE" ) WriteOptions.m_Fsync = xgeom_compiler::write_options::fsync_policy::NONE;
+            else if( *m_Fsync == "DATA" ) WriteOptions.m_Fsync = xgeom_compiler::write_options::fsync_policy::DATA;
+            else if( *m_Fsync == "FULL" ) WriteOptions.m_Fsync = xgeom_compiler::write_options::fsync_policy::FULL;
+            else return xerr_failure_s( "Unknown -FSYNC, expecting NONE, DATA or FULL" );
+        }
+
+        Pipeline.m_Compiler->SetWriteOptions( WriteOptions );
+
+        if( m_MemoryMode )
+        {
+            if(      *m_MemoryMode == "DEFAULT" ) Pipeline.m_Compiler->SetLeanMemory( false );
+            else if( *m_MemoryMode == "LEAN" )    Pipeline.m_Compiler->SetLeanMemory( true );
+            else return xerr_failure_s( "Unknown -MEMORY_MODE, expecting DEFAULT or LEAN" );
+        }
+
+        if( m_Threads )
+        {
+            const int nThreads = std::atoi( m_Threads->c_str() );
+            if( nThreads <= 0 ) return xerr_failure_s( "-THREADS expects a count above zero" );
+            Pipeline.m_Compiler->SetMaxThreads( std::size_t(nThreads) );
+        }
+
+        xgeom::sort_key_layout SortKeyLayout = xgeom::default_sort_key_layout_v;
+        if( m_SortKeyLayout )
+        {
+            if( auto Err = ParseSortKeyLayout( *m_SortKeyLayout, SortKeyLayout ); Err ) return Err;
+        }
+        Pipeline.m_Compiler->SetSortKeyLayout( SortKeyLayout );
+
+        if( m_Store ) Pipeline.m_StorePath = *m_Store;
+        Pipeline.m_KeyArgs.assign( Args.begin() + 1, Args.end() );
+
+        // These change the artifact so they are part of the key
+        if( m_OutputFormat )  Pipeline.m_KeyArgs.insert( Pipeline.m_KeyArgs.end(), { "-OUTPUT_FORMAT",   *m_OutputFormat } );
+        if( m_SortKeyLayout ) Pipeline.m_KeyArgs.insert( Pipeline.m_KeyArgs.end(), { "-SORT_KEY_LAYOUT", *m_SortKeyLayout } );
+        return {};
+    }
+};
+
+//---------------------------------------------------------------------------------------
+// Peak memory used by the process so far, in bytes
+
+std::uint64_t getPeakMemory( void ) noexcept
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS Counters{};
+    if( GetProcessMemoryInfo( GetCurrentProcess(), &Counters, sizeof(Counters) ) == FALSE ) return 0;
+    return Counters.PeakWorkingSetSize;
+#else
+    rusage Usage{};
+    if( getrusage( RUSAGE_SELF, &Usage ) ) return 0;
+    #if defined(__APPLE__)
+        return std::uint64_t(Usage.ru_maxrss);
+    #else
+        return std::uint64_t(Usage.ru_maxrss) * 1024;
+    #endif
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+// Keeps the process alive and serves compile requests (see xgeom_compiler_daemon.h)
+
+int RunDaemon( const std::string& Address, const char* pExePath )
+{
+    constexpr std::size_t raw_cache_size_v = 16;
+
+    auto SharedCompiler = std::shared_ptr<xgeom_compiler::instance>( xgeom_compiler::MakeInstance() );
+    SharedCompiler->SetRawCacheSize( raw_cache_size_v );
+
+    auto Err = xgeom_compiler::daemon::Serve( { .m_Address = Address }, [&]( const std::vector<std::string>& JobArgs )
+    {
+        xgeom_compiler::daemon::job_result  Result;
+        std::vector<const char*>            Argv{ pExePath };
+        for( auto& A : JobArgs ) Argv.push_back( A.c_str() );
+
+        auto Pipeline = std::make_unique<geom_pipeline_compiler>( SharedCompiler );
+
+        if( Result.m_Error = front_end_options::Extract( Argv ).Apply( *Pipeline, Argv ); Result.m_Error ) return Result;
+        if( Result.m_Error = Pipeline->Parse( int(Argv.size()), Argv.data() ); Result.m_Error ) return Result;
+        if( Result.m_Error = Pipeline->Compile(); Result.m_Error )                              return Result;
+
+        Result.m_Dependencies = Pipeline->getDependencies();
+        Result.m_Outputs      = Pipeline->getOutputs();
+        return Result;
+    });
+
+    if( Err )
+    {
+        printf( "%s\nERROR: Daemon stopped\n", Err.getCode().m_pString );
+        return -1;
+    }
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------
+// Workers in this machine write the outputs where the coordinator expects them
+
+bool isLocalWorker( std::string_view Address ) noexcept
+{
+    return Address.starts_with( "tcp:127.0.0.1:" ) || Address.starts_with( "tcp:localhost:" ) || Address.starts_with( "tcp::" );
+}
+
+//---------------------------------------------------------------------------------------
+// Copies the targets a worker compiled for this job from the artifact store into our output
+
+bool FetchJobOutputs( const xgeom_compiler::distributed::job& Job, const char* pExePath, std::string_view StorePath ) noexcept
+{
+    std::vector<const char*> Argv{ pExePath };
+    for( auto& A : Job.m_Args ) Argv.push_back( A.c_str() );
+
+    // Resolve the target paths and the key exactly as the worker did
+    geom_pipeline_compiler Pipeline;
+    std::uint64_t          InputKey = 0;
+    if( front_end_options::Extract( Argv ).Apply( Pipeline, Argv ) )  return false;
+    if( Pipeline.Parse( int(Argv.size()), Argv.data() ) )             return false;
+    if( xgeom_compiler::distributed::ComputeInputKey( InputKey, Pipeline.m_ResourceDescriptorPathFile.data(), Pipeline.m_AssetsRootPath.data(), Pipeline.m_KeyArgs ) == false ) return false;
+
+    for( int i = 0; i < int(Pipeline.m_Target.size()); ++i )
+    {
+        if( Pipeline.m_Target[i].m_bValid && xgeom_compiler::distributed::FetchArtifact( StorePath, InputKey, i, Pipeline.m_Target[i].m_DataPath.data() ) == false ) return false;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+// Compiles every xgeom in the project using a set of workers (see xgeom_compiler_distributed.h)
+
+int RunCoordinator( const front_end_options& Options, const std::vector<const char*>& Args )
+{
+    xgeom_compiler::distributed::settings Settings
+    { .m_nLocalWorkers  = Options.m_LocalWorkers ? std::atoi( Options.m_LocalWorkers->c_str() ) : 0
+    , .m_ExePath        = std::filesystem::absolute( Args[0] ).string()
+    , .m_StorePath      = Options.m_Store ? *Options.m_Store : std::string{}
+    };
+
+    for( std::string_view Workers = *Options.m_Coordinator; Workers.empty() == false; )
+    {
+        const auto Comma = std::min( Workers.find(','), Workers.size() );
+        if( Comma ) Settings.m_Workers.emplace_back( Workers.substr( 0, Comma ) );
+        Workers.remove_prefix( std::min( Comma + 1, Workers.size() ) );
+    }
+
+    // Remote workers keep their outputs, the artifact store is the only way to bring them back
+    const bool bHasRemoteWorkers = std::any_of( Settings.m_Workers.begin(), Settings.m_Workers.end(), []( const std::string& W ) { return isLocalWorker(W) == false; } );
+    if( bHasRemoteWorkers && Settings.m_StorePath.empty() )
+    {
+        printf( "ERROR: -COORDINATOR with remote workers needs a shared -STORE\n" );
+        return -1;
+    }
+
+    std::vector<std::string> JobArgs( Args.begin() + 1, Args.end() );
+    const auto               Forwarded = Options.getForwardedArgs();
+    JobArgs.insert( JobArgs.end(), Forwarded.begin(), Forwarded.end() );
+
+    auto Jobs = xgeom_compiler::distributed::EnumerateJobs( FindOption( Args, "-PROJECT" ), FindOption( Args, "-ASSETS" ), Settings.m_StorePath, JobArgs );
+
+    if( auto Err = xgeom_compiler::distributed::RunCoordinator( Settings, Jobs ); Err )
+    {
+        printf( "%s\nERROR: Fail to compile\n", Err.getCode().m_pString );
+        return -1;
+    }
+
+    if( bHasRemoteWorkers )
+    {
+        int nMissing = 0;
+        for( const auto& Job : Jobs )
+        {
+            if( FetchJobOutputs( Job, Args[0], Settings.m_StorePath ) ) continue;
+            printf( "ERROR: (%s) was compiled but its outputs are not in the artifact store\n", Job.m_Name.c_str() );
+            nMissing++;
+        }
+
+        if( nMissing )
+        {
+            printf( "ERROR: Fail to compile\n" );
+            return -1;
+        }
+    }
+
+    return 0;
+}
 
 //---------------------------------------------------------------------------------------
 
@@ -76,10 +489,45 @@ int main( int argc, const char* argv[] )
         (void)xresource_pipeline::config::Serialize( Info, "./x64/test.lion_project/Config/ResourcePipeline.config", false );
     }
 
+    //
+    // Front end switches (see front_end_options)
+    //
+    std::vector<const char*> Args( argv, argv + argc );
+    const auto Options = front_end_options::Extract( Args );
+
+    if( Options.m_Daemon )      return RunDaemon( *Options.m_Daemon, argv[0] );
+    if( Options.m_Coordinator ) return RunCoordinator( Options, Args );
+
+    if( Options.m_UseDaemon )
+    {
+        // The daemon needs to see the artifact store and output switches too
+        std::vector<std::string> DaemonArgs( Args.begin() + 1, Args.end() );
+        const auto               Forwarded = Options.getForwardedArgs();
+        DaemonArgs.insert( DaemonArgs.end(), Forwarded.begin(), Forwarded.end() );
+
+        bool bDaemonReached = false;
+        auto Err = xgeom_compiler::daemon::Submit( *Options.m_UseDaemon, DaemonArgs, bDaemonReached );
+        if( bDaemonReached )
+        {
+            if( Err )
+            {
+                printf( "%s\nERROR: Fail to compile\n", Err.getCode().m_pString );
+                return -1;
+            }
+            return 0;
+        }
+    }
+
+    if( auto Err = Options.Apply( *GeomCompilerPipeline, Args ); Err )
+    {
+        printf( "%s\nERROR: Fail to compile\n", Err.getCode().m_pString );
+        return -1;
+    }
+
     //
     // Parse parameters
     //
-    if( auto Err = GeomCompilerPipeline->Parse( argc, argv ); Err )
+    if( auto Err = GeomCompilerPipeline->Parse( int(Args.size()), Args.data() ); Err )
     {
         printf( "%s\nERROR: Fail to compile\n", Err.getCode().m_pString );
         return -1;
@@ -94,6 +542,18 @@ int main( int argc, const char* argv[] )
         return -1;
     }
 
+    //
+    // Memory budget, farm machines run many compiles at once and size themselves by it
+    //
+    const auto PeakMB = double(getPeakMemory()) / (1024.0 * 1024.0);
+    printf( "INFO: Peak memory %.1f MB\n", PeakMB );
+
+    if( Options.m_PeakMemory && PeakMB > std::atof( Options.m_PeakMemory->c_str() ) )
+    {
+        printf( "ERROR: Peak memory %.1f MB is above the %s MB budget\n", PeakMB, Options.m_PeakMemory->c_str() );
+        return -1;
+    }
+
     return 0;
 }
 
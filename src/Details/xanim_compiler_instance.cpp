@@ -0,0 +1,319 @@
+
+#include <cstdio>
+#include <cmath>
+#include "xraw3d.h"
+#include "../../src_runtime/xanim.h"
+
+namespace xanim_compiler
+{
+    struct implementation : xanim_compiler::instance
+    {
+        using vec3 = std::array<float, 3>;
+        using quat = std::array<float, 4>;
+
+        // Quantized key, the three uint16 components of any channel
+        using key  = std::array<std::uint16_t, 3>;
+
+        struct track
+        {
+            std::vector<std::uint16_t>      m_Time;
+            std::vector<key>                m_Value;
+        };
+
+        implementation()
+        {
+            m_FinalAnim.Initialize();
+        }
+
+        virtual ~implementation( void ) override
+        {
+            m_FinalAnim.Kill();
+        }
+
+        virtual void LoadRaw( const std::string_view Path ) override
+        {
+            m_RawAnim = {};
+
+            // The importer always brings the geometry too, it is only needed here for the import
+            xraw3d::geom RawGeom;
+            try
+            {
+                xraw3d::assimp::ImportAll( m_RawAnim, RawGeom, Path.data() );
+            }
+            catch (std::runtime_error Error)
+            {
+                printf("%s", Error.what());
+                return;
+            }
+        }
+
+        //
+        // Greedy key reduction. From the last kept key the next one is pushed as far as the keys in between
+        // can be rebuilt by interpolating the two, checked against the source frames. Error(iFrom, iTo, iFrame)
+        // tells how far the interpolation of the two keys is from the source at iFrame.
+        //
+        template< typename T_ERROR >
+        static std::vector<std::uint16_t> ReduceKeys( int nFrames, float Tolerance, T_ERROR&& Error )
+        {
+            std::vector<std::uint16_t> Kept{ 0 };
+            if( nFrames <= 1 ) return Kept;
+
+            // Constant track, the first key is enough
+            bool bConstant = true;
+            for( int f = 1; bConstant && f < nFrames; ++f ) bConstant = Error( 0, 0, f ) <= Tolerance;
+            if( bConstant ) return Kept;
+
+            int iFrom = 0;
+            while( iFrom < nFrames - 1 )
+            {
+                int iTo = iFrom + 1;
+                while( iTo + 1 < nFrames )
+                {
+                    bool bFits = true;
+                    for( int f = iFrom + 1; bFits && f <= iTo; ++f ) bFits = Error( iFrom, iTo + 1, f ) <= Tolerance;
+                    if( bFits == false ) break;
+                    iTo++;
+                }
+
+                Kept.push_back( std::uint16_t(iTo) );
+                iFrom = iTo;
+            }
+
+            return Kept;
+        }
+
+        // Raw key frames are frame major, all the bones of frame 0 then all the bones of frame 1...
+        const xraw3d::anim::key_frame& getRawKey( int iBone, int iFrame ) const noexcept
+        {
+            return m_RawAnim.m_KeyFrame[ std::size_t(iFrame) * m_RawAnim.m_Bone.size() + iBone ];
+        }
+
+        static xanim::range ComputeRange( const std::vector<vec3>& Values ) noexcept
+        {
+            xanim::range Range{};
+            if( Values.empty() ) return Range;
+
+            vec3 Max = Values[0];
+            Range.m_Min = Values[0];
+            for( const auto& V : Values ) for( int c = 0; c < 3; ++c )
+            {
+                Range.m_Min[c] = std::min( Range.m_Min[c], V[c] );
+                Max[c]         = std::max( Max[c], V[c] );
+            }
+            for( int c = 0; c < 3; ++c ) Range.m_Extent[c] = Max[c] - Range.m_Min[c];
+            return Range;
+        }
+
+        track CompressRotations( const std::vector<quat>& Source, float Tolerance ) const
+        {
+            const int           nFrames = int(Source.size());
+            std::vector<key>    Quantized( nFrames );
+            std::vector<quat>   Decoded( nFrames );
+            for( int f = 0; f < nFrames; ++f )
+            {
+                auto& K = Quantized[f];
+                xanim::EncodeRotation( Source[f], K[0], K[1], K[2] );
+                Decoded[f] = xanim::DecodeRotation( K[0], K[1], K[2] );
+            }
+
+            // Angle between the normalized lerp of the decoded keys (as the runtime samples) and the source
+            auto Error = [&]( int iFrom, int iTo, int iFrame ) noexcept
+            {
+                const auto& A   = Decoded[iFrom];
+                auto        B   = Decoded[iTo];
+                const float T   = iTo == iFrom ? 0.0f : float(iFrame - iFrom) / float(iTo - iFrom);
+                if( A[0]*B[0] + A[1]*B[1] + A[2]*B[2] + A[3]*B[3] < 0 ) for( auto& V : B ) V = -V;
+
+                quat  Q;
+                float Len = 0;
+                for( int c = 0; c < 4; ++c ) { Q[c] = A[c] + (B[c] - A[c]) * T; Len += Q[c] * Q[c]; }
+                Len = std::sqrt( Len );
+
+                const auto& S   = Source[iFrame];
+                const auto  Dot = std::abs( Q[0]*S[0] + Q[1]*S[1] + Q[2]*S[2] + Q[3]*S[3] ) / std::max( Len, 1e-12f );
+                return 2.0f * std::acos( std::min( Dot, 1.0f ) );
+            };
+
+            track Track;
+            Track.m_Time = ReduceKeys( nFrames, Tolerance, Error );
+            for( const auto f : Track.m_Time ) Track.m_Value.push_back( Quantized[f] );
+            return Track;
+        }
+
+        track CompressVectors( const std::vector<vec3>& Source, const xanim::range& Range, float Tolerance ) const
+        {
+            const int           nFrames = int(Source.size());
+            std::vector<key>    Quantized( nFrames );
+            std::vector<vec3>   Decoded( nFrames );
+            for( int f = 0; f < nFrames; ++f )
+            {
+                for( int c = 0; c < 3; ++c )
+                {
+                    Quantized[f][c] = xanim::EncodeRange( Source[f][c], Range.m_Min[c], Range.m_Extent[c] );
+                    Decoded[f][c]   = xanim::DecodeRange( Quantized[f][c], Range.m_Min[c], Range.m_Extent[c] );
+                }
+            }
+
+            // Measured against the quantized source, with a clip wide range the quantization step alone may be
+            // above the tolerance (long root motion) and no key could ever be dropped
+            auto Error = [&]( int iFrom, int iTo, int iFrame ) noexcept
+            {
+                const float T = iTo == iFrom ? 0.0f : float(iFrame - iFrom) / float(iTo - iFrom);
+                float       D = 0;
+                for( int c = 0; c < 3; ++c )
+                {
+                    const auto V = Decoded[iFrom][c] + (Decoded[iTo][c] - Decoded[iFrom][c]) * T - Decoded[iFrame][c];
+                    D += V * V;
+                }
+                return std::sqrt( D );
+            };
+
+            track Track;
+            Track.m_Time = ReduceKeys( nFrames, Tolerance, Error );
+            for( const auto f : Track.m_Time ) Track.m_Value.push_back( Quantized[f] );
+            return Track;
+        }
+
+        virtual void Compile( const xanim_compiler::descriptor& CompilerOption ) override
+        {
+            m_FinalAnim.Kill();
+            m_FinalAnim.Initialize();
+
+            const int nBones  = int(m_RawAnim.m_Bone.size());
+            int       nFrames = m_RawAnim.m_nFrames;
+
+            if( nBones > 0x7fff ) throw(std::runtime_error( xcore::string::Fmt("The animation has too many bones (%d)", nBones).data() ));
+            if( nFrames > 0xffff )
+            {
+                printf( "WARNING: The animation has %d frames, only the first %d are kept\n", nFrames, 0xffff );
+                nFrames = 0xffff;
+            }
+            if( nBones == 0 || nFrames <= 0 || m_RawAnim.m_KeyFrame.size() < std::size_t(nFrames) * nBones )
+                throw(std::runtime_error( "The asset has no animation" ));
+
+            //
+            // Source channels, rotations made continuous so consecutive keys interpolate the short way
+            //
+            std::vector<std::vector<quat>> Rotations   ( nBones, std::vector<quat>( nFrames ) );
+            std::vector<std::vector<vec3>> Translations( nBones, std::vector<vec3>( nFrames ) );
+            std::vector<std::vector<vec3>> Scales      ( nBones, std::vector<vec3>( nFrames ) );
+            std::vector<vec3>              AllTranslations, AllScales;
+            AllTranslations.reserve( std::size_t(nFrames) * nBones );
+            AllScales.reserve( std::size_t(nFrames) * nBones );
+
+            for( int b = 0; b < nBones; ++b )
+            {
+                for( int f = 0; f < nFrames; ++f )
+                {
+                    const auto& Key = getRawKey( b, f );
+                    auto&       Q   = Rotations[b][f];
+
+                    Q = quat{ Key.m_Rotation.m_X, Key.m_Rotation.m_Y, Key.m_Rotation.m_Z, Key.m_Rotation.m_W };
+                    float Len = std::sqrt( Q[0]*Q[0] + Q[1]*Q[1] + Q[2]*Q[2] + Q[3]*Q[3] );
+                    if( Len <= 0 ) Q = quat{ 0, 0, 0, 1 };
+                    else           for( auto& V : Q ) V /= Len;
+
+                    if( f )
+                    {
+                        const auto& P = Rotations[b][f - 1];
+                        if( P[0]*Q[0] + P[1]*Q[1] + P[2]*Q[2] + P[3]*Q[3] < 0 ) for( auto& V : Q ) V = -V;
+                    }
+
+                    Translations[b][f] = vec3{ Key.m_Translation.m_X, Key.m_Translation.m_Y, Key.m_Translation.m_Z };
+                    Scales[b][f]       = vec3{ Key.m_Scale.m_X, Key.m_Scale.m_Y, Key.m_Scale.m_Z };
+                    AllTranslations.push_back( Translations[b][f] );
+                    AllScales.push_back( Scales[b][f] );
+                }
+            }
+
+            // One range per clip, the keys quantize against it
+            m_FinalAnim.m_TranslationRange = ComputeRange( AllTranslations );
+            m_FinalAnim.m_ScaleRange       = ComputeRange( AllScales );
+            AllTranslations = {};
+            AllScales       = {};
+
+            //
+            // Reduce and quantize every track
+            //
+            const auto& Compression = CompilerOption.m_Compression;
+
+            const auto& TranslationExtent = m_FinalAnim.m_TranslationRange.m_Extent;
+            const float TranslationStep   = std::max( { TranslationExtent[0], TranslationExtent[1], TranslationExtent[2] } ) / 0xffff;
+            if( TranslationStep * 0.5f > Compression.m_TranslationTolerance )
+                printf( "WARNING: The translations quantize in steps of %g, above the tolerance (%g)\n", double(TranslationStep), double(Compression.m_TranslationTolerance) );
+            std::vector<track> Tracks;
+            Tracks.reserve( std::size_t(nBones) * xanim::CHANNEL_COUNT );
+            for( int b = 0; b < nBones; ++b )
+            {
+                Tracks.push_back( CompressRotations( Rotations[b], Compression.m_RotationTolerance ) );
+                Tracks.push_back( CompressVectors( Translations[b], m_FinalAnim.m_TranslationRange, Compression.m_TranslationTolerance ) );
+                Tracks.push_back( CompressVectors( Scales[b],       m_FinalAnim.m_ScaleRange,       Compression.m_ScaleTolerance ) );
+            }
+
+            //
+            // Lay out the keys, times in track order and the values as one array per component
+            //
+            std::size_t nKeys = 0;
+            for( const auto& T : Tracks ) nKeys += T.m_Time.size();
+
+            auto pBone      = std::make_unique<xanim::bone[]>( nBones );
+            auto pTrack     = std::make_unique<xanim::track[]>( Tracks.size() );
+            auto pKeyTime   = std::make_unique<std::uint16_t[]>( nKeys );
+            auto pKeyValue  = std::make_unique<std::uint16_t[]>( nKeys * 3 );
+
+            for( int b = 0; b < nBones; ++b )
+            {
+                const auto& Raw = m_RawAnim.m_Bone[b];
+                std::memcpy( pBone[b].m_Name.data(), Raw.m_Name.data(), std::min( Raw.m_Name.size(), pBone[b].m_Name.size() - 1 ) );
+                pBone[b].m_iParent = std::int16_t( Raw.m_iParent );
+            }
+
+            std::uint32_t iKey = 0;
+            for( std::size_t t = 0; t < Tracks.size(); ++t )
+            {
+                const auto& T = Tracks[t];
+                pTrack[t] = xanim::track{ .m_iKey = iKey, .m_nKeys = std::uint32_t(T.m_Time.size()) };
+                for( std::size_t k = 0; k < T.m_Time.size(); ++k, ++iKey )
+                {
+                    pKeyTime[iKey] = T.m_Time[k];
+                    for( int c = 0; c < 3; ++c ) pKeyValue[ c * nKeys + iKey ] = T.m_Value[k][c];
+                }
+            }
+
+            m_FinalAnim.m_pBone     = pBone.release();
+            m_FinalAnim.m_pTrack    = pTrack.release();
+            m_FinalAnim.m_pKeyTime  = pKeyTime.release();
+            m_FinalAnim.m_pKeyValue = pKeyValue.release();
+            m_FinalAnim.m_nKeys     = std::uint32_t(nKeys);
+            m_FinalAnim.m_nBones    = std::uint16_t(nBones);
+            m_FinalAnim.m_nFrames   = std::uint16_t(nFrames);
+            m_FinalAnim.m_FPS       = m_RawAnim.m_FPS;
+            std::memcpy( m_FinalAnim.m_Name.data(), m_RawAnim.m_Name.data(), std::min( m_RawAnim.m_Name.size(), m_FinalAnim.m_Name.size() - 1 ) );
+
+            printf( "INFO: %d bones, %d frames, %d of %d keys kept (%.1f%%)\n"
+            , nBones
+            , nFrames
+            , int(nKeys)
+            , nFrames * nBones * int(xanim::CHANNEL_COUNT)
+            , 100.0 * double(nKeys) / double( std::size_t(nFrames) * nBones * xanim::CHANNEL_COUNT )
+            );
+        }
+
+        virtual void Serialize( const std::string_view FilePath ) override
+        {
+            xcore::serializer::stream Stream;
+            if( auto Err = Stream.Save( xcore::string::To<wchar_t>(FilePath), m_FinalAnim, {}, false ); Err )
+                throw(std::runtime_error( xcore::string::Fmt("Failed to serialize the animation (%s)", Err.getCode().m_pString).data() ));
+        }
+
+        xanim                           m_FinalAnim;
+        xraw3d::anim                    m_RawAnim;
+    };
+
+    //------------------------------------------------------------------------------------
+
+    std::unique_ptr<instance> MakeInstance()
+    {
+        return std::make_unique<implementation>();
+    }
+}
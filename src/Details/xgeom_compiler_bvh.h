@@ -0,0 +1,275 @@
+#ifndef XGEOM_COMPILER_BVH_H
+#define XGEOM_COMPILER_BVH_H
+#pragma once
+
+//
+// Builds the xgeom::bvh of one LOD. A binary tree is built first with binned SAH and then collapsed
+// into 4 wide nodes by opening the child with the largest area until each node has four children.
+//
+namespace xgeom_compiler::bvh
+{
+    struct aabb
+    {
+        std::array<float, 3>    m_Min { std::numeric_limits<float>::max(),  std::numeric_limits<float>::max(),  std::numeric_limits<float>::max() };
+        std::array<float, 3>    m_Max {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+        void Add( const std::array<float, 3>& P ) noexcept
+        {
+            for( int a = 0; a < 3; ++a ) { m_Min[a] = std::min( m_Min[a], P[a] ); m_Max[a] = std::max( m_Max[a], P[a] ); }
+        }
+
+        void Add( const aabb& B ) noexcept
+        {
+            for( int a = 0; a < 3; ++a ) { m_Min[a] = std::min( m_Min[a], B.m_Min[a] ); m_Max[a] = std::max( m_Max[a], B.m_Max[a] ); }
+        }
+
+        float getHalfArea( void ) const noexcept
+        {
+            if( m_Min[0] > m_Max[0] ) return 0;
+            const float X = m_Max[0] - m_Min[0], Y = m_Max[1] - m_Min[1], Z = m_Max[2] - m_Min[2];
+            return X * Y + Y * Z + Z * X;
+        }
+    };
+
+    struct builder
+    {
+        static constexpr int    bin_count_v         = 16;
+        static constexpr int    max_sah_depth_v     = 32;       // Deeper than this splits by count, keeps the runtime stack bounded
+
+        struct node
+        {
+            aabb                m_BBox   {};
+            std::uint32_t       m_iFirst {};                    // Into m_Order
+            std::uint32_t       m_nTris  {};
+            std::int32_t        m_iLeft  { -1 };                // Interior nodes only, right is m_iLeft + 1
+        };
+
+        //
+        // Binary tree over [iFirst, iFirst + nTris) of m_Order, into the already allocated m_Nodes[iNode]
+        //
+        void BuildNode( std::uint32_t iNode, std::uint32_t iFirst, std::uint32_t nTris, int Depth )
+        {
+            m_Nodes[iNode] = node{ .m_iFirst = iFirst, .m_nTris = nTris };
+
+            aabb Bounds, Centroids;
+            for( auto i = iFirst; i < iFirst + nTris; ++i )
+            {
+                Bounds.Add( m_TriBox[ m_Order[i] ] );
+                Centroids.Add( m_Centroid[ m_Order[i] ] );
+            }
+            m_Nodes[iNode].m_BBox = Bounds;
+
+            if( nTris <= 1 ) return;
+
+            //
+            // Best binned split over the three axes
+            //
+            int     BestAxis = -1, BestBin = 0;
+            float   BestCost = std::numeric_limits<float>::max();
+            if( Depth < max_sah_depth_v )
+            {
+                for( int a = 0; a < 3; ++a )
+                {
+                    const float Extent = Centroids.m_Max[a] - Centroids.m_Min[a];
+                    if( Extent <= 0 ) continue;
+
+                    std::array<aabb, bin_count_v>       BinBox;
+                    std::array<std::uint32_t, bin_count_v> BinCount{};
+                    const float Scale = bin_count_v / Extent;
+                    for( auto i = iFirst; i < iFirst + nTris; ++i )
+                    {
+                        const auto t = m_Order[i];
+                        const int  b = std::min( bin_count_v - 1, int( (m_Centroid[t][a] - Centroids.m_Min[a]) * Scale ) );
+                        BinBox[b].Add( m_TriBox[t] );
+                        BinCount[b]++;
+                    }
+
+                    // Sweep from the right to get the cost of every right side, then from the left
+                    std::array<float, bin_count_v> RightCost{};
+                    aabb          Right;
+                    std::uint32_t nRight = 0;
+                    for( int b = bin_count_v - 1; b > 0; --b )
+                    {
+                        Right.Add( BinBox[b] );
+                        nRight += BinCount[b];
+                        RightCost[b] = Right.getHalfArea() * nRight;
+                    }
+
+                    aabb          Left;
+                    std::uint32_t nLeft = 0;
+                    for( int b = 0; b < bin_count_v - 1; ++b )
+                    {
+                        Left.Add( BinBox[b] );
+                        nLeft += BinCount[b];
+                        if( nLeft == 0 || nLeft == nTris ) continue;
+
+                        const float Cost = Left.getHalfArea() * nLeft + RightCost[b + 1];
+                        if( Cost < BestCost ) { BestCost = Cost; BestAxis = a; BestBin = b; }
+                    }
+                }
+            }
+
+            // A leaf tests every triangle, a split pays one traversal step plus both sides
+            const float LeafCost = Bounds.getHalfArea() * nTris;
+            if( int(nTris) <= m_MaxLeafSize && (BestAxis < 0 || Bounds.getHalfArea() + BestCost >= LeafCost) ) return;
+
+            std::uint32_t nLeft;
+            if( BestAxis >= 0 )
+            {
+                const float Scale = bin_count_v / (Centroids.m_Max[BestAxis] - Centroids.m_Min[BestAxis]);
+                const auto  It    = std::partition( m_Order.begin() + iFirst, m_Order.begin() + iFirst + nTris, [&]( std::uint32_t t )
+                {
+                    return std::min( bin_count_v - 1, int( (m_Centroid[t][BestAxis] - Centroids.m_Min[BestAxis]) * Scale ) ) <= BestBin;
+                });
+                nLeft = std::uint32_t( It - (m_Order.begin() + iFirst) );
+            }
+            else
+            {
+                // Too deep or all the centroids in one spot, split by count along the longest axis
+                int a = 0;
+                for( int i = 1; i < 3; ++i ) if( Centroids.m_Max[i] - Centroids.m_Min[i] > Centroids.m_Max[a] - Centroids.m_Min[a] ) a = i;
+
+                nLeft = nTris / 2;
+                std::nth_element( m_Order.begin() + iFirst, m_Order.begin() + iFirst + nLeft, m_Order.begin() + iFirst + nTris, [&]( std::uint32_t A, std::uint32_t B )
+                {
+                    return m_Centroid[A][a] < m_Centroid[B][a];
+                });
+            }
+
+            // Children are allocated as a pair so the right one is always m_iLeft + 1
+            const auto iLeft = std::int32_t(m_Nodes.size());
+            m_Nodes.resize( m_Nodes.size() + 2 );
+            m_Nodes[iNode].m_iLeft = iLeft;
+
+            BuildNode( iLeft,     iFirst,         nLeft,          Depth + 1 );
+            BuildNode( iLeft + 1, iFirst + nLeft, nTris - nLeft,  Depth + 1 );
+        }
+
+        //
+        // 4 wide node from a binary one, returns its index in Nodes
+        //
+        std::uint32_t Collapse( std::uint32_t iBinary, std::uint32_t iBaseTriangle, std::vector<xgeom::bvh_node>& Nodes ) const
+        {
+            std::array<std::uint32_t, 4> Children;
+            int                          nChildren = 0;
+
+            if( m_Nodes[iBinary].m_iLeft < 0 ) Children[nChildren++] = iBinary;
+            else
+            {
+                Children[nChildren++] = m_Nodes[iBinary].m_iLeft;
+                Children[nChildren++] = m_Nodes[iBinary].m_iLeft + 1;
+            }
+
+            while( nChildren < 4 )
+            {
+                int   iOpen    = -1;
+                float BestArea = -1;
+                for( int i = 0; i < nChildren; ++i )
+                {
+                    const auto& N = m_Nodes[Children[i]];
+                    if( N.m_iLeft >= 0 && N.m_BBox.getHalfArea() > BestArea ) { BestArea = N.m_BBox.getHalfArea(); iOpen = i; }
+                }
+                if( iOpen < 0 ) break;
+
+                const auto iLeft    = m_Nodes[Children[iOpen]].m_iLeft;
+                Children[iOpen]     = iLeft;
+                Children[nChildren++] = iLeft + 1;
+            }
+
+            const auto iNode = std::uint32_t(Nodes.size());
+            Nodes.emplace_back();
+            for( int l = 0; l < 4; ++l )
+            {
+                auto& Node = Nodes[iNode];
+                if( l >= nChildren )
+                {
+                    Node.m_MinX[l] = Node.m_MinY[l] = Node.m_MinZ[l] =  std::numeric_limits<float>::infinity();
+                    Node.m_MaxX[l] = Node.m_MaxY[l] = Node.m_MaxZ[l] = -std::numeric_limits<float>::infinity();
+                    Node.m_Child[l] = xgeom::bvh_empty_v;
+                    continue;
+                }
+
+                const auto& B = m_Nodes[Children[l]];
+                Node.m_MinX[l] = B.m_BBox.m_Min[0]; Node.m_MinY[l] = B.m_BBox.m_Min[1]; Node.m_MinZ[l] = B.m_BBox.m_Min[2];
+                Node.m_MaxX[l] = B.m_BBox.m_Max[0]; Node.m_MaxY[l] = B.m_BBox.m_Max[1]; Node.m_MaxZ[l] = B.m_BBox.m_Max[2];
+
+                if( B.m_iLeft < 0 )
+                {
+                    Node.m_Child[l] = xgeom::bvh_leaf_bit_v | (B.m_nTris << xgeom::bvh_leaf_count_shift_v) | (iBaseTriangle + B.m_iFirst);
+                }
+                else
+                {
+                    // Nodes may grow, so the reference is taken again after the recursion
+                    const auto iChild = Collapse( Children[l], iBaseTriangle, Nodes );
+                    Nodes[iNode].m_Child[l] = iChild;
+                }
+            }
+
+            return iNode;
+        }
+
+        std::vector<node>                   m_Nodes;
+        std::vector<std::uint32_t>          m_Order;
+        std::vector<aabb>                   m_TriBox;
+        std::vector<std::array<float, 3>>   m_Centroid;
+        int                                 m_MaxLeafSize   { 4 };
+    };
+
+    //------------------------------------------------------------------------------------
+    // Indices are the triangles of the LOD as they are in the final index stream, iFirstIndex is where
+    // the first of them is so the triangles can point back at it
+
+    inline xgeom::bvh Build( std::span<const std::uint32_t> Indices, std::span<const std::uint32_t> IndexStart, std::span<const xcore::vector3d> Positions
+                           , int LeafSize, std::vector<xgeom::bvh_node>& Nodes, std::vector<xgeom::bvh_triangle>& Triangles )
+    {
+        xgeom::bvh BVH{ .m_iRoot = std::uint32_t(Nodes.size()), .m_nNodes = 0 };
+        const auto nTris = Indices.size() / 3;
+        if( nTris == 0 ) return BVH;
+
+        if( Triangles.size() + nTris >= (std::size_t(1) << xgeom::bvh_leaf_count_shift_v) )
+            throw(std::runtime_error( "Too many triangles for the raycast BVH" ));
+
+        builder Builder;
+        Builder.m_MaxLeafSize = std::clamp( LeafSize, 1, xgeom::bvh_max_leaf_size_v );
+        Builder.m_TriBox.resize( nTris );
+        Builder.m_Centroid.resize( nTris );
+        Builder.m_Order.resize( nTris );
+        Builder.m_Nodes.reserve( nTris * 2 );
+
+        auto P = [&]( std::size_t i ) { const auto& V = Positions[ Indices[i] ]; return std::array<float, 3>{ V.m_X, V.m_Y, V.m_Z }; };
+        for( std::size_t t = 0; t < nTris; ++t )
+        {
+            auto& Box = Builder.m_TriBox[t];
+            Box.Add( P( t * 3 + 0 ) );
+            Box.Add( P( t * 3 + 1 ) );
+            Box.Add( P( t * 3 + 2 ) );
+            for( int a = 0; a < 3; ++a ) Builder.m_Centroid[t][a] = (Box.m_Min[a] + Box.m_Max[a]) * 0.5f;
+            Builder.m_Order[t] = std::uint32_t(t);
+        }
+
+        Builder.m_Nodes.emplace_back();
+        Builder.BuildNode( 0, 0, std::uint32_t(nTris), 0 );
+
+        // Triangles in leaf order, every leaf is a contiguous run
+        const auto iBaseTriangle = std::uint32_t(Triangles.size());
+        for( const auto t : Builder.m_Order )
+        {
+            const auto V0 = P( t * 3 + 0 ), V1 = P( t * 3 + 1 ), V2 = P( t * 3 + 2 );
+            auto& T = Triangles.emplace_back();
+            for( int a = 0; a < 3; ++a )
+            {
+                T.m_V0[a]    = V0[a];
+                T.m_Edge1[a] = V1[a] - V0[a];
+                T.m_Edge2[a] = V2[a] - V0[a];
+            }
+            T.m_iIndex = IndexStart[t];
+        }
+
+        const auto nNodesBefore = Nodes.size();
+        BVH.m_iRoot  = Builder.Collapse( 0, iBaseTriangle, Nodes );
+        BVH.m_nNodes = std::uint32_t( Nodes.size() - nNodesBefore );
+        return BVH;
+    }
+}
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef XGEOM_COMPILER_CLUSTER_LOD_H
+#define XGEOM_COMPILER_CLUSTER_LOD_H
+#pragma once
+
+//
+// Cluster LOD DAG of a submesh (xgeom::cluster). The triangles are cut in clusters, neighbor clusters are
+// grouped, each group is simplified to half its triangles with the group border locked and cut in clusters
+// again, and so on until nothing is left to merge. Since the borders never move, any cut through the DAG
+// where every cluster is drawn with either itself or its replacement stitches without cracks.
+//
+namespace xgeom_compiler::cluster_lod
+{
+    using sphere = std::array<float, 4>;                        // xyz radius
+
+    struct cluster
+    {
+        std::vector<std::uint32_t>  m_Indices;                  // Into the submesh vertices
+        sphere                      m_Bounds;                   // Of the group this cluster came from (its own at level 0)
+        float                       m_Error;                    // Object space, 0 at level 0
+        sphere                      m_ParentBounds;
+        float                       m_ParentError;              // std::numeric_limits<float>::max() for the roots
+        int                         m_Level;
+    };
+
+    //------------------------------------------------------------------------------------
+    // Smallest sphere found by growing the biggest one until it holds the rest (not the optimal one)
+
+    inline sphere MergeSpheres( std::span<const sphere> Spheres )
+    {
+        sphere S = *std::max_element( Spheres.begin(), Spheres.end(), []( const sphere& A, const sphere& B ) { return A[3] < B[3]; } );
+        for( const auto& O : Spheres )
+        {
+            const float D = std::sqrt( (O[0]-S[0])*(O[0]-S[0]) + (O[1]-S[1])*(O[1]-S[1]) + (O[2]-S[2])*(O[2]-S[2]) );
+            if( D + O[3] <= S[3] ) continue;
+
+            const float R = (S[3] + D + O[3]) * 0.5f;
+            const float K = D > 0 ? (R - S[3]) / D : 0;
+            for( int a = 0; a < 3; ++a ) S[a] += (O[a] - S[a]) * K;
+            S[3] = R;
+        }
+        return S;
+    }
+
+    //------------------------------------------------------------------------------------
+    // Triangles cut in meshlets, the indices are expanded back into the submesh vertices
+
+    inline std::vector<std::vector<std::uint32_t>> Clusterize( std::span<const std::uint32_t> Indices, std::span<const xcore::vector3d> Positions, int MaxTriangles, int MaxVertices )
+    {
+        const auto MaxMeshlets = meshopt_buildMeshletsBound( Indices.size(), MaxVertices, MaxTriangles );
+
+        std::vector<meshopt_Meshlet> Meshlets( MaxMeshlets );
+        std::vector<unsigned int>    MeshletVertices( MaxMeshlets * MaxVertices );
+        std::vector<unsigned char>   MeshletTriangles( MaxMeshlets * MaxTriangles * 3 );
+        Meshlets.resize( meshopt_buildMeshlets( Meshlets.data(), MeshletVertices.data(), MeshletTriangles.data(), Indices.data(), Indices.size()
+                                              , &Positions[0].m_X, Positions.size(), sizeof(xcore::vector3d), MaxVertices, MaxTriangles, 0.0f ) );
+
+        std::vector<std::vector<std::uint32_t>> Result( Meshlets.size() );
+        for( std::size_t i = 0; i < Meshlets.size(); ++i )
+        {
+            const auto& M = Meshlets[i];
+            for( unsigned k = 0; k < M.triangle_count * 3; ++k )
+                Result[i].push_back( MeshletVertices[ M.vertex_offset + MeshletTriangles[ M.triangle_offset + k ] ] );
+        }
+        return Result;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline std::vector<cluster> Build( std::span<const std::uint32_t> Indices, std::span<const xcore::vector3d> Positions, int MaxTriangles, int MaxVertices, int GroupSize )
+    {
+        std::vector<cluster> Clusters;
+        if( Indices.size() < 3 ) return Clusters;
+
+        // meshopt_buildMeshlets limits
+        MaxVertices  = std::clamp( MaxVertices, 3, 255 );
+        MaxTriangles = std::clamp( MaxTriangles, 4, 512 ) & ~3;
+        GroupSize    = std::max( 2, GroupSize );
+
+        constexpr float root_error_v = std::numeric_limits<float>::max();
+        constexpr int   max_levels_v = 32;
+        const float     Scale        = meshopt_simplifyScale( &Positions[0].m_X, Positions.size(), sizeof(xcore::vector3d) );
+
+        // Vertex copies split by other attributes share the same id here, adjacency is about positions
+        std::vector<unsigned int> PositionID( Positions.size() );
+        {
+            std::vector<unsigned int> Identity( Positions.size() );
+            for( unsigned int i = 0; i < Identity.size(); ++i ) Identity[i] = i;
+            meshopt_generateVertexRemap( PositionID.data(), Identity.data(), Identity.size(), Positions.data(), Positions.size(), sizeof(xcore::vector3d) );
+        }
+
+        auto AddClusters = [&]( std::span<const std::uint32_t> Triangles, const sphere* pBounds, float Error, int Level, std::vector<int>& Out )
+        {
+            for( auto& I : Clusterize( Triangles, Positions, MaxTriangles, MaxVertices ) )
+            {
+                auto& C = Clusters.emplace_back();
+                if( pBounds ) C.m_Bounds = *pBounds;
+                else
+                {
+                    const auto B = meshopt_computeClusterBounds( I.data(), I.size(), &Positions[0].m_X, Positions.size(), sizeof(xcore::vector3d) );
+                    C.m_Bounds = sphere{ B.center[0], B.center[1], B.center[2], B.radius };
+                }
+                C.m_Indices      = std::move(I);
+                C.m_Error        = Error;
+                C.m_ParentBounds = C.m_Bounds;
+                C.m_ParentError  = root_error_v;
+                C.m_Level        = Level;
+                Out.push_back( int(Clusters.size() - 1) );
+            }
+        };
+
+        std::vector<int> Pending;
+        AddClusters( Indices, nullptr, 0.0f, 0, Pending );
+
+        for( int Level = 0; Pending.size() > 1 && Level < max_levels_v; ++Level )
+        {
+            //
+            // Weight between two clusters is how many vertices they share
+            //
+            std::unordered_map<unsigned int, std::vector<int>> VertexClusters;
+            for( int i = 0; i < int(Pending.size()); ++i )
+            {
+                for( const auto v : Clusters[Pending[i]].m_Indices )
+                {
+                    auto& L = VertexClusters[ PositionID[v] ];
+                    if( L.empty() || L.back() != i ) L.push_back( i );
+                }
+            }
+
+            std::vector<std::unordered_map<int, int>> Adjacency( Pending.size() );
+            for( const auto& [ID, L] : VertexClusters )
+            {
+                for( std::size_t a = 0; a < L.size(); ++a ) for( std::size_t b = a + 1; b < L.size(); ++b )
+                {
+                    Adjacency[L[a]][L[b]]++;
+                    Adjacency[L[b]][L[a]]++;
+                }
+            }
+
+            //
+            // Groups grow from a seed, always with the neighbor sharing the most vertices with the group
+            //
+            std::vector<std::vector<int>> Groups;
+            std::vector<std::uint8_t>     bGrouped( Pending.size(), 0 );
+            for( int Seed = 0; Seed < int(Pending.size()); ++Seed )
+            {
+                if( bGrouped[Seed] ) continue;
+
+                auto&                        G = Groups.emplace_back( 1, Seed );
+                std::unordered_map<int, int> Candidates;
+                bGrouped[Seed] = 1;
+
+                for( int Last = Seed; int(G.size()) < GroupSize; )
+                {
+                    for( const auto& [N, W] : Adjacency[Last] ) if( bGrouped[N] == 0 ) Candidates[N] += W;
+
+                    int Best = -1, BestW = 0;
+                    for( const auto& [N, W] : Candidates ) if( bGrouped[N] == 0 && (W > BestW || (W == BestW && N < Best)) ) { Best = N; BestW = W; }
+                    if( Best < 0 ) break;
+
+                    G.push_back( Best );
+                    bGrouped[Best] = 1;
+                    Last           = Best;
+                }
+            }
+
+            //
+            // Simplify every group with its border locked, groups that barely simplify stay as roots
+            //
+            std::vector<int>           Next;
+            std::vector<std::uint32_t> Merged, Simplified;
+            std::vector<sphere>        Spheres;
+            for( const auto& G : Groups )
+            {
+                Merged.clear();
+                Spheres.clear();
+                float ChildError = 0;
+                for( const auto i : G )
+                {
+                    const auto& C = Clusters[Pending[i]];
+                    Merged.insert( Merged.end(), C.m_Indices.begin(), C.m_Indices.end() );
+                    Spheres.push_back( C.m_Bounds );
+                    ChildError = std::max( ChildError, C.m_Error );
+                }
+                if( G.size() == 1 ) continue;
+
+                float SimplifyError = 0;
+                Simplified.resize( Merged.size() );
+                Simplified.resize( meshopt_simplify( Simplified.data(), Merged.data(), Merged.size(), &Positions[0].m_X, Positions.size(), sizeof(xcore::vector3d)
+                                                   , Merged.size() / 6 * 3, 1.0f, meshopt_SimplifyLockBorder, &SimplifyError ) );
+                if( Simplified.empty() || Simplified.size() > Merged.size() * 85 / 100 ) continue;
+
+                // Parents are never more precise than their children, the runtime cut depends on it
+                const sphere Bounds = MergeSpheres( Spheres );
+                const float  Error  = ChildError + SimplifyError * Scale;
+                for( const auto i : G )
+                {
+                    auto& C = Clusters[Pending[i]];
+                    C.m_ParentBounds = Bounds;
+                    C.m_ParentError  = Error;
+                }
+
+                AddClusters( Simplified, &Bounds, Error, Level + 1, Next );
+            }
+
+            Pending = std::move(Next);
+        }
+
+        return Clusters;
+    }
+}
+
+#endif
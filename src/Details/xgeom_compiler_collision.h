@@ -0,0 +1,160 @@
+#ifndef XGEOM_COMPILER_COLLISION_H
+#define XGEOM_COMPILER_COLLISION_H
+#pragma once
+
+//
+// Convex hulls for the physics proxies (xgeom::collision_shape). The input points are first reduced to the
+// support points of a set of evenly spread directions, which bounds the hull size, then the hull is built
+// incrementally. With a few dozen points the quadratic build is cheaper than anything smarter.
+//
+namespace xgeom_compiler::collision
+{
+    using vec3 = std::array<float, 3>;
+
+    inline vec3  Sub  ( const vec3& A, const vec3& B ) noexcept { return { A[0] - B[0], A[1] - B[1], A[2] - B[2] }; }
+    inline float Dot  ( const vec3& A, const vec3& B ) noexcept { return A[0] * B[0] + A[1] * B[1] + A[2] * B[2]; }
+    inline vec3  Cross( const vec3& A, const vec3& B ) noexcept { return { A[1] * B[2] - A[2] * B[1], A[2] * B[0] - A[0] * B[2], A[0] * B[1] - A[1] * B[0] }; }
+
+    //------------------------------------------------------------------------------------
+    // Farthest point along nDirections directions of a Fibonacci sphere, duplicates removed
+
+    inline std::vector<vec3> SelectSupportPoints( std::span<const vec3> Points, int nDirections )
+    {
+        std::vector<std::uint32_t> Picked;
+        if( Points.empty() ) return {};
+
+        constexpr float golden_angle_v = 2.39996323f;
+        for( int d = 0; d < nDirections; ++d )
+        {
+            const float Z   = 1.0f - 2.0f * (d + 0.5f) / nDirections;
+            const float R   = std::sqrt( std::max( 0.0f, 1.0f - Z * Z ) );
+            const vec3  Dir { R * std::cos( d * golden_angle_v ), R * std::sin( d * golden_angle_v ), Z };
+
+            std::uint32_t iBest = 0;
+            float         Best  = Dot( Points[0], Dir );
+            for( std::uint32_t i = 1; i < Points.size(); ++i )
+            {
+                if( const float V = Dot( Points[i], Dir ); V > Best ) { Best = V; iBest = i; }
+            }
+            Picked.push_back( iBest );
+        }
+
+        std::sort( Picked.begin(), Picked.end() );
+        Picked.erase( std::unique( Picked.begin(), Picked.end() ), Picked.end() );
+
+        std::vector<vec3> Result;
+        for( const auto i : Picked ) Result.push_back( Points[i] );
+        return Result;
+    }
+
+    //------------------------------------------------------------------------------------
+    // Hull triangles wound counter clockwise seen from outside. False when the points are flat or a
+    // single spot (no volume to wrap), the outputs are left empty then.
+
+    inline bool ComputeConvexHull( std::span<const vec3> Points, std::vector<vec3>& OutVerts, std::vector<std::uint32_t>& OutIndices )
+    {
+        OutVerts.clear();
+        OutIndices.clear();
+        if( Points.size() < 4 ) return false;
+
+        vec3 Min = Points[0], Max = Points[0];
+        for( const auto& P : Points ) for( int a = 0; a < 3; ++a ) { Min[a] = std::min( Min[a], P[a] ); Max[a] = std::max( Max[a], P[a] ); }
+        const float Eps = std::max( { Max[0] - Min[0], Max[1] - Min[1], Max[2] - Min[2] } ) * 1e-5f;
+        if( Eps <= 0 ) return false;
+
+        //
+        // Starting tetrahedron from the most spread out points
+        //
+        std::array<std::uint32_t, 4> T{ 0, 0, 0, 0 };
+        auto Farthest = [&]( auto&& Distance )
+        {
+            std::uint32_t iBest = 0;
+            float         Best  = -1;
+            for( std::uint32_t i = 0; i < Points.size(); ++i )
+            {
+                if( const float D = Distance( Points[i] ); D > Best ) { Best = D; iBest = i; }
+            }
+            return std::pair{ iBest, Best };
+        };
+
+        T[1] = Farthest( [&]( const vec3& P ) { const auto V = Sub( P, Points[T[0]] ); return Dot( V, V ); } ).first;
+        const auto Axis = Sub( Points[T[1]], Points[T[0]] );
+
+        const auto [i2, LineDist] = Farthest( [&]( const vec3& P ) { const auto C = Cross( Axis, Sub( P, Points[T[0]] ) ); return Dot( C, C ); } );
+        if( LineDist <= Eps * Eps * Dot( Axis, Axis ) ) return false;
+        T[2] = i2;
+
+        const auto Normal = Cross( Axis, Sub( Points[T[2]], Points[T[0]] ) );
+        const auto [i3, PlaneDist] = Farthest( [&]( const vec3& P ) { return std::abs( Dot( Normal, Sub( P, Points[T[0]] ) ) ); } );
+        if( PlaneDist <= Eps * std::sqrt( Dot( Normal, Normal ) ) ) return false;
+        T[3] = i3;
+
+        struct face
+        {
+            std::array<std::uint32_t, 3>    m_V;
+            vec3                            m_N;
+            float                           m_D;
+        };
+
+        auto MakeFace = [&]( std::uint32_t A, std::uint32_t B, std::uint32_t C )
+        {
+            face F{ .m_V = { A, B, C }, .m_N = Cross( Sub( Points[B], Points[A] ), Sub( Points[C], Points[A] ) ), .m_D = 0 };
+            const float Len = std::sqrt( Dot( F.m_N, F.m_N ) );
+            if( Len > 0 ) for( auto& V : F.m_N ) V /= Len;
+            F.m_D = Dot( F.m_N, Points[A] );
+            return F;
+        };
+
+        vec3 Center{};
+        for( const auto i : T ) for( int a = 0; a < 3; ++a ) Center[a] += Points[i][a] * 0.25f;
+
+        std::vector<face> Faces;
+        for( const auto& V : std::array<std::array<std::uint32_t, 3>, 4>{{ { T[0], T[1], T[2] }, { T[0], T[3], T[1] }, { T[1], T[3], T[2] }, { T[2], T[3], T[0] } }} )
+        {
+            auto F = MakeFace( V[0], V[1], V[2] );
+            if( Dot( F.m_N, Center ) - F.m_D > 0 ) F = MakeFace( V[0], V[2], V[1] );
+            Faces.push_back( F );
+        }
+
+        //
+        // Add the rest of the points, each one replaces the faces it sees with a fan to the horizon
+        //
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> Edges;
+        for( std::uint32_t i = 0; i < Points.size(); ++i )
+        {
+            if( i == T[0] || i == T[1] || i == T[2] || i == T[3] ) continue;
+
+            Edges.clear();
+            auto Visible = std::stable_partition( Faces.begin(), Faces.end(), [&]( const face& F ) { return Dot( F.m_N, Points[i] ) - F.m_D <= Eps; } );
+            if( Visible == Faces.end() ) continue;
+
+            for( auto It = Visible; It != Faces.end(); ++It )
+                for( int e = 0; e < 3; ++e ) Edges.emplace_back( It->m_V[e], It->m_V[(e + 1) % 3] );
+            Faces.erase( Visible, Faces.end() );
+
+            // Edges shared by two visible faces show up once each way, the horizon ones only once
+            for( const auto& E : Edges )
+            {
+                if( std::find( Edges.begin(), Edges.end(), std::pair{ E.second, E.first } ) == Edges.end() )
+                    Faces.push_back( MakeFace( E.first, E.second, i ) );
+            }
+        }
+
+        //
+        // Compact the vertices that ended up on the hull
+        //
+        std::vector<std::uint32_t> Remap( Points.size(), ~0u );
+        for( const auto& F : Faces )
+        {
+            for( const auto V : F.m_V )
+            {
+                if( Remap[V] == ~0u ) { Remap[V] = std::uint32_t(OutVerts.size()); OutVerts.push_back( Points[V] ); }
+                OutIndices.push_back( Remap[V] );
+            }
+        }
+
+        return true;
+    }
+}
+
+#endif
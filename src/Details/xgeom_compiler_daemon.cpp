@@ -0,0 +1,624 @@
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <list>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <utility>
+#include <cstdlib>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <afunix.h>
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <unistd.h>
+#endif
+
+namespace xgeom_compiler::daemon::details
+{
+#if defined(_WIN32)
+    using native_socket = SOCKET;
+    constexpr native_socket invalid_socket_v = INVALID_SOCKET;
+    inline void CloseNativeSocket( native_socket S ) noexcept { closesocket(S); }
+#else
+    using native_socket = int;
+    constexpr native_socket invalid_socket_v = -1;
+    inline void CloseNativeSocket( native_socket S ) noexcept { close(S); }
+#endif
+
+#if defined(MSG_NOSIGNAL)
+    constexpr int send_flags_v = MSG_NOSIGNAL;
+#else
+    constexpr int send_flags_v = 0;
+#endif
+
+    constexpr std::size_t max_line_size_v = 1024 * 1024;       // Requests are a command line, anything longer is garbage
+
+    //------------------------------------------------------------------------------------
+
+    inline bool InitSockets( void ) noexcept
+    {
+#if defined(_WIN32)
+        static const bool bOk = []
+        {
+            WSADATA Data;
+            return WSAStartup( MAKEWORD(2, 2), &Data ) == 0;
+        }();
+        return bOk;
+#else
+        return true;
+#endif
+    }
+
+    //------------------------------------------------------------------------------------
+
+    struct socket
+    {
+                        socket      ( void )                    noexcept = default;
+        explicit        socket      ( native_socket Handle )    noexcept : m_Handle{ Handle } {}
+                        socket      ( socket&& Other )          noexcept : m_Handle{ std::exchange(Other.m_Handle, invalid_socket_v) }, m_Pending{ std::move(Other.m_Pending) } {}
+                       ~socket      ( void )                    noexcept { Close(); }
+
+        socket& operator = ( socket&& Other ) noexcept
+        {
+            if( this != &Other )
+            {
+                Close();
+                m_Handle  = std::exchange( Other.m_Handle, invalid_socket_v );
+                m_Pending = std::move( Other.m_Pending );
+            }
+            return *this;
+        }
+
+        bool isValid( void ) const noexcept
+        {
+            return m_Handle != invalid_socket_v;
+        }
+
+        void Close( void ) noexcept
+        {
+            if( isValid() ) CloseNativeSocket( std::exchange( m_Handle, invalid_socket_v ) );
+        }
+
+        // Sends and receives give up after the given time instead of blocking forever
+        void SetTimeout( int MS ) noexcept
+        {
+#if defined(_WIN32)
+            const DWORD Timeout = DWORD(MS);
+#else
+            const timeval Timeout{ .tv_sec = MS / 1000, .tv_usec = (MS % 1000) * 1000 };
+#endif
+            ::setsockopt( m_Handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&Timeout), sizeof(Timeout) );
+            ::setsockopt( m_Handle, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&Timeout), sizeof(Timeout) );
+        }
+
+        bool SendLine( std::string_view Line ) noexcept
+        {
+            std::string Buffer{ Line };
+            Buffer.push_back('\n');
+
+            for( std::size_t Sent = 0; Sent < Buffer.size(); )
+            {
+                const auto n = ::send( m_Handle, Buffer.data() + Sent, int(Buffer.size() - Sent), send_flags_v );
+                if( n <= 0 ) return false;
+                Sent += std::size_t(n);
+            }
+            return true;
+        }
+
+        bool ReadLine( std::string& Line ) noexcept
+        {
+            while( true )
+            {
+                if( auto Pos = m_Pending.find('\n'); Pos != std::string::npos )
+                {
+                    Line = m_Pending.substr( 0, Pos );
+                    m_Pending.erase( 0, Pos + 1 );
+                    return true;
+                }
+
+                if( m_Pending.size() > max_line_size_v ) return false;
+
+                char Buffer[4096];
+                const auto n = ::recv( m_Handle, Buffer, int(sizeof(Buffer)), 0 );
+                if( n <= 0 ) return false;
+                m_Pending.append( Buffer, std::size_t(n) );
+            }
+        }
+
+        native_socket   m_Handle    { invalid_socket_v };
+        std::string     m_Pending   {};
+    };
+
+    //------------------------------------------------------------------------------------
+
+    struct address
+    {
+        sockaddr_storage    m_Storage   {};
+        socklen_t           m_Length    { 0 };
+        std::string         m_UnixPath  {};
+    };
+
+    //------------------------------------------------------------------------------------
+
+    inline bool ParseAddress( std::string_view Address, address& Out ) noexcept
+    {
+        constexpr std::string_view unix_prefix_v = "unix:";
+
+        if( Address.starts_with(unix_prefix_v) )
+        {
+            auto& Unix = reinterpret_cast<sockaddr_un&>(Out.m_Storage);
+            Out.m_UnixPath = std::string( Address.substr( unix_prefix_v.size() ) );
+            if( Out.m_UnixPath.empty() || Out.m_UnixPath.size() >= sizeof(Unix.sun_path) ) return false;
+
+            Unix.sun_family = AF_UNIX;
+            std::memcpy( Unix.sun_path, Out.m_UnixPath.c_str(), Out.m_UnixPath.size() + 1 );
+            Out.m_Length = socklen_t(sizeof(sockaddr_un));
+            return true;
+        }
+
+        constexpr std::string_view tcp_prefix_v = "tcp:";
+
+        if( Address.starts_with(tcp_prefix_v) )
+        {
+            const auto HostPort = Address.substr( tcp_prefix_v.size() );
+            const auto Colon    = HostPort.rfind(':');
+            if( Colon == std::string_view::npos ) return false;
+
+            const std::string Host( HostPort.substr( 0, Colon ) );
+            const std::string Port( HostPort.substr( Colon + 1 ) );
+
+            // No host means loopback, every interface has to be asked for explicitly ("tcp:0.0.0.0:<port>")
+            addrinfo Hints{};
+            Hints.ai_family   = AF_UNSPEC;
+            Hints.ai_socktype = SOCK_STREAM;
+            Hints.ai_flags    = 0;
+
+            addrinfo* pResult = nullptr;
+            if( ::getaddrinfo( Host.empty() ? nullptr : Host.c_str(), Port.c_str(), &Hints, &pResult ) != 0 || pResult == nullptr ) return false;
+
+            std::memcpy( &Out.m_Storage, pResult->ai_addr, pResult->ai_addrlen );
+            Out.m_Length = socklen_t(pResult->ai_addrlen);
+            ::freeaddrinfo( pResult );
+            return true;
+        }
+
+        return false;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline std::vector<std::string> SplitFields( std::string_view Line ) noexcept
+    {
+        std::vector<std::string> Fields;
+        for( std::size_t Start = 0; Start <= Line.size(); )
+        {
+            auto End = Line.find( '\t', Start );
+            if( End == std::string_view::npos ) End = Line.size();
+            Fields.emplace_back( Line.substr( Start, End - Start ) );
+            Start = End + 1;
+        }
+        return Fields;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline std::string JoinFields( const std::vector<std::string>& Fields ) noexcept
+    {
+        std::string Line;
+        for( const auto& F : Fields )
+        {
+            if( &F != &Fields.front() ) Line.push_back('\t');
+            Line += F;
+        }
+        return Line;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline bool isLoopback( const address& Addr ) noexcept
+    {
+        if( Addr.m_UnixPath.empty() == false ) return true;
+
+        if( Addr.m_Storage.ss_family == AF_INET )
+            return (ntohl( reinterpret_cast<const sockaddr_in&>(Addr.m_Storage).sin_addr.s_addr ) >> 24) == 127;
+
+        if( Addr.m_Storage.ss_family == AF_INET6 )
+        {
+            const auto& A6 = reinterpret_cast<const sockaddr_in6&>(Addr.m_Storage).sin6_addr;
+            return std::memcmp( &A6, &in6addr_loopback, sizeof(A6) ) == 0;
+        }
+
+        return false;
+    }
+
+    //------------------------------------------------------------------------------------
+    // Shared secret of the daemon and its clients, needed by daemons that listen beyond this machine
+
+    inline std::string getToken( void ) noexcept
+    {
+        const char* p = std::getenv( "XGEOM_DAEMON_TOKEN" );
+        return p ? std::string(p) : std::string{};
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline socket Listen( std::string_view Address, bool bHasToken ) noexcept
+    {
+        address Addr;
+        if( InitSockets() == false || ParseAddress( Address, Addr ) == false ) return {};
+
+        // Anybody on the network could make us write files otherwise
+        if( bHasToken == false && isLoopback(Addr) == false )
+        {
+            printf( "WARNING: Daemons listening beyond this machine need XGEOM_DAEMON_TOKEN set\n" );
+            return {};
+        }
+
+        // A socket file left behind by a previous daemon would make the bind fail
+        if( Addr.m_UnixPath.empty() == false )
+        {
+            std::error_code Ec;
+            std::filesystem::remove( Addr.m_UnixPath, Ec );
+        }
+
+        socket Listener{ ::socket( Addr.m_Storage.ss_family, SOCK_STREAM, 0 ) };
+        if( Listener.isValid() == false ) return {};
+
+        // Workers get restarted often, do not wait for the old port to time out
+        if( Addr.m_UnixPath.empty() )
+        {
+            const int bReuse = 1;
+            ::setsockopt( Listener.m_Handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&bReuse), sizeof(bReuse) );
+        }
+
+        if( ::bind( Listener.m_Handle, reinterpret_cast<const sockaddr*>(&Addr.m_Storage), Addr.m_Length ) != 0 ) return {};
+        if( ::listen( Listener.m_Handle, SOMAXCONN ) != 0 ) return {};
+
+        return Listener;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline socket Accept( socket& Listener ) noexcept
+    {
+        return socket{ ::accept( Listener.m_Handle, nullptr, nullptr ) };
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline socket Connect( std::string_view Address ) noexcept
+    {
+        address Addr;
+        if( InitSockets() == false || ParseAddress( Address, Addr ) == false ) return {};
+
+        socket Client{ ::socket( Addr.m_Storage.ss_family, SOCK_STREAM, 0 ) };
+        if( Client.isValid() == false ) return {};
+
+        if( ::connect( Client.m_Handle, reinterpret_cast<const sockaddr*>(&Addr.m_Storage), Addr.m_Length ) != 0 ) return {};
+
+        // Every connection starts by presenting the token, empty when the daemon is local
+        if( Client.SendLine( JoinFields( { "HELLO", getToken() } ) ) == false ) return {};
+
+        return Client;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    struct file_stamp
+    {
+        std::string                     m_Path          {};
+        std::filesystem::file_time_type m_WriteTime     {};
+        std::uintmax_t                  m_FileSize      {};
+
+        static file_stamp Make( const std::string& Path ) noexcept
+        {
+            std::error_code Ec;
+            file_stamp      Stamp{ .m_Path = Path };
+            Stamp.m_WriteTime = std::filesystem::last_write_time( Path, Ec );
+            Stamp.m_FileSize  = Ec ? std::uintmax_t(-1) : std::filesystem::file_size( Path, Ec );
+            return Stamp;
+        }
+
+        bool isCurrent( void ) const noexcept
+        {
+            const auto Now = Make(m_Path);
+            return Now.m_WriteTime == m_WriteTime && Now.m_FileSize == m_FileSize;
+        }
+    };
+
+    //------------------------------------------------------------------------------------
+
+    inline bool ReadWholeFile( const std::string& Path, std::vector<char>& Data ) noexcept
+    {
+        std::ifstream File( Path, std::ios::binary | std::ios::ate );
+        if( !File ) return false;
+        Data.resize( std::size_t(File.tellg()) );
+        File.seekg(0);
+        return bool( File.read( Data.data(), std::streamsize(Data.size()) ) );
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline bool WriteWholeFile( const std::string& Path, const std::vector<char>& Data ) noexcept
+    {
+        std::ofstream File( Path, std::ios::binary | std::ios::trunc );
+        if( !File ) return false;
+        return bool( File.write( Data.data(), std::streamsize(Data.size()) ) );
+    }
+
+    //------------------------------------------------------------------------------------
+
+    struct server
+    {
+        struct result
+        {
+            std::string                                             m_Key           {};
+            std::string                                             m_WorkingDir    {};
+            std::vector<std::string>                                m_Args          {};
+            std::vector<file_stamp>                                 m_Dependencies  {};
+            std::vector<std::pair<std::string, std::vector<char>>>  m_Outputs       {};
+        };
+
+        //------------------------------------------------------------------------------------
+
+        bool isUpToDate( const result& Result ) const noexcept
+        {
+            for( const auto& D : Result.m_Dependencies )
+                if( D.isCurrent() == false ) return false;
+            return true;
+        }
+
+        //------------------------------------------------------------------------------------
+
+        void RestoreOutputs( const result& Result ) noexcept
+        {
+            // Same size says nothing about the content, only identical files are left alone
+            std::vector<char> OnDisk;
+            for( const auto& [Path, Data] : Result.m_Outputs )
+            {
+                if( ReadWholeFile( Path, OnDisk ) && OnDisk == Data ) continue;
+
+                if( WriteWholeFile( Path, Data ) == false )
+                    printf( "WARNING: Daemon failed to restore (%s) from its cache\n", Path.c_str() );
+            }
+        }
+
+        //------------------------------------------------------------------------------------
+
+        std::string Compile( const std::string& WorkingDir, const std::vector<std::string>& Args, bool bForce ) noexcept
+        {
+            std::scoped_lock Lock( m_Lock );
+
+            // The same relative arguments mean different things in different projects
+            std::vector<std::string> KeyFields{ WorkingDir };
+            KeyFields.insert( KeyFields.end(), Args.begin(), Args.end() );
+            auto Key = JoinFields(KeyFields);
+            if( auto It = m_ResultIndex.find(Key); It != m_ResultIndex.end() )
+            {
+                if( bForce == false && isUpToDate(*It->second) )
+                {
+                    m_Results.splice( m_Results.begin(), m_Results, It->second );
+                    RestoreOutputs( m_Results.front() );
+                    m_nHits++;
+                    return "OK\tcached";
+                }
+
+                m_Results.erase( It->second );
+                m_ResultIndex.erase( It );
+            }
+
+            m_nMisses++;
+
+            // The working directory is process wide, it is only touched under m_Lock which every job runs in
+            std::error_code Ec;
+            std::filesystem::current_path( WorkingDir, Ec );
+            if( Ec ) return "ERROR\tInvalid working directory";
+
+            job_result JobResult;
+            try
+            {
+                JobResult = m_JobFunction( Args );
+            }
+            catch( const std::exception& Error )
+            {
+                printf( "%s\n", Error.what() );
+                JobResult.m_Error = xerr_failure_s( "Exception while compiling" );
+            }
+
+            if( JobResult.m_Error ) return std::string("ERROR\t") + JobResult.m_Error.getCode().m_pString;
+
+            //
+            // Remember the result so the next identical request is free
+            //
+            // Paths are made absolute so they stay valid once another job moves the working directory
+            result Result{ .m_Key = Key, .m_WorkingDir = WorkingDir, .m_Args = Args };
+            for( const auto& D : JobResult.m_Dependencies ) Result.m_Dependencies.push_back( file_stamp::Make( std::filesystem::absolute( D, Ec ).string() ) );
+            for( const auto& O : JobResult.m_Outputs )
+            {
+                auto& Output = Result.m_Outputs.emplace_back();
+                Output.first = std::filesystem::absolute( O, Ec ).string();
+                if( ReadWholeFile( O, Output.second ) == false ) Result.m_Outputs.pop_back();
+            }
+
+            m_Results.push_front( std::move(Result) );
+            m_ResultIndex[Key] = m_Results.begin();
+
+            while( m_Results.size() > m_Settings.m_ResultCacheSize )
+            {
+                m_ResultIndex.erase( m_Results.back().m_Key );
+                m_Results.pop_back();
+            }
+
+            return "OK";
+        }
+
+        //------------------------------------------------------------------------------------
+
+        void Watch( void ) noexcept
+        {
+            while( m_bQuit == false )
+            {
+                std::this_thread::sleep_for( std::chrono::milliseconds( m_Settings.m_WatchIntervalMS ) );
+
+                std::vector<std::pair<std::string, std::vector<std::string>>> Stale;
+                {
+                    std::scoped_lock Lock( m_Lock );
+                    for( const auto& R : m_Results )
+                        if( isUpToDate(R) == false ) Stale.emplace_back( R.m_WorkingDir, R.m_Args );
+                }
+
+                for( const auto& [WorkingDir, Args] : Stale )
+                {
+                    if( m_bQuit ) break;
+                    const auto Reply = Compile( WorkingDir, Args, true );
+                    printf( "INFO: Source changed, recompiled (%s) %s\n", JoinFields(Args).c_str(), Reply.c_str() );
+                }
+            }
+        }
+
+        //------------------------------------------------------------------------------------
+
+        std::string Dispatch( const std::vector<std::string>& Fields ) noexcept
+        {
+            const auto& Command = Fields[0];
+
+            if( Command == "COMPILE" && Fields.size() >= 2 )
+            {
+                // Remote requests (workers) leave the working directory empty and use the one we started in
+                return Compile( Fields[1].empty() ? m_HomeDir : Fields[1], std::vector<std::string>( Fields.begin() + 2, Fields.end() ), false );
+            }
+
+            if( Command == "PING" )
+                return "OK";
+
+            if( Command == "STATS" )
+            {
+                std::scoped_lock Lock( m_Lock );
+                return xcore::string::Fmt( "OK\t%d results cached, %d hits, %d misses", int(m_Results.size()), m_nHits, m_nMisses ).data();
+            }
+
+            if( Command == "SHUTDOWN" )
+            {
+                m_bQuit = true;
+                return "OK";
+            }
+
+            return "ERROR\tUnknown command";
+        }
+
+        settings                                                            m_Settings;
+        std::string                                                         m_HomeDir;
+        job_function                                                        m_JobFunction;
+        std::mutex                                                          m_Lock;
+        std::list<result>                                                   m_Results;
+        std::unordered_map<std::string, std::list<result>::iterator>        m_ResultIndex;
+        std::atomic<bool>                                                   m_bQuit     { false };
+        int                                                                 m_nHits     { 0 };
+        int                                                                 m_nMisses   { 0 };
+    };
+}
+
+namespace xgeom_compiler::daemon
+{
+    //------------------------------------------------------------------------------------
+
+    xcore::err Serve( const settings& Settings, job_function JobFunction ) noexcept
+    {
+        const auto Token    = details::getToken();
+        auto       Listener = details::Listen( Settings.m_Address, Token.empty() == false );
+        if( Listener.isValid() == false ) return xerr_failure_s( "Daemon failed to listen in the given address" );
+
+        details::server Server;
+        Server.m_Settings    = Settings;
+        Server.m_JobFunction = std::move(JobFunction);
+        Server.m_HomeDir     = std::filesystem::current_path().string();
+
+        printf( "INFO: Daemon listening at %s\n", Settings.m_Address.c_str() );
+
+        std::thread Watcher( [&]{ Server.Watch(); } );
+
+        while( Server.m_bQuit == false )
+        {
+            auto Client = details::Accept( Listener );
+            if( Client.isValid() == false ) continue;
+
+            // Requests are served one at a time, a client that stalls only holds the daemon for the timeout
+            Client.SetTimeout( Settings.m_ClientTimeoutMS );
+
+            std::string Line;
+            if( Client.ReadLine(Line) == false ) continue;
+
+            if( const auto Hello = details::SplitFields(Line); Hello[0] != "HELLO" || Hello.size() != 2 || Hello[1] != Token )
+            {
+                (void)Client.SendLine( "ERROR\tNot authorized" );
+                continue;
+            }
+
+            if( Client.ReadLine(Line) == false ) continue;
+
+            (void)Client.SendLine( Server.Dispatch( details::SplitFields(Line) ) );
+        }
+
+        Watcher.join();
+        return {};
+    }
+
+    //------------------------------------------------------------------------------------
+
+    xcore::err Submit( std::string_view Address, const std::vector<std::string>& Args, bool& bDaemonReached ) noexcept
+    {
+        bDaemonReached = false;
+
+        auto Client = details::Connect( Address );
+        if( Client.isValid() == false ) return xerr_failure_s( "Unable to reach the daemon" );
+
+        std::vector<std::string> Fields{ "COMPILE", std::filesystem::current_path().string() };
+        Fields.insert( Fields.end(), Args.begin(), Args.end() );
+
+        std::string Reply;
+        if( Client.SendLine( details::JoinFields(Fields) ) == false || Client.ReadLine(Reply) == false )
+            return xerr_failure_s( "Unable to reach the daemon" );
+
+        bDaemonReached = true;
+
+        const auto ReplyFields = details::SplitFields(Reply);
+        if( ReplyFields[0] == "OK" ) return {};
+
+        printf( "%s\n", ReplyFields.size() > 1 ? ReplyFields[1].c_str() : Reply.c_str() );
+        return xerr_failure_s( "The daemon failed to compile the resource" );
+    }
+
+    //------------------------------------------------------------------------------------
+
+    xcore::err Ping( std::string_view Address ) noexcept
+    {
+        auto        Client = details::Connect( Address );
+        std::string Reply;
+        if( Client.isValid() == false || Client.SendLine("PING") == false || Client.ReadLine(Reply) == false )
+            return xerr_failure_s( "Unable to reach the daemon" );
+        return {};
+    }
+
+    //------------------------------------------------------------------------------------
+
+    xcore::err Shutdown( std::string_view Address ) noexcept
+    {
+        auto        Client = details::Connect( Address );
+        std::string Reply;
+        if( Client.isValid() == false || Client.SendLine("SHUTDOWN") == false || Client.ReadLine(Reply) == false )
+            return xerr_failure_s( "Unable to reach the daemon" );
+        return {};
+    }
+}
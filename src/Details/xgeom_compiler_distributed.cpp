@@ -0,0 +1,326 @@
+
+#include <condition_variable>
+#include <cstdlib>
+#include <random>
+
+namespace xgeom_compiler::distributed::details
+{
+    //------------------------------------------------------------------------------------
+    // FNV-1a, stable across machines and compilers which is all the store needs
+
+    struct hasher
+    {
+        void Add( const void* pData, std::size_t Size ) noexcept
+        {
+            auto p = static_cast<const std::uint8_t*>(pData);
+            for( std::size_t i = 0; i < Size; ++i )
+            {
+                m_Value ^= p[i];
+                m_Value *= 0x100000001b3ull;
+            }
+        }
+
+        void Add( std::string_view String ) noexcept
+        {
+            Add( String.data(), String.size() );
+            Add( "\0", 1 );
+        }
+
+        bool AddFile( const std::string& Path ) noexcept
+        {
+            std::ifstream File( Path, std::ios::binary );
+            if( !File ) return false;
+
+            std::array<char, 64 * 1024> Buffer;
+            while( File )
+            {
+                File.read( Buffer.data(), std::streamsize(Buffer.size()) );
+                Add( Buffer.data(), std::size_t(File.gcount()) );
+            }
+            return true;
+        }
+
+        std::uint64_t m_Value { 0xcbf29ce484222325ull };
+    };
+
+    //------------------------------------------------------------------------------------
+    // Version of the bytes the compiler writes. Bump it whenever a change makes the compiler write different
+    // output for the same inputs, older artifacts in the store stop matching and get rebuilt
+
+    constexpr int compiler_output_version_v = 1;
+
+    //------------------------------------------------------------------------------------
+
+    inline std::string KeyToString( std::uint64_t Key ) noexcept
+    {
+        return xcore::string::Fmt( "%016llx", static_cast<unsigned long long>(Key) ).data();
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline std::filesystem::path getArtifactPath( std::string_view StorePath, std::uint64_t InputKey, int iTarget ) noexcept
+    {
+        return std::filesystem::path(StorePath) / KeyToString(InputKey) / xcore::string::Fmt( "%d.xgeom", iTarget ).data();
+    }
+
+    //------------------------------------------------------------------------------------
+    // These switches are paths that change from machine to machine, what they point to is hashed instead.
+    // -FSYNC does not change the artifact at all.
+
+    inline bool isMachineSpecificSwitch( std::string_view Arg ) noexcept
+    {
+        return Arg == "-INPUT" || Arg == "-OUTPUT" || Arg == "-PROJECT" || Arg == "-EDITOR" || Arg == "-ASSETS" || Arg == "-STORE" || Arg == "-FSYNC";
+    }
+
+    //------------------------------------------------------------------------------------
+
+    enum class job_status
+    { OK
+    , FAILED
+    , UNREACHABLE
+    };
+
+    inline job_status SendJob( const std::string& Address, const std::vector<std::string>& Args, std::string& Message ) noexcept
+    {
+        auto Client = daemon::details::Connect( Address );
+        if( Client.isValid() == false ) return job_status::UNREACHABLE;
+
+        // Empty working directory, workers resolve the paths from their own
+        std::vector<std::string> Fields{ "COMPILE", "" };
+        Fields.insert( Fields.end(), Args.begin(), Args.end() );
+
+        std::string Reply;
+        if( Client.SendLine( daemon::details::JoinFields(Fields) ) == false || Client.ReadLine(Reply) == false )
+            return job_status::UNREACHABLE;
+
+        const auto ReplyFields = daemon::details::SplitFields(Reply);
+        if( ReplyFields[0] == "OK" ) return job_status::OK;
+
+        Message = ReplyFields.size() > 1 ? ReplyFields[1] : Reply;
+        return job_status::FAILED;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    inline bool SpawnLocalWorker( const std::string& ExePath, const std::string& Address ) noexcept
+    {
+#if defined(_WIN32)
+        const auto Command = xcore::string::Fmt( "start \"xgeom worker\" /b \"%s\" -DAEMON \"%s\"", ExePath.c_str(), Address.c_str() );
+#else
+        const auto Command = xcore::string::Fmt( "\"%s\" -DAEMON \"%s\" &", ExePath.c_str(), Address.c_str() );
+#endif
+        if( std::system( Command.data() ) != 0 ) return false;
+
+        // Give it some time to start listening
+        for( int i = 0; i < 100; ++i )
+        {
+            if( !daemon::Ping(Address) ) return true;
+            std::this_thread::sleep_for( std::chrono::milliseconds(100) );
+        }
+
+        return false;
+    }
+}
+
+namespace xgeom_compiler::distributed
+{
+    //------------------------------------------------------------------------------------
+
+    bool ComputeInputKey( std::uint64_t& InputKey, std::string_view DescriptorPath, std::string_view AssetsRootPath, const std::vector<std::string>& Args ) noexcept
+    {
+        details::hasher Hasher;
+
+        Hasher.Add( xcore::string::Fmt( "xgeom %d.%d runtime %d output %d", version_major_v, version_minor_v, int(xgeom::VERSION), details::compiler_output_version_v ).data() );
+
+        for( auto i = 0u; i < Args.size(); ++i )
+        {
+            if( details::isMachineSpecificSwitch(Args[i]) ) { ++i; continue; }
+            Hasher.Add( Args[i] );
+        }
+
+        // A key that misses an input would match artifacts compiled from something else
+        descriptor Descriptor;
+        if( Hasher.AddFile( std::string(DescriptorPath) ) == false ) return false;
+        if( descriptor::Serialize( Descriptor, DescriptorPath, true ) ) return false;
+        if( Hasher.AddFile( xcore::string::Fmt( "%s/%s", std::string(AssetsRootPath).c_str(), Descriptor.m_Main.m_MeshAsset.data() ).data() ) == false ) return false;
+        if( Descriptor.m_Main.m_UseSkeletonFile.empty() == false
+            && Hasher.AddFile( xcore::string::Fmt( "%s/%s", std::string(AssetsRootPath).c_str(), Descriptor.m_Main.m_UseSkeletonFile.data() ).data() ) == false ) return false;
+
+        InputKey = Hasher.m_Value;
+        return true;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    bool FetchArtifact( std::string_view StorePath, std::uint64_t InputKey, int iTarget, std::string_view DestinationPath ) noexcept
+    {
+        std::error_code Ec;
+        std::filesystem::copy_file( details::getArtifactPath( StorePath, InputKey, iTarget ), DestinationPath, std::filesystem::copy_options::overwrite_existing, Ec );
+        return !Ec;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    void PublishArtifact( std::string_view StorePath, std::uint64_t InputKey, int iTarget, std::string_view SourcePath ) noexcept
+    {
+        const auto      FinalPath = details::getArtifactPath( StorePath, InputKey, iTarget );
+        auto            TempPath  = FinalPath;
+        std::error_code Ec;
+
+        // Copy with a unique name and rename so other workers never see a partial file
+        TempPath += xcore::string::Fmt( ".%08x%08x.tmp", std::random_device{}(), std::random_device{}() ).data();
+
+        std::filesystem::create_directories( FinalPath.parent_path(), Ec );
+        std::filesystem::copy_file( SourcePath, TempPath, std::filesystem::copy_options::overwrite_existing, Ec );
+        if( !Ec ) std::filesystem::rename( TempPath, FinalPath, Ec );
+        if( Ec )
+        {
+            std::filesystem::remove( TempPath, Ec );
+            printf( "WARNING: Failed to publish (%s) into the artifact store\n", std::string(SourcePath).c_str() );
+        }
+    }
+
+    //------------------------------------------------------------------------------------
+
+    std::vector<job> EnumerateJobs( std::string_view ProjectPath, std::string_view AssetsRootPath, std::string_view StorePath, const std::vector<std::string>& Args ) noexcept
+    {
+        std::vector<job> Jobs;
+        std::error_code  Ec;
+        const auto       ResourcesPath = std::filesystem::path(ProjectPath) / "Resources" / "xgeom";
+
+        for( auto It = std::filesystem::recursive_directory_iterator( ResourcesPath, Ec ); !Ec && It != std::filesystem::recursive_directory_iterator(); It.increment(Ec) )
+        {
+            if( It->path().filename() != "ResourceDesc.txt" ) continue;
+
+            auto& Job = Jobs.emplace_back();
+
+            // The input of each job is the descriptor folder relative to <PROJECT>/Resources/xgeom
+            Job.m_Name = std::filesystem::relative( It->path().parent_path(), ResourcesPath, Ec ).generic_string();
+            Job.m_Args = Args;
+            if( auto i = std::find( Job.m_Args.begin(), Job.m_Args.end(), "-INPUT" ); i != Job.m_Args.end() && i + 1 != Job.m_Args.end() ) *(i + 1) = Job.m_Name;
+            else                                                                                                                           Job.m_Args.insert( Job.m_Args.end(), { "-INPUT", Job.m_Name } );
+
+            const bool bHasKey = ComputeInputKey( Job.m_InputKey, It->path().string(), AssetsRootPath, Job.m_Args );
+
+            //
+            // Cost estimate, the size of the source asset is a good proxy of import and compile time
+            //
+            if( bHasKey && StorePath.empty() == false && std::filesystem::exists( details::getArtifactPath( StorePath, Job.m_InputKey, 0 ).parent_path(), Ec ) )
+            {
+                Job.m_Cost = 1;
+            }
+            else
+            {
+                descriptor Descriptor;
+                Job.m_Cost = std::filesystem::file_size( It->path(), Ec );
+                if( !descriptor::Serialize( Descriptor, It->path().string(), true ) )
+                {
+                    const auto Size = std::filesystem::file_size( xcore::string::Fmt( "%s/%s", std::string(AssetsRootPath).c_str(), Descriptor.m_Main.m_MeshAsset.data() ).data(), Ec );
+                    if( !Ec ) Job.m_Cost += Size;
+                }
+            }
+        }
+
+        return Jobs;
+    }
+
+    //------------------------------------------------------------------------------------
+
+    xcore::err RunCoordinator( const settings& Settings, std::vector<job> Jobs ) noexcept
+    {
+        std::vector<std::string> Workers = Settings.m_Workers;
+        std::vector<std::string> LocalWorkers;
+
+        for( int i = 0; i < Settings.m_nLocalWorkers; ++i )
+        {
+            const std::string Address = xcore::string::Fmt( "tcp:127.0.0.1:%d", Settings.m_LocalBasePort + i ).data();
+            if( details::SpawnLocalWorker( Settings.m_ExePath, Address ) )
+            {
+                Workers.push_back( Address );
+                LocalWorkers.push_back( Address );
+            }
+            else
+            {
+                printf( "WARNING: Failed to start a local worker at %s\n", Address.c_str() );
+            }
+        }
+
+        if( Workers.empty() ) return xerr_failure_s( "The coordinator has no workers" );
+
+        //
+        // Longest jobs first, each worker pulls the next job when it is done which keeps them equally busy
+        //
+        std::sort( Jobs.begin(), Jobs.end(), []( const job& A, const job& B ) { return A.m_Cost > B.m_Cost; } );
+
+        std::mutex              Lock;
+        std::condition_variable Wake;
+        std::vector<job*>       Retry;
+        std::size_t             iNext     = 0;
+        int                     nInFlight = 0;
+        int                     nFailed   = 0;
+
+        // With nothing left to hand out a worker waits for the jobs in flight, one may come back from a retired worker
+        auto PopJob = [&]() -> job*
+        {
+            std::unique_lock L( Lock );
+            Wake.wait( L, [&]{ return Retry.empty() == false || iNext < Jobs.size() || nInFlight == 0; } );
+
+            job* p = nullptr;
+            if( Retry.empty() == false ) { p = Retry.back(); Retry.pop_back(); }
+            else if( iNext < Jobs.size() ) p = &Jobs[iNext++];
+
+            if( p ) nInFlight++;
+            return p;
+        };
+
+        std::vector<std::thread> Threads;
+        for( const auto& Address : Workers )
+        {
+            Threads.emplace_back( [&, Address]
+            {
+                while( auto pJob = PopJob() )
+                {
+                    std::string Message;
+                    const auto  Status = details::SendJob( Address, pJob->m_Args, Message );
+
+                    std::scoped_lock L( Lock );
+                    nInFlight--;
+                    Wake.notify_all();
+
+                    if( Status == details::job_status::UNREACHABLE )
+                    {
+                        // Give the job to someone else and retire this worker
+                        printf( "WARNING: Worker %s is unreachable, retiring it\n", Address.c_str() );
+                        Retry.push_back( pJob );
+                        break;
+                    }
+
+                    if( Status == details::job_status::FAILED )
+                    {
+                        printf( "ERROR: (%s) failed in %s: %s\n", pJob->m_Name.c_str(), Address.c_str(), Message.c_str() );
+                        nFailed++;
+                    }
+                    else
+                    {
+                        printf( "INFO: (%s) compiled in %s\n", pJob->m_Name.c_str(), Address.c_str() );
+                    }
+                }
+            });
+        }
+
+        for( auto& T : Threads ) T.join();
+
+        for( auto pJob : Retry )
+        {
+            printf( "ERROR: (%s) could not be compiled, no workers left\n", pJob->m_Name.c_str() );
+            nFailed++;
+        }
+
+        for( const auto& Address : LocalWorkers ) (void)daemon::Shutdown( Address );
+
+        printf( "INFO: %d jobs, %d failed, %d workers\n", int(Jobs.size()), nFailed, int(Workers.size()) );
+
+        if( nFailed ) return xerr_failure_s( "Some of the distributed jobs failed" );
+        return {};
+    }
+}
@@ -1,27 +1,93 @@
 
+#include <filesystem>
+#include <future>
+#include <list>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <cstdio>
+#include <cmath>
+#if defined(_WIN32)
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
 #include "xraw3d.h"
 #include "../../dependencies/meshoptimizer/src/meshoptimizer.h"
 #include "../../src_runtime/xgeom.h"
+#include "xgeom_compiler_kernels.h"
+#include "xgeom_compiler_bvh.h"
+#include "xgeom_compiler_collision.h"
+#include "xgeom_compiler_occluder.h"
+#include "xgeom_compiler_cluster_lod.h"
 
 namespace xgeom_compiler
 {
     struct implementation : xgeom_compiler::instance
     {
-        struct vertex
-        { 
-            struct weight
+        //
+        // Vertices are kept as one array per attribute, so every pass (meshoptimizer, bbox, stream
+        // writers) only walks the attributes it needs and the packing kernels see contiguous data
+        //
+        struct vertex_soa
+        {
+            std::vector<xcore::vector3d>                    m_Position;
+            std::array<std::vector<xcore::vector2>, 4>      m_UVs;
+            std::vector<xcore::icolor>                      m_Color;
+            std::vector<xcore::vector3d>                    m_Normal;
+            std::vector<xcore::vector3d>                    m_Tangent;
+            std::vector<xcore::vector3d>                    m_Binormal;
+            std::vector<std::array<float, 4>>               m_BoneWeight;
+            std::vector<std::array<std::int32_t, 4>>        m_BoneIndex;
+            std::vector<std::uint16_t>                      m_MaterialID;
+
+            // Calls back with the same attribute of every given vertex_soa
+            template< typename T_CALLBACK, typename... T_SOAS >
+            static void ForEachAttribute( T_CALLBACK&& CallBack, T_SOAS&... Soas )
             {
-                std::int32_t    m_iBone;
-                float           m_Weight;
-            };
+                CallBack( Soas.m_Position... );
+                for( int i = 0; i < 4; ++i ) CallBack( Soas.m_UVs[i]... );
+                CallBack( Soas.m_Color... );
+                CallBack( Soas.m_Normal... );
+                CallBack( Soas.m_Tangent... );
+                CallBack( Soas.m_Binormal... );
+                CallBack( Soas.m_BoneWeight... );
+                CallBack( Soas.m_BoneIndex... );
+                CallBack( Soas.m_MaterialID... );
+            }
+
+            std::size_t size( void ) const noexcept
+            {
+                return m_Position.size();
+            }
+
+            void resize( std::size_t Count )
+            {
+                ForEachAttribute( [&]( auto& V ) { V.resize(Count); }, *this );
+            }
+
+            void reserve( std::size_t Count )
+            {
+                ForEachAttribute( [&]( auto& V ) { V.reserve(Count); }, *this );
+            }
 
-            xcore::vector3d                 m_Position;
-            std::array<xcore::vector2, 4>   m_UVs;
-            xcore::icolor                   m_Color;
-            xcore::vector3d                 m_Normal;
-            xcore::vector3d                 m_Tangent;
-            xcore::vector3d                 m_Binormal;
-            std::array<weight, 4>           m_Weights;
+            void Append( const vertex_soa& Src )
+            {
+                ForEachAttribute( []( auto& D, const auto& S ) { D.insert( D.end(), S.begin(), S.end() ); }, *this, Src );
+            }
+
+            // Remap coming from meshopt_optimizeVertexFetchRemap
+            void Remap( const std::vector<unsigned int>& RemapTable, std::size_t NewCount )
+            {
+                ForEachAttribute( [&]( auto& V )
+                {
+                    using t = typename std::remove_reference_t<decltype(V)>::value_type;
+                    std::vector<t> Remapped( NewCount );
+                    meshopt_remapVertexBuffer( Remapped.data(), V.data(), V.size(), sizeof(t), RemapTable.data() );
+                    V = std::move(Remapped);
+                }, *this );
+            }
         };
 
         struct lod
@@ -32,15 +98,17 @@ namespace xgeom_compiler
 
         struct sub_mesh
         {
-            std::vector<vertex>             m_Vertex;
+            vertex_soa                      m_Vertex;
             std::vector<std::uint32_t>      m_Indices;
             std::vector<lod>                m_LODs;
+            std::vector<cluster_lod::cluster> m_Clusters;                   // Continuous LOD, empty unless asked for
             std::uint32_t                   m_iMaterial;
             int                             m_nWeights      { 0 };
             int                             m_nUVs          { 0 };
             bool                            m_bHasColor     { false };
             bool                            m_bHasNormal    { false };
             bool                            m_bHasBTN       { false };
+            bool                            m_bHasMaterialID{ false };
         };
 
         struct mesh
@@ -54,122 +122,1020 @@ namespace xgeom_compiler
             m_FinalGeom.Initialize();
         }
 
-        virtual void LoadRaw( const std::string_view Path ) override
+        static constexpr std::size_t default_max_threads_v = 4;      // Per compile, farm machines run several compiles at once
+
+        struct raw_cache_entry
+        {
+            std::string                     m_Path;
+            std::filesystem::file_time_type m_WriteTime;
+            std::uintmax_t                  m_FileSize;
+            xraw3d::geom                    m_RawGeom;
+        };
+
+        struct skeleton_cache_entry
+        {
+            std::filesystem::file_time_type m_WriteTime;
+            std::uintmax_t                  m_FileSize;
+            std::vector<xraw3d::geom::bone> m_Bone;
+        };
+
+        virtual void SetRawCacheSize( std::size_t MaxEntries ) override
+        {
+            m_RawCacheMaxEntries = MaxEntries;
+            while( m_RawCache.size() > m_RawCacheMaxEntries ) m_RawCache.pop_back();
+        }
+
+        //
+        // Hides the vertex channels the descriptor is going to throw away anyway, so the conversion skips them.
+        // Only the counts change, the raw vertices are fixed size records and keep their memory. UV sets can
+        // only go from the end, the writer skips the ones in the middle.
+        //
+        static void StripUnusedChannels( xraw3d::geom& RawGeom, const xgeom_compiler::descriptor& CompilerOption ) noexcept
         {
+            const auto& Cleanup = CompilerOption.m_Cleanup;
+
+            int nUVs = int(Cleanup.m_bRemoveUVs.size());
+            while( nUVs && Cleanup.m_bRemoveUVs[nUVs - 1] ) nUVs--;
+
+            for( auto& V : RawGeom.m_Vertex )
+            {
+                V.m_nUVs = std::min( V.m_nUVs, nUVs );
+                if( Cleanup.m_bRemoveColor ) V.m_nColors  = 0;
+                if( Cleanup.m_bRemoveBones ) V.m_nWeights = 0;
+                if( Cleanup.m_bRemoveBTN   ) V.m_nNormals = V.m_nTangents = 0;
+            }
+        }
+
+        virtual void LoadRaw( const std::string_view Path, const xgeom_compiler::descriptor& CompilerOption ) override
+        {
+            m_RawGeom = {};
+
+            //
+            // Long running processes (daemon) keep the most recently imported geometry around
+            // so recompiling the same asset does not need to go through the importer again
+            //
+            std::error_code                 Ec;
+            const auto                      WriteTime = std::filesystem::last_write_time( Path, Ec );
+            const auto                      FileSize  = Ec ? std::uintmax_t(0) : std::filesystem::file_size( Path, Ec );
+            const bool                      bCanCache = m_RawCacheMaxEntries && !Ec;
+
+            if( bCanCache )
+            {
+                for( auto It = m_RawCache.begin(); It != m_RawCache.end(); ++It )
+                {
+                    if( It->m_Path != Path ) continue;
+
+                    if( It->m_WriteTime == WriteTime && It->m_FileSize == FileSize )
+                    {
+                        // Move it to the front since it is the most recently used
+                        m_RawCache.splice( m_RawCache.begin(), m_RawCache, It );
+                        m_RawGeom = m_RawCache.front().m_RawGeom;
+                        StripUnusedChannels( m_RawGeom, CompilerOption );
+                        return;
+                    }
+
+                    // The file changed so the entry is stale
+                    m_RawCache.erase(It);
+                    break;
+                }
+            }
+
+            //
+            // The importer only has ImportAll, so the animation and every vertex channel are still decoded.
+            // The animation is released as soon as it returns, the geometry compiler never looks at it.
+            //
             try
             {
-                xraw3d::assimp::ImportAll(m_RawAnim, m_RawGeom, Path.data() );
+                xraw3d::anim RawAnim;
+                xraw3d::assimp::ImportAll( RawAnim, m_RawGeom, Path.data() );
+            }
+            catch( const std::runtime_error& Error )
+            {
+                // An empty geometry would compile fine and end up cached and published
+                m_RawGeom = {};
+                throw(std::runtime_error( xcore::string::Fmt( "Failed to import the mesh file (%s) %s", std::string(Path).c_str(), Error.what() ).data() ));
             }
-            catch (std::runtime_error Error)
+
+            // The cache keeps everything, other descriptors may use what this one strips
+            if( bCanCache )
             {
-                printf("%s", Error.what());
+                m_RawCache.push_front( raw_cache_entry
+                { .m_Path       = std::string(Path)
+                , .m_WriteTime  = WriteTime
+                , .m_FileSize   = FileSize
+                , .m_RawGeom    = m_RawGeom
+                });
+
+                while( m_RawCache.size() > m_RawCacheMaxEntries ) m_RawCache.pop_back();
             }
+
+            StripUnusedChannels( m_RawGeom, CompilerOption );
         }
 
-        void ConvertToCompilerMesh( const xgeom_compiler::descriptor& CompilerOption )
+        //
+        // Outfits and variants of a character point at one shared skeleton file. Its bones are imported once per
+        // process (batch or daemon) and the mesh bone indices are rewritten into that ordering, so every variant
+        // uses the same matrix palette at runtime. Mesh bones the skeleton does not have fall back to their
+        // closest ancestor that it does.
+        //
+        virtual void BindSkeleton( const std::string_view Path ) override
         {
-            for( auto& Mesh : m_RawGeom.m_Mesh )
+            std::error_code Ec;
+            const auto      WriteTime = std::filesystem::last_write_time( Path, Ec );
+            const auto      FileSize  = Ec ? std::uintmax_t(0) : std::filesystem::file_size( Path, Ec );
+            if( Ec ) throw(std::runtime_error( xcore::string::Fmt( "Unable to find the skeleton file (%s)", std::string(Path).c_str() ).data() ));
+
+            auto& Entry = m_SkeletonCache[ std::string(Path) ];
+            if( Entry.m_Bone.empty() || Entry.m_WriteTime != WriteTime || Entry.m_FileSize != FileSize )
             {
-                auto& NewMesh = m_CompilerMesh.emplace_back();
-                NewMesh.m_Name = Mesh.m_Name;
+                xraw3d::anim RawAnim;
+                xraw3d::geom RawGeom;
+                try
+                {
+                    xraw3d::assimp::ImportAll( RawAnim, RawGeom, Path.data() );
+                }
+                catch( const std::runtime_error& Error )
+                {
+                    m_SkeletonCache.erase( std::string(Path) );
+                    throw(std::runtime_error( xcore::string::Fmt( "Failed to import the skeleton file (%s) %s", std::string(Path).c_str(), Error.what() ).data() ));
+                }
+
+                Entry.m_WriteTime = WriteTime;
+                Entry.m_FileSize  = FileSize;
+                Entry.m_Bone      = std::move( RawGeom.m_Bone );
             }
 
-            std::vector<std::int32_t> GeomToCompilerVertMesh( m_RawGeom.m_Facet.size() * 3          );
-            std::vector<std::int32_t> MaterialToSubmesh     ( m_RawGeom.m_MaterialInstance.size()   );
+            const auto& Skeleton = Entry.m_Bone;
+            if( Skeleton.empty() ) throw(std::runtime_error( xcore::string::Fmt( "The skeleton file (%s) has no bones", std::string(Path).c_str() ).data() ));
 
-            int MinVert = 0;
-            int MaxVert = int(GeomToCompilerVertMesh.size()-1);
-            int CurMaterial = -1;
-            int LastMesh    = -1;
+            //
+            // Mesh bone -> skeleton bone
+            //
+            std::unordered_map<std::string_view, std::int32_t> SkeletonBone;
+            for( std::int32_t i = 0; i < std::int32_t(Skeleton.size()); ++i ) SkeletonBone.emplace( Skeleton[i].m_Name, i );
 
-            for( auto& Face : m_RawGeom.m_Facet )
+            std::vector<std::int32_t> Remap( m_RawGeom.m_Bone.size() );
+            for( std::size_t i = 0; i < Remap.size(); ++i )
             {
-                auto& Mesh = m_CompilerMesh[Face.m_iMesh];
+                int  iBone  = int(i);
+                bool bFound = false;
+                for( std::size_t nSteps = 0; !bFound && iBone >= 0 && std::size_t(iBone) < Remap.size() && nSteps <= Remap.size(); ++nSteps )
+                {
+                    if( auto It = SkeletonBone.find( m_RawGeom.m_Bone[iBone].m_Name ); It != SkeletonBone.end() )
+                    {
+                        Remap[i] = It->second;
+                        bFound   = true;
+                    }
+                    else
+                    {
+                        iBone = m_RawGeom.m_Bone[iBone].m_iParent;
+                    }
+                }
 
-                // Make sure all faces are shorted by the mesh
-                xassert(Face.m_iMesh >= LastMesh);
-                LastMesh = Face.m_iMesh;
+                if( bFound == false )
+                    throw(std::runtime_error( xcore::string::Fmt( "Bone (%s) and none of its parents are in the skeleton (%s)", m_RawGeom.m_Bone[i].m_Name.c_str(), std::string(Path).c_str() ).data() ));
 
-                // are we dealing with a new mesh? if so we need to reset the remap of the submesh
-                if( Mesh.m_SubMesh.size() == 0 )
+                if( iBone != int(i) )
+                    printf( "WARNING: Bone (%s) is not in the skeleton, its vertices go to (%s)\n", m_RawGeom.m_Bone[i].m_Name.c_str(), m_RawGeom.m_Bone[iBone].m_Name.c_str() );
+            }
+
+            //
+            // Rewrite the influences, bones folded into the same ancestor merge their weights
+            //
+            for( auto& V : m_RawGeom.m_Vertex )
+            {
+                int nWeights = 0;
+                for( int w = 0; w < V.m_nWeights; ++w )
                 {
-                    for (auto& R : MaterialToSubmesh) R = -1;
+                    const auto& W = V.m_Weight[w];
+                    if( W.m_iBone < 0 || std::size_t(W.m_iBone) >= Remap.size() ) continue;
+
+                    const auto iNew = Remap[ W.m_iBone ];
+                    int        j    = 0;
+                    while( j < nWeights && V.m_Weight[j].m_iBone != iNew ) ++j;
+
+                    if( j == nWeights ) V.m_Weight[nWeights++] = { iNew, W.m_Weight };
+                    else                V.m_Weight[j].m_Weight += W.m_Weight;
                 }
+                V.m_nWeights = nWeights;
+            }
 
-                // are we dealiong with a new submesh is so we need to reset the verts
-                if( MaterialToSubmesh[Face.m_iMaterialInstance] == -1 )
+            m_RawGeom.m_Bone = Skeleton;
+        }
+
+        //
+        // All the facets that end up in one submesh. Facets come sorted by mesh and material so
+        // this is usually a single run, unsorted input just produces more runs.
+        //
+        struct facet_bucket
+        {
+            std::uint32_t                                       m_iMesh     {};
+            std::uint32_t                                       m_iSubmesh  {};
+            std::size_t                                         m_nFacets   {};
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> m_Runs     {};     // [Begin, End) into m_RawGeom.m_Facet
+        };
+
+        //
+        // Raw vertex -> submesh vertex. Instead of clearing the table for every submesh each entry
+        // remembers which submesh (generation) wrote it, anything from an older generation is unused.
+        // It only covers the raw vertices [m_iFirst, m_iFirst + nRawVerts) the buckets of its job use.
+        //
+        struct vertex_remap
+        {
+            void Resize( std::uint32_t iFirst, std::size_t nRawVerts )
+            {
+                m_iFirst = iFirst;
+                m_Generation.assign( nRawVerts, 0 );
+                m_Remap.resize( nRawVerts );
+            }
+
+            void NextGeneration( void ) noexcept
+            {
+                m_CurrentGeneration++;
+            }
+
+            std::vector<std::uint32_t>      m_Generation;
+            std::vector<std::uint32_t>      m_Remap;
+            std::uint32_t                   m_CurrentGeneration { 0 };
+            std::uint32_t                   m_iFirst            { 0 };
+        };
+
+        //
+        // Keeps the strongest influences above the threshold, at most MaxInfluences, and renormalizes them so
+        // they add up to one. Returns how many are left, the rest of the slots are zero.
+        //
+        static int OptimizeWeights( const xraw3d::geom::vertex& RawVert, const xgeom_compiler::descriptor::skinning& Skinning, std::array<float, 4>& Weights, std::array<std::int32_t, 4>& Bones ) noexcept
+        {
+            // Selection of the strongest ones, there are only a handful of influences per vertex
+            const auto          nMax    = std::clamp( Skinning.m_MaxInfluences, 1, int(Weights.size()) );
+            std::array<int, 4>  iKept;
+            int                 nKept   = 0;
+            float               Total   = 0;
+            for( ; nKept < nMax; ++nKept )
+            {
+                int iBest = -1;
+                for( int j = 0; j < RawVert.m_nWeights; ++j )
                 {
-                    MaterialToSubmesh[Face.m_iMaterialInstance] = int(Mesh.m_SubMesh.size());
-                    auto& Submesh = Mesh.m_SubMesh.emplace_back();
+                    if( RawVert.m_Weight[j].m_Weight <= 0 || std::find( iKept.begin(), iKept.begin() + nKept, j ) != iKept.begin() + nKept ) continue;
+                    if( iBest == -1 || RawVert.m_Weight[j].m_Weight > RawVert.m_Weight[iBest].m_Weight ) iBest = j;
+                }
+
+                // The strongest one always survives so no vertex loses all its bones
+                if( iBest == -1 || (nKept && RawVert.m_Weight[iBest].m_Weight < Skinning.m_WeightThreshold) ) break;
+
+                iKept[nKept] = iBest;
+                Total       += RawVert.m_Weight[iBest].m_Weight;
+            }
+
+            Weights = {};
+            Bones   = {};
+            for( int j = 0; j < nKept; ++j )
+            {
+                Weights[j] = RawVert.m_Weight[iKept[j]].m_Weight / Total;
+                Bones[j]   = RawVert.m_Weight[iKept[j]].m_iBone;
+            }
+
+            return nKept;
+        }
 
-                    Submesh.m_iMaterial = Face.m_iMaterialInstance;
+        // MaterialSlice is empty unless there are material batches, see descriptor::material_batch
+        void ConvertBucket( const facet_bucket& Bucket, vertex_remap& Remap, const xgeom_compiler::descriptor::skinning& Skinning, const std::vector<std::uint16_t>& MaterialSlice )
+        {
+            auto&       Mesh    = m_CompilerMesh[Bucket.m_iMesh];
+            auto&       SubMesh = Mesh.m_SubMesh[Bucket.m_iSubmesh];
+            auto&       Verts   = SubMesh.m_Vertex;
+            int         Slice   = -1;
 
-                    for (int i = MinVert; i <= MaxVert; ++i)
-                        GeomToCompilerVertMesh[i] = -1;
+            Remap.NextGeneration();
+            SubMesh.m_Indices.reserve( Bucket.m_nFacets * 3 );
+            SubMesh.m_bHasMaterialID = MaterialSlice.empty() == false;
 
-                    MaxVert = 0;
-                    MinVert = int(GeomToCompilerVertMesh.size()-1);
-                    CurMaterial = Face.m_iMaterialInstance;
+            //
+            // Count the vertices first with the same remap rules, so every attribute is sized exactly once
+            //
+            std::size_t nNewVerts = 0;
+            for( const auto& [Begin, End] : Bucket.m_Runs )
+            {
+                if( SubMesh.m_bHasMaterialID )
+                {
+                    const int RunSlice = MaterialSlice[ m_RawGeom.m_Facet[Begin].m_iMaterialInstance ];
+                    if( Slice != -1 && Slice != RunSlice ) Remap.NextGeneration();
+                    Slice = RunSlice;
                 }
-                else
+
+                for( auto iFace = Begin; iFace < End; ++iFace )
                 {
-                    // Make sure that faces are shorted by materials
-                    xassert(CurMaterial >= Face.m_iMaterialInstance );
+                    for( const auto iRawVert : m_RawGeom.m_Facet[iFace].m_iVertex )
+                    {
+                        const auto iSlot = std::uint32_t(iRawVert) - Remap.m_iFirst;
+                        if( Remap.m_Generation[iSlot] == Remap.m_CurrentGeneration ) continue;
+                        Remap.m_Generation[iSlot] = Remap.m_CurrentGeneration;
+                        nNewVerts++;
+                    }
                 }
+            }
+
+            Remap.NextGeneration();
+            Slice = -1;
 
-                auto& SubMesh = Mesh.m_SubMesh[MaterialToSubmesh[Face.m_iMaterialInstance]];
+            auto nVerts = Verts.size();
+            Verts.resize( nVerts + nNewVerts );
+
+            for( const auto& [Begin, End] : Bucket.m_Runs )
+            {
+                // Runs never mix materials. A vertex shared by two slices needs one copy per slice.
+                if( SubMesh.m_bHasMaterialID )
+                {
+                    const int RunSlice = MaterialSlice[ m_RawGeom.m_Facet[Begin].m_iMaterialInstance ];
+                    if( Slice != -1 && Slice != RunSlice ) Remap.NextGeneration();
+                    Slice = RunSlice;
+                }
 
-                for( int i=0; i<3; ++i )
+                for( auto iFace = Begin; iFace < End; ++iFace )
                 {
-                    if( GeomToCompilerVertMesh[Face.m_iVertex[i]] == -1 )
+                    const auto& Face = m_RawGeom.m_Facet[iFace];
+
+                    for( int i=0; i<3; ++i )
                     {
-                        GeomToCompilerVertMesh[Face.m_iVertex[i]] = int(SubMesh.m_Vertex.size());
-                        auto& CompilerVert = SubMesh.m_Vertex.emplace_back();
-                        auto& RawVert      = m_RawGeom.m_Vertex[Face.m_iVertex[i]];
+                        const auto iRawVert = std::uint32_t(Face.m_iVertex[i]);
+                        const auto iSlot    = iRawVert - Remap.m_iFirst;
+
+                        if( Remap.m_Generation[iSlot] != Remap.m_CurrentGeneration )
+                        {
+                            const auto iVert   = nVerts++;
+                            auto&      RawVert = m_RawGeom.m_Vertex[iRawVert];
+
+                            Remap.m_Generation[iSlot] = Remap.m_CurrentGeneration;
+                            Remap.m_Remap[iSlot]      = std::uint32_t(iVert);
+
+                            Verts.m_Binormal[iVert] = RawVert.m_BTN[0].m_Binormal;
+                            Verts.m_Tangent[iVert]  = RawVert.m_BTN[0].m_Tangent;
+                            Verts.m_Normal[iVert]   = RawVert.m_BTN[0].m_Normal;
+                            Verts.m_Color[iVert]    = RawVert.m_Color[0];               // This could be n in the future...
+                            Verts.m_Position[iVert] = RawVert.m_Position;
+                            if( Slice != -1 ) Verts.m_MaterialID[iVert] = std::uint16_t(Slice);
+
+                            if ( RawVert.m_nTangents ) SubMesh.m_bHasBTN    = true;
+                            if ( RawVert.m_nNormals  ) SubMesh.m_bHasNormal = true;
+                            if ( RawVert.m_nColors   ) SubMesh.m_bHasColor  = true;
+
+                            if( SubMesh.m_Indices.size() && SubMesh.m_nUVs != 0 && RawVert.m_nUVs < SubMesh.m_nUVs )
+                            {
+                                printf("WARNING: Found a vertex with an inconsistent set of uvs (Expecting %d, found %d) MeshName: %s \n"
+                                , SubMesh.m_nUVs
+                                , RawVert.m_nUVs
+                                , Mesh.m_Name.data()
+                                );
+                            }
+                            else
+                            {
+                                SubMesh.m_nUVs = RawVert.m_nUVs;
+
+                                for (int j = 0; j < RawVert.m_nUVs; ++j)
+                                    Verts.m_UVs[j][iVert] = RawVert.m_UV[j];
+                            }
+
+                            const auto nWeights = OptimizeWeights( RawVert, Skinning, Verts.m_BoneWeight[iVert], Verts.m_BoneIndex[iVert] );
+                            SubMesh.m_nWeights  = std::max( SubMesh.m_nWeights, nWeights );
+                        }
+
+                        SubMesh.m_Indices.push_back( Remap.m_Remap[iSlot] );
+                    }
+                }
+            }
+
+            xassert( nVerts == Verts.size() );
+        }
+
+        //
+        // Splits the meshes bigger than SplitTriangleCount into spatially coherent chunks so each can be culled
+        // on its own. A kd-tree over the facet centroids cuts the longest axis at the median until every leaf is
+        // small enough. Creates the compiler meshes and returns the compiler mesh of every facet.
+        //
+        std::vector<std::uint32_t> SplitIntoChunks( int SplitTriangleCount )
+        {
+            std::vector<std::uint32_t> FacetMesh( m_RawGeom.m_Facet.size() );
+            std::vector<std::vector<std::uint32_t>> MeshFacets( m_RawGeom.m_Mesh.size() );
+            for( std::uint32_t i = 0; i < FacetMesh.size(); ++i ) MeshFacets[ m_RawGeom.m_Facet[i].m_iMesh ].push_back(i);
+
+            std::vector<xcore::vector3d> Centroids( m_RawGeom.m_Facet.size() );
+            for( std::size_t i = 0; i < Centroids.size(); ++i )
+            {
+                const auto& Face = m_RawGeom.m_Facet[i];
+                const auto& A    = m_RawGeom.m_Vertex[ Face.m_iVertex[0] ].m_Position;
+                const auto& B    = m_RawGeom.m_Vertex[ Face.m_iVertex[1] ].m_Position;
+                const auto& C    = m_RawGeom.m_Vertex[ Face.m_iVertex[2] ].m_Position;
+                Centroids[i] = xcore::vector3d{ (A.m_X + B.m_X + C.m_X) / 3.0f, (A.m_Y + B.m_Y + C.m_Y) / 3.0f, (A.m_Z + B.m_Z + C.m_Z) / 3.0f };
+            }
+
+            auto Axis = []( const xcore::vector3d& V, int i ) noexcept { return i == 0 ? V.m_X : i == 1 ? V.m_Y : V.m_Z; };
+
+            for( std::size_t iRawMesh = 0; iRawMesh < MeshFacets.size(); ++iRawMesh )
+            {
+                auto&       Facets  = MeshFacets[iRawMesh];
+                const auto  Name    = std::string( m_RawGeom.m_Mesh[iRawMesh].m_Name.data() );
+
+                if( Facets.size() <= std::size_t(SplitTriangleCount) )
+                {
+                    for( const auto i : Facets ) FacetMesh[i] = std::uint32_t(m_CompilerMesh.size());
+                    m_CompilerMesh.emplace_back().m_Name = Name;
+                    continue;
+                }
 
-                        CompilerVert.m_Binormal = RawVert.m_BTN[0].m_Binormal;
-                        CompilerVert.m_Tangent  = RawVert.m_BTN[0].m_Tangent;
-                        CompilerVert.m_Normal   = RawVert.m_BTN[0].m_Normal;
-                        CompilerVert.m_Color    = RawVert.m_Color[0];               // This could be n in the future...
-                        CompilerVert.m_Position = RawVert.m_Position;
-                        
-                        if ( RawVert.m_nTangents ) SubMesh.m_bHasBTN    = true;
-                        if ( RawVert.m_nNormals  ) SubMesh.m_bHasNormal = true;
-                        if ( RawVert.m_nColors   ) SubMesh.m_bHasColor  = true;
+                // Leaves come out depth first so neighbouring chunks end up next to each other
+                std::vector<std::pair<std::size_t, std::size_t>> Stack{ { 0, Facets.size() } };
+                int iChunk = 0;
+                while( Stack.empty() == false )
+                {
+                    const auto [Begin, End] = Stack.back();
+                    Stack.pop_back();
 
-                        if( SubMesh.m_Indices.size() && SubMesh.m_nUVs != 0 && RawVert.m_nUVs < SubMesh.m_nUVs )
+                    if( End - Begin > std::size_t(SplitTriangleCount) )
+                    {
+                        xcore::vector3d Min = Centroids[ Facets[Begin] ];
+                        xcore::vector3d Max = Min;
+                        for( auto i = Begin; i < End; ++i )
                         {
-                            printf("WARNING: Found a vertex with an inconsistent set of uvs (Expecting %d, found %d) MeshName: %s \n"
-                            , SubMesh.m_nUVs
-                            , RawVert.m_nUVs
-                            , Mesh.m_Name.data()
-                            );
+                            const auto& P = Centroids[ Facets[i] ];
+                            Min.m_X = std::min( Min.m_X, P.m_X ); Max.m_X = std::max( Max.m_X, P.m_X );
+                            Min.m_Y = std::min( Min.m_Y, P.m_Y ); Max.m_Y = std::max( Max.m_Y, P.m_Y );
+                            Min.m_Z = std::min( Min.m_Z, P.m_Z ); Max.m_Z = std::max( Max.m_Z, P.m_Z );
                         }
-                        else
+
+                        int iAxis = 0;
+                        for( int i = 1; i < 3; ++i ) if( Axis(Max, i) - Axis(Min, i) > Axis(Max, iAxis) - Axis(Min, iAxis) ) iAxis = i;
+
+                        const auto Mid = Begin + (End - Begin) / 2;
+                        std::nth_element( Facets.begin() + Begin, Facets.begin() + Mid, Facets.begin() + End, [&]( std::uint32_t A, std::uint32_t B )
+                        {
+                            return Axis( Centroids[A], iAxis ) < Axis( Centroids[B], iAxis );
+                        });
+
+                        Stack.emplace_back( Mid, End );
+                        Stack.emplace_back( Begin, Mid );
+                        continue;
+                    }
+
+                    for( auto i = Begin; i < End; ++i ) FacetMesh[ Facets[i] ] = std::uint32_t(m_CompilerMesh.size());
+
+                    // Keep the name inside xgeom::mesh::m_Name
+                    const auto Suffix = std::string( xcore::string::Fmt( "_%d", iChunk++ ).data() );
+                    const auto MaxLen = std::tuple_size_v<decltype(xgeom::mesh::m_Name)> - 1 - Suffix.size();
+                    m_CompilerMesh.emplace_back().m_Name = Name.substr( 0, MaxLen ) + Suffix;
+                }
+
+                printf( "INFO: Split mesh (%s) into %d chunks\n", Name.c_str(), iChunk );
+            }
+
+            return FacetMesh;
+        }
+
+        void ConvertToCompilerMesh( const xgeom_compiler::descriptor& CompilerOption )
+        {
+            // All the back half needs from the raw geometry, so it can be released after this
+            m_nRawBones     = m_RawGeom.m_Bone.size();
+            m_nRawMaterials = m_RawGeom.m_MaterialInstance.size();
+
+            // Facet -> compiler mesh, empty when the meshes map one to one
+            std::vector<std::uint32_t> FacetMesh;
+            if( CompilerOption.m_Cleanup.m_SplitTriangleCount > 0 )
+            {
+                FacetMesh = SplitIntoChunks( CompilerOption.m_Cleanup.m_SplitTriangleCount );
+            }
+            else
+            {
+                for( auto& Mesh : m_RawGeom.m_Mesh )
+                {
+                    auto& NewMesh = m_CompilerMesh.emplace_back();
+                    NewMesh.m_Name = Mesh.m_Name;
+                }
+            }
+
+            //
+            // Material batches, materials that are drawn with another one share its submesh
+            //
+            std::vector<std::uint32_t> BatchMaterial( m_nRawMaterials );
+            std::vector<std::uint16_t> MaterialSlice;
+            for( std::uint32_t i = 0; i < BatchMaterial.size(); ++i ) BatchMaterial[i] = i;
+
+            if( CompilerOption.m_MaterialBatches.empty() == false )
+            {
+                MaterialSlice.assign( m_nRawMaterials, 0 );
+                for( const auto& Batch : CompilerOption.m_MaterialBatches )
+                {
+                    if( Batch.m_iMaterial < 0 || Batch.m_iMaterial >= int(m_nRawMaterials) || Batch.m_iBatchMaterial < 0 || Batch.m_iBatchMaterial >= int(m_nRawMaterials) || Batch.m_Slice < 0 || Batch.m_Slice > 0xffff )
+                    {
+                        printf( "WARNING: Ignoring the material batch (%d -> %d slice %d), it is out of range\n", Batch.m_iMaterial, Batch.m_iBatchMaterial, Batch.m_Slice );
+                        continue;
+                    }
+
+                    BatchMaterial[Batch.m_iMaterial] = std::uint32_t(Batch.m_iBatchMaterial);
+                    MaterialSlice[Batch.m_iMaterial] = std::uint16_t(Batch.m_Slice);
+                }
+
+                // Folding into a material that is itself folded ends in the last one
+                for( auto& M : BatchMaterial ) for( std::size_t n = 0; n < BatchMaterial.size() && BatchMaterial[M] != M; ++n ) M = BatchMaterial[M];
+            }
+
+            auto MeshOf = [&]( std::uint32_t iFacet ) noexcept
+            {
+                return FacetMesh.empty() ? std::uint32_t(m_RawGeom.m_Facet[iFacet].m_iMesh) : FacetMesh[iFacet];
+            };
+
+            //
+            // Bucket the facets by (mesh, material), linear in the number of facets.
+            // Submeshes are created in the order their material first shows up in the mesh.
+            //
+            std::vector<facet_bucket>                       Buckets;
+            std::unordered_map<std::uint64_t, std::size_t>  KeyToBucket;
+            const auto                                      nFacets = std::uint32_t(m_RawGeom.m_Facet.size());
+
+            for( std::uint32_t Begin = 0, End; Begin < nFacets; Begin = End )
+            {
+                const auto& First = m_RawGeom.m_Facet[Begin];
+                const auto  iMesh = MeshOf(Begin);
+                for( End = Begin + 1; End < nFacets && MeshOf(End) == iMesh && m_RawGeom.m_Facet[End].m_iMaterialInstance == First.m_iMaterialInstance; ++End );
+
+                const auto iMaterial    = BatchMaterial[First.m_iMaterialInstance];
+                const auto Key          = (std::uint64_t(iMesh) << 32) | iMaterial;
+                auto [It, bInserted]    = KeyToBucket.try_emplace( Key, Buckets.size() );
+                if( bInserted )
+                {
+                    auto& Mesh = m_CompilerMesh[iMesh];
+                    Buckets.push_back( facet_bucket{ .m_iMesh = iMesh, .m_iSubmesh = std::uint32_t(Mesh.m_SubMesh.size()), .m_nFacets = 0 } );
+                    Mesh.m_SubMesh.emplace_back().m_iMaterial = iMaterial;
+                }
+
+                auto& Bucket = Buckets[It->second];
+                Bucket.m_Runs.emplace_back( Begin, End );
+                Bucket.m_nFacets += End - Begin;
+            }
+
+            //
+            // Convert the buckets in parallel, each job takes a contiguous group of buckets with
+            // about the same number of facets and has its own remap table. Farm machines run many
+            // compiles side by side, so the jobs are bounded by m_MaxThreads and not by the cores.
+            //
+            constexpr std::size_t   min_facets_per_job_v = 16 * 1024;
+            const std::size_t       nJobs = std::clamp<std::size_t>( nFacets / min_facets_per_job_v, 1, std::max<std::size_t>( 1, m_MaxThreads ) );
+
+            auto ConvertRange = [&]( std::size_t iBegin, std::size_t iEnd )
+            {
+                // The remap table only spans the raw vertices these buckets use
+                std::uint32_t iMin = ~0u, iMax = 0;
+                for( auto i = iBegin; i < iEnd; ++i )
+                    for( const auto& [Begin, End] : Buckets[i].m_Runs )
+                        for( auto iFace = Begin; iFace < End; ++iFace )
+                            for( const auto iRawVert : m_RawGeom.m_Facet[iFace].m_iVertex )
+                            {
+                                iMin = std::min( iMin, std::uint32_t(iRawVert) );
+                                iMax = std::max( iMax, std::uint32_t(iRawVert) );
+                            }
+                if( iMin > iMax ) return;
+
+                vertex_remap Remap;
+                Remap.Resize( iMin, iMax - iMin + 1 );
+                for( auto i = iBegin; i < iEnd; ++i ) ConvertBucket( Buckets[i], Remap, CompilerOption.m_Skinning, MaterialSlice );
+            };
+
+            std::vector<std::future<void>>  Jobs;
+            std::size_t                     iBegin      = 0;
+            std::size_t                     nAssigned   = 0;
+            for( std::size_t iJob = 1; iJob < nJobs; ++iJob )
+            {
+                const auto Target = nFacets * iJob / nJobs;
+                auto       iEnd   = iBegin;
+                while( iEnd < Buckets.size() && nAssigned < Target ) nAssigned += Buckets[iEnd++].m_nFacets;
+
+                if( iEnd > iBegin ) Jobs.push_back( std::async( std::launch::async, ConvertRange, iBegin, iEnd ) );
+                iBegin = iEnd;
+            }
+
+            ConvertRange( iBegin, Buckets.size() );
+            for( auto& J : Jobs ) J.get();
+        }
+
+        //
+        // Finds meshes with the same geometry as an earlier one up to a rigid transform (instanced props exported
+        // as copies) and replaces them with an xgeom::instance of the earlier one. Candidates must have the same
+        // materials, counts and indices, the transform comes from an orthonormal frame built on two of the vertices
+        // and every vertex is then checked with it. Mirrored copies are not rigid and stay as they are.
+        //
+        void DeduplicateMeshes( void )
+        {
+            using vec3 = std::array<float, 3>;
+            using mat3 = std::array<vec3, 3>;                                       // Columns
+
+            auto Sub    = []( const xcore::vector3d& A, const vec3& B ) noexcept { return vec3{ A.m_X - B[0], A.m_Y - B[1], A.m_Z - B[2] }; };
+            auto Dot    = []( const vec3& A, const vec3& B ) noexcept { return A[0]*B[0] + A[1]*B[1] + A[2]*B[2]; };
+            auto Cross  = []( const vec3& A, const vec3& B ) noexcept { return vec3{ A[1]*B[2] - A[2]*B[1], A[2]*B[0] - A[0]*B[2], A[0]*B[1] - A[1]*B[0] }; };
+            auto Mul    = []( const mat3& M, const vec3& V ) noexcept { return vec3{ M[0][0]*V[0] + M[1][0]*V[1] + M[2][0]*V[2], M[0][1]*V[0] + M[1][1]*V[1] + M[2][1]*V[2], M[0][2]*V[0] + M[1][2]*V[1] + M[2][2]*V[2] }; };
+            auto Dist2  = [&]( const vec3& A, const xcore::vector3d& B ) noexcept { const auto D = Sub( B, A ); return Dot( D, D ); };
+            auto AsVec  = []( const xcore::vector3d& V ) noexcept { return vec3{ V.m_X, V.m_Y, V.m_Z }; };
+
+            struct shape
+            {
+                vec3    m_Center;
+                mat3    m_Frame;
+                float   m_Radius;
+                bool    m_bValid;
+            };
+
+            // Center plus a frame from the vertex farthest from it and the one that makes the widest triangle with it.
+            // The same vertex numbers are used for the candidates so the frames match when the geometry does.
+            std::size_t iFirst = 0, iSecond = 0;
+            auto MakeShape = [&]( const mesh& M, bool bPickVertices ) noexcept
+            {
+                shape       Shape{};
+                std::size_t n = 0;
+                for( const auto& S : M.m_SubMesh ) for( const auto& P : S.m_Vertex.m_Position ) { Shape.m_Center[0] += P.m_X; Shape.m_Center[1] += P.m_Y; Shape.m_Center[2] += P.m_Z; ++n; }
+                if( n == 0 ) return Shape;
+                for( auto& C : Shape.m_Center ) C /= float(n);
+
+                auto Position = [&]( std::size_t i ) -> const xcore::vector3d&
+                {
+                    for( const auto& S : M.m_SubMesh ) { if( i < S.m_Vertex.size() ) return S.m_Vertex.m_Position[i]; i -= S.m_Vertex.size(); }
+                    return M.m_SubMesh.back().m_Vertex.m_Position.back();
+                };
+
+                if( bPickVertices )
+                {
+                    float Best = -1;
+                    for( std::size_t i = 0; i < n; ++i ) if( const auto D = Dist2( Shape.m_Center, Position(i) ); D > Best ) { Best = D; iFirst = i; }
+
+                    const auto A = Sub( Position(iFirst), Shape.m_Center );
+                    Best = -1;
+                    for( std::size_t i = 0; i < n; ++i ) { const auto C = Cross( A, Sub( Position(i), Shape.m_Center ) ); if( const auto D = Dot( C, C ); D > Best ) { Best = D; iSecond = i; } }
+                }
+
+                const auto  A    = Sub( Position(iFirst),  Shape.m_Center );
+                const auto  B    = Sub( Position(iSecond), Shape.m_Center );
+                const auto  LenA = std::sqrt( Dot( A, A ) );
+                const auto  C    = Cross( A, B );
+                const auto  LenC = std::sqrt( Dot( C, C ) );
+
+                Shape.m_Radius = LenA;
+                if( LenA <= 1e-6f || LenC <= 1e-6f * LenA * LenA ) return Shape;
+
+                const vec3 E0{ A[0] / LenA, A[1] / LenA, A[2] / LenA };
+                const vec3 E2{ C[0] / LenC, C[1] / LenC, C[2] / LenC };
+                Shape.m_Frame  = mat3{ E0, Cross( E2, E0 ), E2 };
+                Shape.m_bValid = true;
+                return Shape;
+            };
+
+            // Everything but the positions and the BTNs must match exactly
+            auto SameBytes = []< typename T >( const std::vector<T>& A, const std::vector<T>& B ) noexcept
+            {
+                return A.size() == B.size() && ( A.empty() || std::memcmp( A.data(), B.data(), A.size() * sizeof(T) ) == 0 );
+            };
+
+            auto SameTopology = [&]( const mesh& A, const mesh& B ) noexcept
+            {
+                if( A.m_SubMesh.size() != B.m_SubMesh.size() ) return false;
+                for( std::size_t i = 0; i < A.m_SubMesh.size(); ++i )
+                {
+                    const auto& SA = A.m_SubMesh[i];
+                    const auto& SB = B.m_SubMesh[i];
+                    if( SA.m_iMaterial != SB.m_iMaterial || SA.m_nWeights != SB.m_nWeights || SA.m_nUVs != SB.m_nUVs || SA.m_Indices != SB.m_Indices ) return false;
+                    for( int j = 0; j < 4; ++j ) if( !SameBytes( SA.m_Vertex.m_UVs[j], SB.m_Vertex.m_UVs[j] ) ) return false;
+                    if( !SameBytes( SA.m_Vertex.m_Color, SB.m_Vertex.m_Color ) || !SameBytes( SA.m_Vertex.m_BoneWeight, SB.m_Vertex.m_BoneWeight )
+                     || !SameBytes( SA.m_Vertex.m_BoneIndex, SB.m_Vertex.m_BoneIndex ) || !SameBytes( SA.m_Vertex.m_MaterialID, SB.m_Vertex.m_MaterialID ) ) return false;
+                }
+                return true;
+            };
+
+            // Quick filter, meshes can only match others with the same key
+            auto TopologyKey = []( const mesh& M ) noexcept
+            {
+                std::uint64_t Key = 0xcbf29ce484222325ull;
+                auto Add = [&]( std::uint64_t V ) { Key ^= V; Key *= 0x100000001b3ull; };
+                for( const auto& S : M.m_SubMesh )
+                {
+                    Add( S.m_iMaterial );
+                    Add( S.m_Vertex.size() );
+                    for( const auto i : S.m_Indices ) Add( i );
+                }
+                return Key;
+            };
+
+            std::unordered_map<std::uint64_t, std::vector<std::size_t>> Originals;
+            std::vector<std::size_t>                                    NewIndex( m_CompilerMesh.size() );
+            std::vector<bool>                                           bRemoved( m_CompilerMesh.size(), false );
+            std::vector<std::pair<std::size_t, xgeom::instance>>        Found;
+
+            for( std::size_t iMesh = 0; iMesh < m_CompilerMesh.size(); ++iMesh )
+            {
+                const auto& Mesh   = m_CompilerMesh[iMesh];
+                auto&       Bucket = Originals[ TopologyKey(Mesh) ];
+
+                for( const auto iOriginal : Bucket )
+                {
+                    const auto& Original = m_CompilerMesh[iOriginal];
+                    if( SameTopology( Original, Mesh ) == false ) continue;
+
+                    const auto From = MakeShape( Original, true );
+                    const auto To   = MakeShape( Mesh, false );
+                    if( From.m_bValid == false || To.m_bValid == false ) continue;
+
+                    // R = To.Frame * transpose(From.Frame)
+                    mat3 R;
+                    for( int c = 0; c < 3; ++c )
+                    {
+                        const vec3 Axis{ From.m_Frame[0][c], From.m_Frame[1][c], From.m_Frame[2][c] };
+                        R[c] = Mul( To.m_Frame, Axis );
+                    }
+
+                    const auto Tolerance2   = std::pow( 1e-4f * std::max( 1.0f, From.m_Radius ), 2.0f );
+                    bool       bMatch       = true;
+                    for( std::size_t s = 0; bMatch && s < Mesh.m_SubMesh.size(); ++s )
+                    {
+                        const auto& A = Original.m_SubMesh[s].m_Vertex;
+                        const auto& B = Mesh.m_SubMesh[s].m_Vertex;
+                        for( std::size_t v = 0; bMatch && v < A.size(); ++v )
                         {
-                            SubMesh.m_nUVs = RawVert.m_nUVs;
+                            const auto P = Mul( R, Sub( A.m_Position[v], From.m_Center ) );
+                            bMatch = Dist2( vec3{ P[0] + To.m_Center[0], P[1] + To.m_Center[1], P[2] + To.m_Center[2] }, B.m_Position[v] ) <= Tolerance2
+                                  && Dist2( Mul( R, AsVec( A.m_Normal[v]   ) ), B.m_Normal[v]   ) <= 1e-5f
+                                  && Dist2( Mul( R, AsVec( A.m_Tangent[v]  ) ), B.m_Tangent[v]  ) <= 1e-5f
+                                  && Dist2( Mul( R, AsVec( A.m_Binormal[v] ) ), B.m_Binormal[v] ) <= 1e-5f;
+                        }
+                    }
+                    if( bMatch == false ) continue;
+
+                    // Translation takes the rotated original center to the copy center
+                    const auto      RC = Mul( R, From.m_Center );
+                    xgeom::instance Instance{};
+                    std::memcpy( Instance.m_Name.data(), Mesh.m_Name.data(), std::min( Mesh.m_Name.size(), Instance.m_Name.size() - 1 ) );
+                    for( int r = 0; r < 3; ++r )
+                    {
+                        Instance.m_Transform[r * 4 + 0] = R[0][r];
+                        Instance.m_Transform[r * 4 + 1] = R[1][r];
+                        Instance.m_Transform[r * 4 + 2] = R[2][r];
+                        Instance.m_Transform[r * 4 + 3] = To.m_Center[r] - RC[r];
+                    }
+
+                    Found.emplace_back( iOriginal, Instance );
+                    bRemoved[iMesh] = true;
+                    break;
+                }
+
+                if( bRemoved[iMesh] == false ) Bucket.push_back( iMesh );
+            }
+
+            if( Found.empty() ) return;
+
+            //
+            // Drop the copies, originals are never removed so their new index is all the instances need
+            //
+            std::size_t nKept = 0;
+            for( std::size_t i = 0; i < m_CompilerMesh.size(); ++i )
+            {
+                NewIndex[i] = nKept;
+                if( bRemoved[i] == false ) m_CompilerMesh[nKept++] = std::move( m_CompilerMesh[i] );
+            }
+            m_CompilerMesh.resize( nKept );
+
+            for( auto& [iOriginal, Instance] : Found )
+            {
+                Instance.m_iMesh = std::uint16_t( NewIndex[iOriginal] );
+                m_Instances.push_back( Instance );
+            }
+
+            printf( "INFO: %d meshes are copies of others, stored as instances\n", int(Found.size()) );
+        }
+
+        //
+        // Positions of all the submeshes of a mesh in one buffer, with the copies that only differ in the other
+        // attributes (UV seams, hard normals) merged so the triangles form one connected surface
+        //
+        static void getWeldedPositions( const mesh& Mesh, std::vector<xcore::vector3d>& Positions, std::vector<std::uint32_t>& Indices )
+        {
+            Positions.clear();
+            Indices.clear();
+            for( const auto& S : Mesh.m_SubMesh )
+            {
+                const auto iBase = std::uint32_t(Positions.size());
+                Positions.insert( Positions.end(), S.m_Vertex.m_Position.begin(), S.m_Vertex.m_Position.end() );
+                for( const auto i : S.m_Indices ) Indices.push_back( iBase + i );
+            }
+            if( Indices.empty() ) return;
+
+            std::vector<unsigned int> Remap( Positions.size() );
+            const auto nUnique = meshopt_generateVertexRemap( Remap.data(), Indices.data(), Indices.size(), Positions.data(), Positions.size(), sizeof(xcore::vector3d) );
+            meshopt_remapIndexBuffer( Indices.data(), Indices.data(), Indices.size(), Remap.data() );
+            meshopt_remapVertexBuffer( Positions.data(), Positions.data(), Positions.size(), sizeof(xcore::vector3d), Remap.data() );
+            Positions.resize( nUnique );
+        }
 
-                            for (int j = 0; j < RawVert.m_nUVs; ++j)
-                                CompilerVert.m_UVs[j] = RawVert.m_UV[j];
+        //
+        // Physics proxies (xgeom::collision_shape) from the LOD 0 triangles of every mesh. The simplified mesh goes
+        // through meshoptimizer like the LODs do, just much further. The hulls are a rough convex decomposition,
+        // the mesh is cut in pieces along the longest axis of the biggest piece and each piece gets wrapped.
+        //
+        void GenerateCollision( const xgeom_compiler::descriptor& CompilerOption )
+        {
+            const auto& Collision = CompilerOption.m_Collision;
+            if( Collision.m_bGenerateMesh == false && Collision.m_bGenerateHulls == false ) return;
+
+            auto AddShape = [&]( int iMesh, xgeom::collision_shape::type Type, std::span<const collision::vec3> Verts, std::span<const std::uint32_t> Indices )
+            {
+                m_CollisionShapes.push_back( xgeom::collision_shape
+                { .m_iVertex    = std::uint32_t(m_CollisionVertices.size() / 3)
+                , .m_nVertices  = std::uint32_t(Verts.size())
+                , .m_iIndex     = std::uint32_t(m_CollisionIndices.size())
+                , .m_nIndices   = std::uint32_t(Indices.size())
+                , .m_iMesh      = std::uint16_t(iMesh)
+                , .m_Type       = Type
+                });
+                for( const auto& V : Verts ) m_CollisionVertices.insert( m_CollisionVertices.end(), V.begin(), V.end() );
+                m_CollisionIndices.insert( m_CollisionIndices.end(), Indices.begin(), Indices.end() );
+            };
+
+            for( int iMesh = 0; iMesh < int(m_CompilerMesh.size()); ++iMesh )
+            {
+                std::vector<xcore::vector3d> Positions;
+                std::vector<std::uint32_t>   Indices;
+                getWeldedPositions( m_CompilerMesh[iMesh], Positions, Indices );
+                if( Indices.size() < 3 ) continue;
+
+                std::vector<collision::vec3> Points( Positions.size() );
+                for( std::size_t i = 0; i < Positions.size(); ++i ) Points[i] = collision::vec3{ Positions[i].m_X, Positions[i].m_Y, Positions[i].m_Z };
+
+                if( Collision.m_bGenerateMesh )
+                {
+                    const auto TargetCount = std::max<std::size_t>( 3, std::size_t( Indices.size() * std::clamp( Collision.m_MeshReduction, 0.0f, 1.0f ) ) / 3 * 3 );
+
+                    std::vector<std::uint32_t> Simplified( Indices.size() );
+                    Simplified.resize( meshopt_simplify( Simplified.data(), Indices.data(), Indices.size(), &Positions[0].m_X, Positions.size(), sizeof(xcore::vector3d), TargetCount, Collision.m_MeshMaxError ) );
+
+                    // Topology (UV seams already welded away, thin parts...) can stop the simplifier early, physics does not care about the looks
+                    if( Simplified.size() > TargetCount * 2 )
+                    {
+                        std::vector<std::uint32_t> Sloppy( Indices.size() );
+                        Sloppy.resize( meshopt_simplifySloppy( Sloppy.data(), Indices.data(), Indices.size(), &Positions[0].m_X, Positions.size(), sizeof(xcore::vector3d), TargetCount, Collision.m_MeshMaxError ) );
+                        if( Sloppy.empty() == false ) Simplified = std::move(Sloppy);
+                    }
+                    if( Simplified.empty() ) Simplified = Indices;
+
+                    // Only the vertices the simplified triangles use
+                    std::vector<std::uint32_t>   Remap( Points.size(), ~0u );
+                    std::vector<collision::vec3> Verts;
+                    for( auto& i : Simplified )
+                    {
+                        if( Remap[i] == ~0u ) { Remap[i] = std::uint32_t(Verts.size()); Verts.push_back( Points[i] ); }
+                        i = Remap[i];
+                    }
+
+                    AddShape( iMesh, xgeom::collision_shape::type::TRIANGLE_MESH, Verts, Simplified );
+                }
+
+                if( Collision.m_bGenerateHulls )
+                {
+                    //
+                    // Cut the triangles in pieces, always the piece with the most spread out centroids along its longest axis
+                    //
+                    const auto nTris = Indices.size() / 3;
+                    std::vector<collision::vec3> Centroid( nTris );
+                    std::vector<std::uint32_t>   Order( nTris );
+                    for( std::size_t t = 0; t < nTris; ++t )
+                    {
+                        for( int a = 0; a < 3; ++a ) Centroid[t][a] = ( Points[Indices[t*3]][a] + Points[Indices[t*3+1]][a] + Points[Indices[t*3+2]][a] ) / 3.0f;
+                        Order[t] = std::uint32_t(t);
+                    }
+
+                    auto Spread = [&]( std::pair<std::size_t, std::size_t> Piece, int& Axis )
+                    {
+                        collision::vec3 Min = Centroid[Order[Piece.first]], Max = Min;
+                        for( auto i = Piece.first; i < Piece.second; ++i ) for( int a = 0; a < 3; ++a )
+                        {
+                            Min[a] = std::min( Min[a], Centroid[Order[i]][a] );
+                            Max[a] = std::max( Max[a], Centroid[Order[i]][a] );
                         }
+                        Axis = 0;
+                        for( int a = 1; a < 3; ++a ) if( Max[a] - Min[a] > Max[Axis] - Min[Axis] ) Axis = a;
+                        return Max[Axis] - Min[Axis];
+                    };
+
+                    std::vector<std::pair<std::size_t, std::size_t>> Pieces{ { 0, nTris } };
+                    while( int(Pieces.size()) < std::max( 1, Collision.m_MaxHulls ) )
+                    {
+                        int   iBest = -1, BestAxis = 0;
+                        float BestSpread = 0;
+                        for( int i = 0; i < int(Pieces.size()); ++i )
+                        {
+                            int Axis;
+                            if( Pieces[i].second - Pieces[i].first < 8 ) continue;
+                            if( const float S = Spread( Pieces[i], Axis ); S > BestSpread ) { BestSpread = S; iBest = i; BestAxis = Axis; }
+                        }
+                        if( iBest < 0 ) break;
+
+                        const auto [Begin, End] = Pieces[iBest];
+                        const auto Mid          = Begin + (End - Begin) / 2;
+                        std::nth_element( Order.begin() + Begin, Order.begin() + Mid, Order.begin() + End, [&]( std::uint32_t A, std::uint32_t B )
+                        {
+                            return Centroid[A][BestAxis] < Centroid[B][BestAxis];
+                        });
+                        Pieces[iBest] = { Begin, Mid };
+                        Pieces.push_back( { Mid, End } );
+                    }
 
-                        for( int j = 0; j < RawVert.m_nWeights; ++j )
+                    std::vector<collision::vec3> PiecePoints, HullVerts;
+                    std::vector<std::uint32_t>   HullIndices;
+                    std::vector<std::uint8_t>    bUsed( Points.size() );
+                    for( const auto& [Begin, End] : Pieces )
+                    {
+                        PiecePoints.clear();
+                        std::fill( bUsed.begin(), bUsed.end(), std::uint8_t(0) );
+                        for( auto i = Begin; i < End; ++i ) for( int k = 0; k < 3; ++k )
                         {
-                            CompilerVert.m_Weights[j].m_iBone  = RawVert.m_Weight[j].m_iBone;
-                            CompilerVert.m_Weights[j].m_Weight = RawVert.m_Weight[j].m_Weight;
+                            const auto v = Indices[ Order[i] * 3 + k ];
+                            if( bUsed[v] == 0 ) { bUsed[v] = 1; PiecePoints.push_back( Points[v] ); }
                         }
 
-                        SubMesh.m_nWeights = std::max(SubMesh.m_nWeights , RawVert.m_nWeights );
+                        const auto Support = collision::SelectSupportPoints( PiecePoints, std::max( 4, Collision.m_MaxHullVertices ) );
+                        if( collision::ComputeConvexHull( Support, HullVerts, HullIndices ) )
+                            AddShape( iMesh, xgeom::collision_shape::type::CONVEX_HULL, HullVerts, HullIndices );
+                        else
+                            printf( "WARNING: Mesh (%s) has a flat piece, no convex hull for it\n", m_CompilerMesh[iMesh].m_Name.c_str() );
                     }
+                }
+            }
+
+            printf( "INFO: %d collision shapes, %d vertices, %d triangles\n", int(m_CollisionShapes.size()), int(m_CollisionVertices.size() / 3), int(m_CollisionIndices.size() / 3) );
+        }
+
+        //
+        // Software occlusion proxies (xgeom::occluder), one per mesh. Only closed meshes have an inside to fit
+        // boxes in, open ones and the ones too thin to hide much are flagged instead so the runtime skips them.
+        //
+        void GenerateOccluders( const xgeom_compiler::descriptor& CompilerOption )
+        {
+            const auto& Options = CompilerOption.m_Occluder;
+            if( Options.m_bGenerate == false ) return;
 
-                    xassert( GeomToCompilerVertMesh[Face.m_iVertex[i]] >= 0 );
-                    xassert( GeomToCompilerVertMesh[Face.m_iVertex[i]] < m_RawGeom.m_Vertex.size() );
-                    SubMesh.m_Indices.push_back(GeomToCompilerVertMesh[Face.m_iVertex[i]]);
+            int nUsable = 0;
+            std::vector<xcore::vector3d> Positions;
+            std::vector<std::uint32_t>   Indices;
+            for( const auto& Mesh : m_CompilerMesh )
+            {
+                auto& Entry = m_Occluders.emplace_back( xgeom::occluder
+                { .m_iVertex    = std::uint32_t(m_OccluderVertices.size() / 3)
+                , .m_iIndex     = std::uint32_t(m_OccluderIndices.size())
+                , .m_nVertices  = 0
+                , .m_nIndices   = 0
+                , .m_Flags      = 0
+                });
+
+                getWeldedPositions( Mesh, Positions, Indices );
+                if( occluder::isClosed( Indices ) == false )
+                {
+                    Entry.m_Flags |= xgeom::occluder::not_closed_mask_v;
+                    continue;
+                }
+
+                std::vector<occluder::vec3> Points( Positions.size() );
+                for( std::size_t i = 0; i < Positions.size(); ++i ) Points[i] = occluder::vec3{ Positions[i].m_X, Positions[i].m_Y, Positions[i].m_Z };
 
-                    MinVert = std::min( MinVert, (int)Face.m_iVertex[i] );
-                    MaxVert = std::max( MaxVert, (int)Face.m_iVertex[i] );
+                // Each box takes 36 of the 16 bit index count, which runs out before the vertices do
+                float      FillRatio;
+                const auto Boxes = occluder::FitInnerBoxes( Points, Indices, Options.m_Resolution, std::min( Options.m_MaxBoxes, 65535 / 36 ), FillRatio );
+                if( Boxes.empty() || FillRatio < Options.m_MinVolumeRatio )
+                {
+                    Entry.m_Flags |= xgeom::occluder::too_thin_mask_v;
+                    continue;
+                }
+
+                //
+                // 8 corners and 12 triangles per box, counter clockwise seen from outside. Corner bit 0 is X, bit 1 Y, bit 2 Z.
+                //
+                static constexpr std::array<std::uint16_t, 36> box_indices_v
+                { 0, 2, 3,  0, 3, 1     // -Z
+                , 4, 5, 7,  4, 7, 6     // +Z
+                , 0, 4, 6,  0, 6, 2     // -X
+                , 1, 3, 7,  1, 7, 5     // +X
+                , 0, 1, 5,  0, 5, 4     // -Y
+                , 2, 6, 7,  2, 7, 3     // +Y
+                };
+
+                for( const auto& B : Boxes )
+                {
+                    for( int c = 0; c < 8; ++c )
+                    {
+                        m_OccluderVertices.push_back( (c & 1) ? B.m_Max[0] : B.m_Min[0] );
+                        m_OccluderVertices.push_back( (c & 2) ? B.m_Max[1] : B.m_Min[1] );
+                        m_OccluderVertices.push_back( (c & 4) ? B.m_Max[2] : B.m_Min[2] );
+                    }
+                    for( const auto i : box_indices_v ) m_OccluderIndices.push_back( std::uint16_t( Entry.m_nVertices + i ) );
+                    Entry.m_nVertices += 8;
+                    Entry.m_nIndices  += std::uint16_t(box_indices_v.size());
                 }
+
+                Entry.m_Flags |= xgeom::occluder::usable_mask_v;
+                nUsable++;
             }
+
+            printf( "INFO: %d of %d meshes have occluders, %d boxes\n", nUsable, int(m_Occluders.size()), int(m_OccluderVertices.size() / 24) );
         }
 
         void GenenateLODs( const xgeom_compiler::descriptor& CompilerOption )
@@ -193,43 +1159,473 @@ namespace xgeom_compiler
                         auto& NewLod = S.m_LODs.emplace_back();
 
                         NewLod.m_Indices.resize(Source.size());
-                        NewLod.m_Indices.resize( meshopt_simplify( NewLod.m_Indices.data(), Source.data(), Source.size(), &S.m_Vertex[0].m_Position.m_X, S.m_Vertex.size(), sizeof(vertex), target_index_count, target_error));
+                        NewLod.m_Indices.resize( meshopt_simplify( NewLod.m_Indices.data(), Source.data(), Source.size(), &S.m_Vertex.m_Position[0].m_X, S.m_Vertex.size(), sizeof(xcore::vector3d), target_index_count, target_error));
                     }
                 }
             }
         }
 
+        //
+        // Cluster DAG of every submesh, on top of the discrete LODs (those stay for the renderers that do not
+        // do per cluster selection)
+        //
+        void GenerateClusterLODs( const xgeom_compiler::descriptor& CompilerOption )
+        {
+            const auto& Options = CompilerOption.m_ClusterLOD;
+            if( Options.m_bGenerate == false ) return;
+
+            std::size_t nClusters = 0, nRoots = 0;
+            for( auto& M : m_CompilerMesh )
+            {
+                for( auto& S : M.m_SubMesh )
+                {
+                    S.m_Clusters = cluster_lod::Build( S.m_Indices, S.m_Vertex.m_Position, Options.m_ClusterTriangles, Options.m_ClusterVertices, Options.m_GroupSize );
+
+                    nClusters += S.m_Clusters.size();
+                    for( const auto& C : S.m_Clusters ) nRoots += C.m_ParentError == std::numeric_limits<float>::max();
+                }
+            }
+
+            printf( "INFO: Cluster LOD %d clusters, %d roots\n", int(nClusters), int(nRoots) );
+        }
+
         void optimizeFacesAndVerts( const xgeom_compiler::descriptor& CompilerOption )
         {
             for( auto& M : m_CompilerMesh)
             {
-                const size_t kCacheSize = 16;
-                for( auto& S : M.m_SubMesh )
+                for( auto& S : M.m_SubMesh )
+                {
+                    meshopt_optimizeVertexCache ( S.m_Indices.data(), S.m_Indices.data(), S.m_Indices.size(), S.m_Vertex.size() ); 
+                    meshopt_optimizeOverdraw    ( S.m_Indices.data(), S.m_Indices.data(), S.m_Indices.size(), &S.m_Vertex.m_Position[0].m_X, S.m_Vertex.size(), sizeof(xcore::vector3d), 1.0f );
+
+                    for( auto& L : S.m_LODs )
+                    {
+                        meshopt_optimizeVertexCache ( L.m_Indices.data(), L.m_Indices.data(), L.m_Indices.size(), S.m_Vertex.size() );
+                        meshopt_optimizeOverdraw    ( L.m_Indices.data(), L.m_Indices.data(), L.m_Indices.size(), &S.m_Vertex.m_Position[0].m_X, S.m_Vertex.size(), sizeof(xcore::vector3d), 1.0f );
+                    }
+
+                    // Clusters are drawn on their own, reordering across them would break the ranges
+                    for( auto& C : S.m_Clusters )
+                        meshopt_optimizeVertexCache ( C.m_Indices.data(), C.m_Indices.data(), C.m_Indices.size(), S.m_Vertex.size() );
+                }
+            }
+        }
+
+        //
+        // Builds a perfect hash table (see xgeom::lookup_table) and appends it to Data. Keys must be unique
+        // and the values can not be lookup_empty_v, when it can not be built the table is left empty and
+        // the runtime falls back to linear searches.
+        //
+        static xgeom::lookup_table BuildLookupTable( const std::vector<std::pair<std::uint32_t, std::uint16_t>>& Entries, std::vector<std::uint16_t>& Data )
+        {
+            xgeom::lookup_table Table{ .m_iData = std::uint32_t(Data.size()), .m_nBuckets = 0, .m_nSlots = 0 };
+            if( Entries.empty() ) return Table;
+
+            {
+                std::vector<std::uint32_t> Keys;
+                Keys.reserve( Entries.size() );
+                for( const auto& E : Entries )
+                {
+                    if( E.second == xgeom::lookup_empty_v ) return Table;
+                    Keys.push_back( E.first );
+                }
+
+                std::sort( Keys.begin(), Keys.end() );
+                if( std::adjacent_find( Keys.begin(), Keys.end() ) != Keys.end() ) return Table;
+            }
+
+            auto NextPow2 = []( std::size_t n ) { std::size_t p = 1; while( p < n ) p <<= 1; return p; };
+
+            // Half full tables with about four keys per bucket find their seeds after a few tries
+            const auto nSlots   = NextPow2( Entries.size() * 2 );
+            const auto nBuckets = NextPow2( (Entries.size() + 3) / 4 );
+
+            std::vector<std::vector<std::size_t>> Buckets( nBuckets );
+            for( std::size_t i = 0; i < Entries.size(); ++i )
+                Buckets[ xgeom::HashMix( Entries[i].first, 0 ) & (nBuckets - 1) ].push_back(i);
+
+            // Biggest buckets first while the table is still empty
+            std::vector<std::size_t> Order( nBuckets );
+            for( std::size_t i = 0; i < nBuckets; ++i ) Order[i] = i;
+            std::stable_sort( Order.begin(), Order.end(), [&]( std::size_t A, std::size_t B ) { return Buckets[A].size() > Buckets[B].size(); } );
+
+            std::vector<std::uint16_t>  Seeds( nBuckets, 0 );
+            std::vector<std::uint16_t>  Slots( nSlots, xgeom::lookup_empty_v );
+            std::vector<std::size_t>    Candidate;
+
+            for( const auto iBucket : Order )
+            {
+                const auto& Bucket = Buckets[iBucket];
+                if( Bucket.empty() ) break;
+
+                bool bFound = false;
+                for( std::uint32_t Seed = 1; Seed < xgeom::lookup_empty_v && !bFound; ++Seed )
+                {
+                    Candidate.clear();
+                    for( const auto i : Bucket )
+                    {
+                        const auto iSlot = xgeom::HashMix( Entries[i].first, Seed ) & (nSlots - 1);
+                        if( Slots[iSlot] != xgeom::lookup_empty_v || std::find( Candidate.begin(), Candidate.end(), iSlot ) != Candidate.end() ) break;
+                        Candidate.push_back( iSlot );
+                    }
+
+                    if( Candidate.size() != Bucket.size() ) continue;
+
+                    for( std::size_t k = 0; k < Bucket.size(); ++k ) Slots[Candidate[k]] = Entries[Bucket[k]].second;
+                    Seeds[iBucket] = std::uint16_t(Seed);
+                    bFound         = true;
+                }
+
+                if( bFound == false ) return Table;
+            }
+
+            Data.insert( Data.end(), Seeds.begin(), Seeds.end() );
+            Data.insert( Data.end(), Slots.begin(), Slots.end() );
+            Table.m_nBuckets = std::uint32_t(nBuckets);
+            Table.m_nSlots   = std::uint32_t(nSlots);
+            return Table;
+        }
+
+        //
+        // Post transform caches of the hardware we ship on, as meshopt_analyzeVertexCache models them
+        //
+        struct vertex_cache_profile
+        {
+            std::string_view                m_Name;
+            unsigned                        m_CacheSize;
+            unsigned                        m_WarpSize;
+            unsigned                        m_PrimGroupSize;
+        };
+
+        static constexpr std::array<vertex_cache_profile, 4> vertex_cache_profiles_v
+        {{ { "NVIDIA",  32, 32,  32 }
+         , { "AMD",     14, 64, 128 }
+         , { "INTEL",  128,  0,   0 }
+         , { "FIFO",    16,  0,   0 }       // Plain FIFO caches (mobile, older hardware)
+        }};
+
+        static const vertex_cache_profile& FindVertexCacheProfile( std::string_view Name )
+        {
+            for( const auto& P : vertex_cache_profiles_v ) if( P.m_Name == Name ) return P;
+            throw(std::runtime_error( xcore::string::Fmt( "Unknown vertex cache profile (%s), use NVIDIA AMD INTEL or FIFO", std::string(Name).c_str() ).data() ));
+        }
+
+        //
+        // Index order with the best ATVR on the profile's cache. The candidates are the shared order (tuned for a
+        // generic cache, then for overdraw), the generic optimizer alone, the FIFO optimizer sized for the cache,
+        // and the strip friendly order. Which one wins depends on the mesh, so they are just measured.
+        //
+        static void TuneVertexCache( const vertex_cache_profile& Profile, const std::vector<std::uint32_t>& Source, std::size_t nVertices, std::vector<std::uint32_t>& Out )
+        {
+            auto Score = [&]( const std::vector<std::uint32_t>& Indices )
+            {
+                return meshopt_analyzeVertexCache( Indices.data(), Indices.size(), nVertices, Profile.m_CacheSize, Profile.m_WarpSize, Profile.m_PrimGroupSize ).atvr;
+            };
+
+            Out = Source;
+            float                      Best = Score( Out );
+            std::vector<std::uint32_t> Candidate( Source.size() );
+            auto Try = [&]( auto&& Optimize )
+            {
+                Optimize( Candidate.data(), Source.data(), Source.size(), nVertices );
+                if( const float S = Score( Candidate ); S < Best ) { Best = S; Out = Candidate; }
+            };
+
+            Try( []( unsigned int* pDst, const unsigned int* pSrc, std::size_t n, std::size_t nV ) { meshopt_optimizeVertexCache( pDst, pSrc, n, nV ); } );
+            Try( [&]( unsigned int* pDst, const unsigned int* pSrc, std::size_t n, std::size_t nV ) { meshopt_optimizeVertexCacheFifo( pDst, pSrc, n, nV, Profile.m_CacheSize ); } );
+            Try( []( unsigned int* pDst, const unsigned int* pSrc, std::size_t n, std::size_t nV ) { meshopt_optimizeVertexCacheStrip( pDst, pSrc, n, nV ); } );
+        }
+
+        static constexpr std::uint32_t strip_restart_v = ~0u;       // In Indices32, narrowed to 0xffff with 16 bit indices
+
+        //
+        // Triangles of a strip as a list, Start (when given) gets where each one starts in the index stream.
+        // The triangles keep the strip order of their indices, so every other one is wound backwards; the
+        // users (bounds, BVH, cache stats) do not care about the winding.
+        //
+        static void Unstripify( std::span<const std::uint32_t> Strip, std::uint32_t iFirst, std::vector<std::uint32_t>& List, std::vector<std::uint32_t>* pStart = nullptr )
+        {
+            std::size_t Run = 0;
+            for( std::size_t i = 0; i < Strip.size(); ++i )
+            {
+                if( Strip[i] == strip_restart_v ) { Run = 0; continue; }
+                if( ++Run < 3 ) continue;
+
+                const auto A = Strip[i - 2], B = Strip[i - 1], C = Strip[i];
+                if( A == B || B == C || A == C ) continue;
+
+                List.insert( List.end(), { A, B, C } );
+                if( pStart ) pStart->push_back( iFirst + std::uint32_t(i - 2) );
+            }
+        }
+
+        //
+        // Box and sphere of the vertices referenced by the submesh indices. A LOD submesh only references what its
+        // simplified triangles kept, so it can be tighter than the LOD 0 one. The sphere is Ritter's, or the one
+        // around the box center when that one is smaller.
+        //
+        static void ComputeSubmeshBounds( xgeom::submesh& Submesh, const std::vector<xcore::vector3d>& Positions, std::span<const std::uint32_t> Indices ) noexcept
+        {
+            auto Distance2 = []( const xcore::vector3d& A, const xcore::vector3d& B ) noexcept
+            {
+                const float X = A.m_X - B.m_X, Y = A.m_Y - B.m_Y, Z = A.m_Z - B.m_Z;
+                return X*X + Y*Y + Z*Z;
+            };
+
+            if( Indices.empty() )
+            {
+                Submesh.m_BBox.m_Min.m_X = Submesh.m_BBox.m_Min.m_Y = Submesh.m_BBox.m_Min.m_Z = 0;
+                Submesh.m_BBox.m_Max.m_X = Submesh.m_BBox.m_Max.m_Y = Submesh.m_BBox.m_Max.m_Z = 0;
+                Submesh.m_SphereCenter   = xcore::vector3d{ 0, 0, 0 };
+                Submesh.m_SphereRadius   = 0;
+                return;
+            }
+
+            //
+            // Box
+            //
+            xcore::vector3d Min = Positions[Indices[0]];
+            xcore::vector3d Max = Min;
+            for( const auto i : Indices )
+            {
+                const auto& P = Positions[i];
+                Min.m_X = std::min( Min.m_X, P.m_X ); Max.m_X = std::max( Max.m_X, P.m_X );
+                Min.m_Y = std::min( Min.m_Y, P.m_Y ); Max.m_Y = std::max( Max.m_Y, P.m_Y );
+                Min.m_Z = std::min( Min.m_Z, P.m_Z ); Max.m_Z = std::max( Max.m_Z, P.m_Z );
+            }
+
+            Submesh.m_BBox.m_Min.m_X = Min.m_X; Submesh.m_BBox.m_Min.m_Y = Min.m_Y; Submesh.m_BBox.m_Min.m_Z = Min.m_Z;
+            Submesh.m_BBox.m_Max.m_X = Max.m_X; Submesh.m_BBox.m_Max.m_Y = Max.m_Y; Submesh.m_BBox.m_Max.m_Z = Max.m_Z;
+
+            //
+            // Sphere around the box center
+            //
+            const xcore::vector3d BoxCenter{ (Min.m_X + Max.m_X) * 0.5f, (Min.m_Y + Max.m_Y) * 0.5f, (Min.m_Z + Max.m_Z) * 0.5f };
+            float BoxRadius2 = 0;
+            for( const auto i : Indices ) BoxRadius2 = std::max( BoxRadius2, Distance2( BoxCenter, Positions[i] ) );
+
+            //
+            // Ritter's sphere, start with the two points far apart and grow it to include the rest
+            //
+            auto Farthest = [&]( const xcore::vector3d& From ) noexcept
+            {
+                std::uint32_t iBest = Indices[0];
+                float         Best  = -1;
+                for( const auto i : Indices )
+                {
+                    const auto D = Distance2( From, Positions[i] );
+                    if( D > Best ) { Best = D; iBest = i; }
+                }
+                return Positions[iBest];
+            };
+
+            const auto A = Farthest( Positions[Indices[0]] );
+            const auto B = Farthest( A );
+
+            xcore::vector3d Center{ (A.m_X + B.m_X) * 0.5f, (A.m_Y + B.m_Y) * 0.5f, (A.m_Z + B.m_Z) * 0.5f };
+            float           Radius = std::sqrt( Distance2( A, B ) ) * 0.5f;
+
+            for( const auto i : Indices )
+            {
+                const auto& P = Positions[i];
+                const auto  D = std::sqrt( Distance2( Center, P ) );
+                if( D <= Radius ) continue;
+
+                // Move the center toward the point just enough to touch it from the opposite side
+                const auto NewRadius = (Radius + D) * 0.5f;
+                const auto t         = (NewRadius - Radius) / D;
+                Center.m_X += (P.m_X - Center.m_X) * t;
+                Center.m_Y += (P.m_Y - Center.m_Y) * t;
+                Center.m_Z += (P.m_Z - Center.m_Z) * t;
+                Radius      = NewRadius;
+            }
+
+            // Float rounding while growing can leave points a hair outside
+            float Radius2 = 0;
+            for( const auto i : Indices ) Radius2 = std::max( Radius2, Distance2( Center, Positions[i] ) );
+            Radius = std::sqrt( Radius2 );
+
+            if( BoxRadius2 < Radius2 )
+            {
+                Submesh.m_SphereCenter = BoxCenter;
+                Submesh.m_SphereRadius = std::sqrt( BoxRadius2 );
+            }
+            else
+            {
+                Submesh.m_SphereCenter = Center;
+                Submesh.m_SphereRadius = Radius;
+            }
+        }
+
+        //
+        // Regroups the stream infos built from the layout flags into the streams the descriptor asked for. The
+        // formats stay as they are, only the stream and offset change. An element named in several groups
+        // gets one stream info per group (and is written in each), elements no group names go together in
+        // one last stream so nothing is dropped.
+        //
+        static void ApplyStreamGroups( std::string_view Groups, xgeom& FinalGeom )
+        {
+            static constexpr std::array<std::pair<std::string_view, std::uint8_t>, 7> names_v
+            {{ { "Position",    xgeom::stream_info::element_def::position_mask_v    }
+             , { "UVs",         xgeom::stream_info::element_def::uv_mask_v          }
+             , { "Color",       xgeom::stream_info::element_def::color_mask_v       }
+             , { "BoneWeights", xgeom::stream_info::element_def::bone_weight_mask_v }
+             , { "BoneIndices", xgeom::stream_info::element_def::bone_index_mask_v  }
+             , { "BTN",         xgeom::stream_info::element_def::btn_mask_v         }
+             , { "MaterialID",  xgeom::stream_info::element_def::material_id_mask_v }
+            }};
+
+            //
+            // One mask per group
+            //
+            std::vector<std::uint8_t> Masks;
+            for( std::size_t Begin = 0; Begin <= Groups.size(); )
+            {
+                const auto End   = std::min( Groups.find( '|', Begin ), Groups.size() );
+                const auto Group = Groups.substr( Begin, End - Begin );
+                std::uint8_t Mask = 0;
+
+                for( std::size_t i = 0; (i = Group.find_first_not_of( " \t,", i )) != std::string_view::npos; )
+                {
+                    const auto j    = std::min( Group.find_first_of( " \t,", i ), Group.size() );
+                    const auto Name = Group.substr( i, j - i );
+                    const auto It   = std::find_if( names_v.begin(), names_v.end(), [&]( const auto& N ) { return N.first == Name; } );
+                    if( It == names_v.end() )
+                        throw(std::runtime_error( xcore::string::Fmt( "Unknown element (%s) in the stream groups, use Position UVs Color BoneWeights BoneIndices BTN MaterialID", std::string(Name).c_str() ).data() ));
+                    Mask |= It->second;
+                    i = j;
+                }
+
+                if( Mask ) Masks.push_back( Mask );
+                Begin = End + 1;
+            }
+
+            std::uint8_t Named = 0;
+            for( const auto M : Masks ) Named |= M;
+            if( const std::uint8_t Rest = FinalGeom.m_StreamTypes.m_Value & ~Named & ~xgeom::stream_info::element_def::index_mask_v; Rest )
+            {
+                printf( "INFO: Elements not named in the stream groups go in their own stream\n" );
+                Masks.push_back( Rest );
+            }
+
+            //
+            // Stream 0 keeps the indices, every group with something in it becomes the next stream
+            //
+            const auto Source   = FinalGeom.m_StreamInfo;
+            const int  nSource  = FinalGeom.m_nStreamInfos;
+            FinalGeom.m_nStreamInfos = 1;
+            FinalGeom.m_nStreams     = 1;
+
+            for( const auto Mask : Masks )
+            {
+                std::uint32_t Offset = 0;
+                for( int i = 1; i < nSource; ++i )
+                {
+                    if( (Source[i].m_ElementsType.m_Value & Mask) == 0 ) continue;
+
+                    if( FinalGeom.m_nStreamInfos == xgeom::max_stream_info_count_v )
+                        throw(std::runtime_error( xcore::string::Fmt( "The stream groups repeat elements too much, at most %d elements in total", xgeom::max_stream_info_count_v - 1 ).data() ));
+
+                    auto& Info = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos++];
+                    Info           = Source[i];
+                    Info.m_iStream = FinalGeom.m_nStreams;
+                    Info.m_Offset  = std::uint8_t( xcore::bits::Align( Offset, int(Info.getVectorElementSize()) ) );
+                    Offset         = Info.m_Offset + Info.getSize();
+                }
+
+                // Groups with elements this geometry does not have add no stream
+                if( Offset == 0 ) continue;
+
+                if( FinalGeom.m_nStreams == xgeom::max_stream_count_v )
+                    throw(std::runtime_error( xcore::string::Fmt( "Too many stream groups, at most %d vertex streams", xgeom::max_stream_count_v - 1 ).data() ));
+                FinalGeom.m_nStreams++;
+            }
+        }
+
+        // With bConsumeCompilerMesh the intermediate meshes are released as they are gathered, only
+        // valid when a single target is generated. Otherwise it only reads and can run in parallel.
+        void GenerateFinalMesh( const xgeom_compiler::descriptor& CompilerOption, const xgeom_compiler::descriptor::streams& Streams, xgeom& FinalGeom, bool bConsumeCompilerMesh )
+        {
+            std::vector<std::uint32_t>  Indices32;
+            vertex_soa                  FinalVertex;
+            std::vector<xgeom::mesh>    FinalMeshes;
+            std::vector<xgeom::submesh> FinalSubmeshes;
+            std::vector<xgeom::lod>     FinalLod;
+            std::vector<xgeom::cluster_dag> FinalClusterDAGs;
+            std::vector<xgeom::cluster> FinalClusters;
+            int                         UVDimensionCount     = 0;
+            int                         WeightDimensionCount = 0;
+            int                         ColorDimensionCount  = 0;
+            bool                        bHasMaterialIDs      = false;
+
+            const bool                  bKeepBones           = CompilerOption.m_Cleanup.m_bRemoveBones == false;
+            bool                        bHasStrips           = false;
+
+            //
+            // Indices of a submesh into the index stream, as a strip when asked and it comes out shorter
+            //
+            const vertex_cache_profile* pCacheProfile = Streams.m_VertexCacheProfile.empty() ? nullptr : &FindVertexCacheProfile( Streams.m_VertexCacheProfile.data() );
+            std::vector<std::uint32_t>  Tuned, StripOrder, Strip;
+            auto AddSubmeshIndices = [&]( xgeom::submesh& FinalSubmesh, const std::vector<std::uint32_t>& Indices, std::size_t iBaseVertex, std::size_t nVertices )
+            {
+                // The target hardware may like another order than the shared one
+                const auto& Source = (pCacheProfile && Indices.empty() == false) ? (TuneVertexCache( *pCacheProfile, Indices, nVertices, Tuned ), Tuned) : Indices;
+
+                std::span<const std::uint32_t> Out = Source;
+                FinalSubmesh.m_Topology = xgeom::submesh::topology::TRIANGLE_LIST;
+
+                if( Streams.m_bTriangleStrips && Source.empty() == false )
+                {
+                    // The profile already weighed the strip order against the others
+                    if( pCacheProfile ) StripOrder = Source;
+                    else
+                    {
+                        StripOrder.resize( Source.size() );
+                        meshopt_optimizeVertexCacheStrip( StripOrder.data(), Source.data(), Source.size(), nVertices );
+                    }
+                    Strip.resize( meshopt_stripifyBound( Source.size() ) );
+                    Strip.resize( meshopt_stripify( Strip.data(), StripOrder.data(), StripOrder.size(), nVertices, strip_restart_v ) );
+
+                    if( Strip.size() < Source.size() )
+                    {
+                        Out                     = Strip;
+                        FinalSubmesh.m_Topology = xgeom::submesh::topology::TRIANGLE_STRIP;
+                        bHasStrips              = true;
+                    }
+                }
+
+                FinalSubmesh.m_iIndex   = std::uint32_t(Indices32.size());
+                FinalSubmesh.m_nIndices = std::uint32_t(Out.size());
+                for( const auto Index : Out ) Indices32.push_back( Index == strip_restart_v ? Index : std::uint32_t(Index + iBaseVertex) );
+            };
+
+            FinalMeshes.resize(m_CompilerMesh.size() );
+
+            //
+            // Pre-size everything from the known counts
+            //
+            std::size_t nTotalVerts = 0;
+            {
+                std::size_t nIndices = 0, nSubmeshes = 0, nLODs = 0;
+                for( const auto& M : m_CompilerMesh )
                 {
-                    meshopt_optimizeVertexCache ( S.m_Indices.data(), S.m_Indices.data(), S.m_Indices.size(), S.m_Vertex.size() ); 
-                    meshopt_optimizeOverdraw    ( S.m_Indices.data(), S.m_Indices.data(), S.m_Indices.size(), &S.m_Vertex[0].m_Position.m_X, S.m_Vertex.size(), sizeof(vertex), 1.0f );
-
-                    for( auto& L : S.m_LODs )
+                    std::size_t nMeshLODs = 0;
+                    for( const auto& S : M.m_SubMesh )
                     {
-                        meshopt_optimizeVertexCache ( L.m_Indices.data(), L.m_Indices.data(), L.m_Indices.size(), S.m_Vertex.size() );
-                        meshopt_optimizeOverdraw    ( L.m_Indices.data(), L.m_Indices.data(), L.m_Indices.size(), &S.m_Vertex[0].m_Position.m_X, S.m_Vertex.size(), sizeof(vertex), 1.0f );
+                        nTotalVerts += S.m_Vertex.size();
+                        nIndices    += S.m_Indices.size();
+                        for( const auto& L : S.m_LODs )     nIndices += L.m_Indices.size();
+                        for( const auto& C : S.m_Clusters ) nIndices += C.m_Indices.size();
+                        nSubmeshes  += 1 + S.m_LODs.size();
+                        nMeshLODs    = std::max( nMeshLODs, S.m_LODs.size() );
                     }
+                    nLODs += 2 + nMeshLODs;
                 }
-            }
-        }
-
-        void GenerateFinalMesh(const xgeom_compiler::descriptor& CompilerOption)
-        {
-            std::vector<std::uint32_t>  Indices32;
-            std::vector<vertex>         FinalVertex;
-            std::vector<xgeom::mesh>    FinalMeshes;
-            std::vector<xgeom::submesh> FinalSubmeshes;
-            std::vector<xgeom::lod>     FinalLod;
-            int                         UVDimensionCount     = 0;
-            int                         WeightDimensionCount = 0;
-            int                         ColorDimensionCount  = 0;
 
-            FinalMeshes.resize(m_CompilerMesh.size() );
+                Indices32.reserve( nIndices );
+                FinalSubmeshes.reserve( nSubmeshes );
+                FinalLod.reserve( nLODs );
+            }
 
             for( int iMesh = 0; iMesh < FinalMeshes.size(); ++iMesh )
             {
@@ -250,30 +1646,78 @@ namespace xgeom_compiler
                 // Gather LOD 0
                 //
                 std::vector<int> SubmeshStartIndex;
+                std::vector<std::size_t> SubmeshVertexCount;
                 for( auto& S : CompMesh.m_SubMesh )
                 {
                     const auto iBaseVertex = FinalVertex.size();
                     SubmeshStartIndex.push_back((int)iBaseVertex);
+                    SubmeshVertexCount.push_back( S.m_Vertex.size() );
                     auto& FinalSubmesh = FinalSubmeshes.emplace_back();
 
                     FinalSubmesh.m_iMaterial = S.m_iMaterial;
-                    FinalSubmesh.m_iIndex    = std::uint32_t(Indices32.size());
-                    FinalSubmesh.m_nIndices  = std::uint32_t(S.m_Indices.size());
+                    FinalSubmesh.m_nWeights  = std::uint8_t( bKeepBones ? S.m_nWeights : 0 );
 
                     UVDimensionCount        = std::max( S.m_nUVs, UVDimensionCount );
                     WeightDimensionCount    = std::max( S.m_nWeights, WeightDimensionCount );
                     ColorDimensionCount     = std::max( S.m_bHasColor?1:0, ColorDimensionCount );
+                    bHasMaterialIDs         = bHasMaterialIDs || S.m_bHasMaterialID;
 
-                    for( const auto& Index : S.m_Indices )
+                    AddSubmeshIndices( FinalSubmesh, S.m_Indices, iBaseVertex, S.m_Vertex.size() );
+
+                    // The cluster DAG indexes the same vertices as LOD 0
+                    if( S.m_Clusters.empty() == false )
                     {
-                        Indices32.push_back( std::uint32_t(Index + iBaseVertex) );
+                        auto& DAG = FinalClusterDAGs.emplace_back( xgeom::cluster_dag
+                        { .m_iCluster  = std::uint32_t(FinalClusters.size())
+                        , .m_nClusters = std::uint32_t(S.m_Clusters.size())
+                        , .m_iSubmesh  = std::uint16_t(FinalSubmeshes.size() - 1)
+                        , .m_nLevels   = 0
+                        });
+
+                        for( const auto& C : S.m_Clusters )
+                        {
+                            FinalClusters.push_back( xgeom::cluster
+                            { .m_Bounds       = C.m_Bounds
+                            , .m_ParentBounds = C.m_ParentBounds
+                            , .m_Error        = C.m_Error
+                            , .m_ParentError  = C.m_ParentError
+                            , .m_iIndex       = std::uint32_t(Indices32.size())
+                            , .m_nIndices     = std::uint16_t(C.m_Indices.size())
+                            , .m_Level        = std::uint8_t(C.m_Level)
+                            });
+                            DAG.m_nLevels = std::max( DAG.m_nLevels, std::uint8_t(C.m_Level + 1) );
+
+                            for( const auto Index : C.m_Indices ) Indices32.push_back( std::uint32_t(Index + iBaseVertex) );
+                        }
                     }
 
-                    for( const auto& Verts : S.m_Vertex )
+                    if( S.m_Vertex.size() )
                     {
-                        FinalMesh.m_BBox.AddVerts( &Verts.m_Position, 1 );
-                        m_FinalGeom.m_BBox.AddVerts( &Verts.m_Position, 1 );
-                        FinalVertex.push_back(Verts);
+                        std::array<xcore::vector3d, 2> MinMax
+                        { xcore::vector3d{  std::numeric_limits<float>::max(),    std::numeric_limits<float>::max(),    std::numeric_limits<float>::max() }
+                        , xcore::vector3d{ -std::numeric_limits<float>::max(),   -std::numeric_limits<float>::max(),   -std::numeric_limits<float>::max() }
+                        };
+                        kernels::ComputeBBox( S.m_Vertex.m_Position, MinMax[0], MinMax[1] );
+
+                        FinalMesh.m_BBox.AddVerts( MinMax.data(), 2 );
+                        FinalGeom.m_BBox.AddVerts( MinMax.data(), 2 );
+
+                        if( bConsumeCompilerMesh )
+                        {
+                            // Take the buffers when this submesh has all the vertices, otherwise free them as soon as they are copied
+                            if( S.m_Vertex.size() == nTotalVerts ) FinalVertex = std::move(S.m_Vertex);
+                            else
+                            {
+                                if( FinalVertex.size() == 0 ) FinalVertex.reserve( nTotalVerts );
+                                FinalVertex.Append( S.m_Vertex );
+                            }
+                            S.m_Vertex = {};
+                        }
+                        else
+                        {
+                            if( FinalVertex.size() == 0 ) FinalVertex.reserve( nTotalVerts );
+                            FinalVertex.Append( S.m_Vertex );
+                        }
                     }
                 }
 
@@ -298,13 +1742,9 @@ namespace xgeom_compiler
                         auto& FinalSubmesh = FinalSubmeshes.emplace_back();
 
                         FinalSubmesh.m_iMaterial = S.m_iMaterial;
-                        FinalSubmesh.m_iIndex    = std::uint32_t(Indices32.size());
-                        FinalSubmesh.m_nIndices  = std::uint32_t(S.m_Indices.size());
+                        FinalSubmesh.m_nWeights  = std::uint8_t( bKeepBones ? S.m_nWeights : 0 );
 
-                        for (const auto& Index : S.m_Indices)
-                        {
-                            Indices32.push_back(std::uint32_t(Index + iBaseVertex));
-                        }
+                        AddSubmeshIndices( FinalSubmesh, S.m_LODs[FinalMesh.m_nLODs].m_Indices, iBaseVertex, SubmeshVertexCount[iLocalSubmesh] );
                     }
 
                     if( LOD.m_nSubmesh == 0 )
@@ -318,6 +1758,8 @@ namespace xgeom_compiler
                     }
 
                 } while(true);
+
+                if( bConsumeCompilerMesh ) CompMesh.m_SubMesh = {};
             }
 
             //-----------------------------------------------------------------------------------
@@ -326,53 +1768,138 @@ namespace xgeom_compiler
 
             // vertex fetch optimization should go last as it depends on the final index order
             // note that the order of LODs above affects vertex fetch results
-            FinalVertex.resize( meshopt_optimizeVertexFetch( FinalVertex.data(), Indices32.data(), Indices32.size(), FinalVertex.data(), FinalVertex.size(), sizeof(FinalVertex[0]) ) );
+            {
+                std::vector<unsigned int> RemapTable( FinalVertex.size() );
+                if( bHasStrips )
+                {
+                    // Restarts are not vertices, the remap only cares about the order the vertices are first used in
+                    std::vector<std::uint32_t> Used;
+                    Used.reserve( Indices32.size() + 2 );
+                    std::copy_if( Indices32.begin(), Indices32.end(), std::back_inserter(Used), []( std::uint32_t I ) { return I != strip_restart_v; } );
+                    while( Used.size() % 3 ) Used.push_back( Used.back() );
+
+                    const auto nUniqueVerts = meshopt_optimizeVertexFetchRemap( RemapTable.data(), Used.data(), Used.size(), FinalVertex.size() );
+                    for( auto& I : Indices32 ) if( I != strip_restart_v ) I = RemapTable[I];
+                    FinalVertex.Remap( RemapTable, nUniqueVerts );
+                }
+                else
+                {
+                    const auto nUniqueVerts = meshopt_optimizeVertexFetchRemap( RemapTable.data(), Indices32.data(), Indices32.size(), FinalVertex.size() );
+                    meshopt_remapIndexBuffer( Indices32.data(), Indices32.data(), Indices32.size(), RemapTable.data() );
+                    FinalVertex.Remap( RemapTable, nUniqueVerts );
+                }
+            }
+
+            // Bounds go after the remap since they are computed from the final indices
+            std::vector<std::uint32_t> StripTriangles;
+            for( auto& Submesh : FinalSubmeshes )
+            {
+                std::span<const std::uint32_t> Indices( Indices32.data() + Submesh.m_iIndex, Submesh.m_nIndices );
+                if( Submesh.m_Topology == xgeom::submesh::topology::TRIANGLE_STRIP )
+                {
+                    StripTriangles.clear();
+                    Unstripify( Indices, Submesh.m_iIndex, StripTriangles );
+                    Indices = StripTriangles;
+                }
+                ComputeSubmeshBounds( Submesh, FinalVertex.m_Position, Indices );
+            }
+
+            //
+            // Raycast BVH of every LOD, over the final triangles so the hits map back to the index stream
+            //
+            std::vector<xgeom::bvh>             FinalBVH;
+            std::vector<xgeom::bvh_node>        FinalBVHNodes;
+            std::vector<xgeom::bvh_triangle>    FinalBVHTriangles;
+            if( CompilerOption.m_Raycast.m_bBuildBVH )
+            {
+                std::vector<std::uint32_t> LODIndices, LODIndexStart;
+                for( const auto& LOD : FinalLod )
+                {
+                    LODIndices.clear();
+                    LODIndexStart.clear();
+                    for( int iSub = LOD.m_iSubmesh; iSub < LOD.m_iSubmesh + LOD.m_nSubmesh; ++iSub )
+                    {
+                        const auto& Submesh = FinalSubmeshes[iSub];
+                        if( Submesh.m_Topology == xgeom::submesh::topology::TRIANGLE_STRIP )
+                        {
+                            Unstripify( std::span<const std::uint32_t>( Indices32.data() + Submesh.m_iIndex, Submesh.m_nIndices ), Submesh.m_iIndex, LODIndices, &LODIndexStart );
+                            continue;
+                        }
+
+                        LODIndices.insert( LODIndices.end(), Indices32.begin() + Submesh.m_iIndex, Indices32.begin() + Submesh.m_iIndex + Submesh.m_nIndices );
+                        for( auto i = Submesh.m_iIndex; i + 2 < Submesh.m_iIndex + Submesh.m_nIndices; i += 3 ) LODIndexStart.push_back( i );
+                    }
+
+                    FinalBVH.push_back( bvh::Build( LODIndices, LODIndexStart, FinalVertex.m_Position, CompilerOption.m_Raycast.m_BVHLeafSize, FinalBVHNodes, FinalBVHTriangles ) );
+                }
+
+                printf( "INFO: Raycast BVH %d nodes, %d triangles (%d KB)\n"
+                , int(FinalBVHNodes.size())
+                , int(FinalBVHTriangles.size())
+                , int( (FinalBVHNodes.size() * sizeof(xgeom::bvh_node) + FinalBVHTriangles.size() * sizeof(xgeom::bvh_triangle)) / 1024 ) );
+            }
+
+            // The analyzers only take lists
+            std::vector<std::uint32_t> ListIndices;
+            if( bHasStrips )
+            {
+                for( const auto& Submesh : FinalSubmeshes )
+                {
+                    if( Submesh.m_Topology == xgeom::submesh::topology::TRIANGLE_STRIP ) Unstripify( std::span<const std::uint32_t>( Indices32.data() + Submesh.m_iIndex, Submesh.m_nIndices ), Submesh.m_iIndex, ListIndices );
+                    else ListIndices.insert( ListIndices.end(), Indices32.begin() + Submesh.m_iIndex, Indices32.begin() + Submesh.m_iIndex + Submesh.m_nIndices );
+                }
+                for( const auto& C : FinalClusters ) ListIndices.insert( ListIndices.end(), Indices32.begin() + C.m_iIndex, Indices32.begin() + C.m_iIndex + C.m_nIndices );
+            }
+            const auto& StatIndices = bHasStrips ? ListIndices : Indices32;
 
             const int kCacheSize = 16;
-            m_VertCacheStats = meshopt_analyzeVertexCache(Indices32.data(), Indices32.size(), FinalVertex.size(), kCacheSize, 0, 0);
-            m_VertFetchStats = meshopt_analyzeVertexFetch(Indices32.data(), Indices32.size(), FinalVertex.size(), sizeof(FinalVertex[0]));
-            m_OverdrawStats  = meshopt_analyzeOverdraw   (Indices32.data(), Indices32.size(), &FinalVertex[0].m_Position.m_X, FinalVertex.size(), sizeof(FinalVertex[0]) );
+            const auto VertCacheStats = meshopt_analyzeVertexCache(StatIndices.data(), StatIndices.size(), FinalVertex.size(), kCacheSize, 0, 0);
+            const auto VertFetchStats = meshopt_analyzeVertexFetch(StatIndices.data(), StatIndices.size(), FinalVertex.size(), sizeof(xcore::vector3d));
+            const auto OverdrawStats  = meshopt_analyzeOverdraw   (StatIndices.data(), StatIndices.size(), &FinalVertex.m_Position[0].m_X, FinalVertex.size(), sizeof(xcore::vector3d) );
 
-            m_VertCacheNVidiaStats  = meshopt_analyzeVertexCache(Indices32.data(), Indices32.size(), FinalVertex.size(), 32, 32, 32);
-            m_VertCacheAMDStats     = meshopt_analyzeVertexCache(Indices32.data(), Indices32.size(), FinalVertex.size(), 14, 64, 128);
-            m_VertCacheIntelStats   = meshopt_analyzeVertexCache(Indices32.data(), Indices32.size(), FinalVertex.size(), 128, 0, 0);
+            auto AnalyzeProfile = [&]( const vertex_cache_profile& P ) { return meshopt_analyzeVertexCache(StatIndices.data(), StatIndices.size(), FinalVertex.size(), P.m_CacheSize, P.m_WarpSize, P.m_PrimGroupSize); };
+            const auto VertCacheNVidiaStats  = AnalyzeProfile( FindVertexCacheProfile( "NVIDIA" ) );
+            const auto VertCacheAMDStats     = AnalyzeProfile( FindVertexCacheProfile( "AMD" ) );
+            const auto VertCacheIntelStats   = AnalyzeProfile( FindVertexCacheProfile( "INTEL" ) );
 
             // TODO: Translate this information into a scoring system that goes from 100% to 0% (or something that makes more sense to casual users)
             printf("INFO: ACMR %f ATVR %f (NV %f AMD %f Intel %f) Overfetch %f Overdraw %f\n"
-            , m_VertCacheStats.acmr         // transformed vertices / triangle count; best case 0.5, worst case 3.0, optimum depends on topology
-            , m_VertCacheStats.atvr         // transformed vertices / vertex count; best case 1.0, worst case 6.0, optimum is 1.0 (each vertex is transformed once)
-            , m_VertCacheNVidiaStats.atvr   // transformed vertices / vertex count; best case 1.0, worst case 6.0, optimum is 1.0 (each vertex is transformed once)
-            , m_VertCacheAMDStats.atvr      // transformed vertices / vertex count; best case 1.0, worst case 6.0, optimum is 1.0 (each vertex is transformed once)
-            , m_VertCacheIntelStats.atvr    // transformed vertices / vertex count; best case 1.0, worst case 6.0, optimum is 1.0 (each vertex is transformed once)
-            , m_VertFetchStats.overfetch    // fetched bytes / vertex buffer size; best case 1.0 (each byte is fetched once)
-            , m_OverdrawStats.overdraw      // fetched bytes / vertex buffer size; best case 1.0 (each byte is fetched once)
+            , VertCacheStats.acmr         // transformed vertices / triangle count; best case 0.5, worst case 3.0, optimum depends on topology
+            , VertCacheStats.atvr         // transformed vertices / vertex count; best case 1.0, worst case 6.0, optimum is 1.0 (each vertex is transformed once)
+            , VertCacheNVidiaStats.atvr   // transformed vertices / vertex count; best case 1.0, worst case 6.0, optimum is 1.0 (each vertex is transformed once)
+            , VertCacheAMDStats.atvr      // transformed vertices / vertex count; best case 1.0, worst case 6.0, optimum is 1.0 (each vertex is transformed once)
+            , VertCacheIntelStats.atvr    // transformed vertices / vertex count; best case 1.0, worst case 6.0, optimum is 1.0 (each vertex is transformed once)
+            , VertFetchStats.overfetch    // fetched bytes / vertex buffer size; best case 1.0 (each byte is fetched once)
+            , OverdrawStats.overdraw      // fetched bytes / vertex buffer size; best case 1.0 (each byte is fetched once)
             );
 
+            if( pCacheProfile ) printf( "INFO: Index order tuned for the %s vertex cache, ATVR %f\n", std::string(pCacheProfile->m_Name).c_str(), AnalyzeProfile( *pCacheProfile ).atvr );
+
             //-----------------------------------------------------------------------------------
             // Create Stream Infos
             //-----------------------------------------------------------------------------------
-            std::size_t MaxVertAligment = 1u;
+            std::size_t MaxVertAligment = std::size_t(std::max( 1, Streams.m_VertexAlignment ));
 
-            m_FinalGeom.m_nStreamInfos        = 0;
-            m_FinalGeom.m_nStreams            = 0;
-            m_FinalGeom.m_StreamTypes.m_Value = 0;
+            FinalGeom.m_nStreamInfos        = 0;
+            FinalGeom.m_nStreams            = 0;
+            FinalGeom.m_StreamTypes.m_Value = 0;
 
             //
             // Deal in indices
             //
             {
-                auto& Stream = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos];
+                auto& Stream = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos];
                 Stream.m_ElementsType.m_Value       = 0;
 
                 Stream.m_VectorCount                = 1;
                 Stream.m_Format                     = Indices32.size() > 0xffffu ? xgeom::stream_info::format::UINT32_1D : xgeom::stream_info::format::UINT16_1D;
                 Stream.m_ElementsType.m_bIndex      = true;
                 Stream.m_Offset                     = 0;
-                Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                Stream.m_iStream                    = FinalGeom.m_nStreams;
 
-                m_FinalGeom.m_StreamTypes.m_bIndex  = true;
-                m_FinalGeom.m_nStreams++;
-                m_FinalGeom.m_nStreamInfos++;
+                FinalGeom.m_StreamTypes.m_bIndex  = true;
+                FinalGeom.m_nStreams++;
+                FinalGeom.m_nStreamInfos++;
             }
 
 
@@ -380,21 +1907,21 @@ namespace xgeom_compiler
             // Deal with Position
             //
             {
-                auto& Stream = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos];
+                auto& Stream = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos];
                 Stream.m_ElementsType.m_Value       = 0;
 
                 Stream.m_VectorCount                = 1;
                 Stream.m_Format                     = xgeom::stream_info::format::FLOAT_3D;
                 Stream.m_ElementsType.m_bPosition   = true;
                 Stream.m_Offset                     = 0;
-                Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                Stream.m_iStream                    = FinalGeom.m_nStreams;
 
-                m_FinalGeom.m_StreamTypes.m_bPosition = true;
-                m_FinalGeom.m_nStreamInfos++;
+                FinalGeom.m_StreamTypes.m_bPosition = true;
+                FinalGeom.m_nStreamInfos++;
 
-                if( CompilerOption.m_Streams.m_UseElementStreams || CompilerOption.m_Streams.m_SeparatePosition )
+                if( Streams.m_UseElementStreams || Streams.m_SeparatePosition )
                 {
-                    m_FinalGeom.m_nStreams++;
+                    FinalGeom.m_nStreams++;
                 }
             }
 
@@ -407,13 +1934,13 @@ namespace xgeom_compiler
                 || CompilerOption.m_Cleanup.m_bRemoveUVs[2] == false
                 || CompilerOption.m_Cleanup.m_bRemoveUVs[3] == false ) )
             {
-                auto& Stream = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos];
+                auto& Stream = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos];
 
                 // Make sure the base offset is set
-                Stream.m_Offset = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_iStream != m_FinalGeom.m_nStreams
+                Stream.m_Offset = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_iStream != FinalGeom.m_nStreams
                     ? 0
-                    : m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_Offset 
-                        + m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].getSize();
+                    : FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_Offset 
+                        + FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].getSize();
 
                 Stream.m_ElementsType.m_Value       = 0;
 
@@ -424,15 +1951,15 @@ namespace xgeom_compiler
                 if( Stream.m_VectorCount )
                 {
                     Stream.m_ElementsType.m_bUVs        = true;
-                    Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                    Stream.m_iStream                    = FinalGeom.m_nStreams;
 
                     Stream.m_Offset = xcore::bits::Align(Stream.m_Offset, alignof(float));
                     MaxVertAligment = std::max(MaxVertAligment, alignof(float));
 
-                    m_FinalGeom.m_nStreamInfos++;
-                    m_FinalGeom.m_StreamTypes.m_bUVs = true;
+                    FinalGeom.m_nStreamInfos++;
+                    FinalGeom.m_StreamTypes.m_bUVs = true;
 
-                    if (CompilerOption.m_Streams.m_UseElementStreams) m_FinalGeom.m_nStreams++;
+                    if (Streams.m_UseElementStreams) FinalGeom.m_nStreams++;
                 }
             }
 
@@ -441,28 +1968,28 @@ namespace xgeom_compiler
             //
             if( CompilerOption.m_Cleanup.m_bRemoveColor  == false && ColorDimensionCount )
             {
-                auto& Stream = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos];
+                auto& Stream = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos];
 
                 // Make sure the base offset is set
-                Stream.m_Offset = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_iStream != m_FinalGeom.m_nStreams
+                Stream.m_Offset = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_iStream != FinalGeom.m_nStreams
                     ? 0
-                    : m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_Offset 
-                        + m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].getSize();
+                    : FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_Offset 
+                        + FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].getSize();
 
                 Stream.m_ElementsType.m_Value       = 0;
 
                 Stream.m_VectorCount                = 1;
                 Stream.m_Format                     = xgeom::stream_info::format::UINT8_4D_NORMALIZED;
                 Stream.m_ElementsType.m_bColor      = true;
-                Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                Stream.m_iStream                    = FinalGeom.m_nStreams;
 
                 Stream.m_Offset = xcore::bits::Align(Stream.m_Offset, alignof(xcore::icolor));
                 MaxVertAligment = std::max(MaxVertAligment, alignof(xcore::icolor));
 
-                m_FinalGeom.m_nStreamInfos++;
-                m_FinalGeom.m_StreamTypes.m_bColor = true;
+                FinalGeom.m_nStreamInfos++;
+                FinalGeom.m_StreamTypes.m_bColor = true;
 
-                if (CompilerOption.m_Streams.m_UseElementStreams) m_FinalGeom.m_nStreams++;
+                if (Streams.m_UseElementStreams) FinalGeom.m_nStreams++;
             }
 
             //
@@ -470,22 +1997,22 @@ namespace xgeom_compiler
             // 
             if( WeightDimensionCount && CompilerOption.m_Cleanup.m_bRemoveBones == false )
             {
-                auto& Stream = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos];
+                auto& Stream = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos];
 
                 // Make sure the base offset is set
-                Stream.m_Offset = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_iStream != m_FinalGeom.m_nStreams
+                Stream.m_Offset = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_iStream != FinalGeom.m_nStreams
                     ? 0
-                    : m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_Offset
-                    + m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].getSize();
+                    : FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_Offset
+                    + FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].getSize();
 
-                if( CompilerOption.m_Streams.m_bCompressWeights )
+                if( Streams.m_bCompressWeights )
                 {
                     Stream.m_ElementsType.m_Value       = 0;
 
                     Stream.m_VectorCount                = std::uint8_t(WeightDimensionCount);
                     Stream.m_Format                     = xgeom::stream_info::format::UINT8_1D_NORMALIZED;
                     Stream.m_ElementsType.m_bBoneWeights= true;
-                    Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                    Stream.m_iStream                    = FinalGeom.m_nStreams;
 
                     Stream.m_Offset = xcore::bits::Align(Stream.m_Offset, alignof(std::uint8_t));
                     MaxVertAligment = std::max(MaxVertAligment, alignof(std::uint8_t));
@@ -497,16 +2024,16 @@ namespace xgeom_compiler
                     Stream.m_VectorCount                = std::uint8_t(WeightDimensionCount);
                     Stream.m_Format                     = xgeom::stream_info::format::FLOAT_1D;
                     Stream.m_ElementsType.m_bBoneWeights= true; 
-                    Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                    Stream.m_iStream                    = FinalGeom.m_nStreams;
 
                     Stream.m_Offset = xcore::bits::Align(Stream.m_Offset, alignof(float));
                     MaxVertAligment = std::max(MaxVertAligment, alignof(float));
                 }
 
-                m_FinalGeom.m_nStreamInfos++;
-                m_FinalGeom.m_StreamTypes.m_bBoneWeights = true;
+                FinalGeom.m_nStreamInfos++;
+                FinalGeom.m_StreamTypes.m_bBoneWeights = true;
 
-                if (CompilerOption.m_Streams.m_UseElementStreams) m_FinalGeom.m_nStreams++;
+                if (Streams.m_UseElementStreams) FinalGeom.m_nStreams++;
             }
 
             //
@@ -514,22 +2041,23 @@ namespace xgeom_compiler
             // 
             if( WeightDimensionCount && CompilerOption.m_Cleanup.m_bRemoveBones == false )
             {
-                auto& Stream = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos];
+                auto& Stream = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos];
 
                 // Make sure the base offset is set
-                Stream.m_Offset = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_iStream != m_FinalGeom.m_nStreams
+                Stream.m_Offset = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_iStream != FinalGeom.m_nStreams
                     ? 0
-                    : m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_Offset
-                    + m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].getSize();
+                    : FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_Offset
+                    + FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].getSize();
 
-                if( CompilerOption.m_Streams.m_bCompressWeights || (m_RawGeom.m_Bone.size() < 0xff) )
+                // Only the bone count decides, compressing the weights says nothing about how many bones there are
+                if( m_nRawBones <= 0x100 )
                 {
                     Stream.m_ElementsType.m_Value       = 0;
 
                     Stream.m_VectorCount                = std::uint8_t(WeightDimensionCount);
                     Stream.m_Format                     = xgeom::stream_info::format::UINT8_1D;
                     Stream.m_ElementsType.m_bBoneIndices= true;
-                    Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                    Stream.m_iStream                    = FinalGeom.m_nStreams;
 
                     Stream.m_Offset = xcore::bits::Align(Stream.m_Offset, alignof(std::uint8_t));
                     MaxVertAligment = std::max(MaxVertAligment, alignof(std::uint8_t));
@@ -541,16 +2069,16 @@ namespace xgeom_compiler
                     Stream.m_VectorCount                = std::uint8_t(WeightDimensionCount);
                     Stream.m_Format                     = xgeom::stream_info::format::UINT16_1D;
                     Stream.m_ElementsType.m_bBoneIndices= true;
-                    Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                    Stream.m_iStream                    = FinalGeom.m_nStreams;
 
                     Stream.m_Offset = xcore::bits::Align(Stream.m_Offset, alignof(std::uint16_t));
                     MaxVertAligment = std::max(MaxVertAligment, alignof(std::uint16_t));
                 }
 
-                m_FinalGeom.m_nStreamInfos++;
-                m_FinalGeom.m_StreamTypes.m_bBoneIndices = true;
+                FinalGeom.m_nStreamInfos++;
+                FinalGeom.m_StreamTypes.m_bBoneIndices = true;
 
-                if (CompilerOption.m_Streams.m_UseElementStreams) m_FinalGeom.m_nStreams++;
+                if (Streams.m_UseElementStreams) FinalGeom.m_nStreams++;
             }
 
             //
@@ -558,24 +2086,24 @@ namespace xgeom_compiler
             //
             if( CompilerOption.m_Cleanup.m_bRemoveBTN == false )
             {
-                auto& Stream = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos];
+                auto& Stream = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos];
 
                 // If the position has a different stream then our offset should be zero
                 // Other wise we are dealing with a single vertex structure. In that case
                 // we should set our offset propertly.
-                Stream.m_Offset = m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_iStream != m_FinalGeom.m_nStreams 
+                Stream.m_Offset = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_iStream != FinalGeom.m_nStreams 
                     ? 0
-                    : m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_Offset 
-                        + m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].getSize();
+                    : FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_Offset 
+                        + FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].getSize();
 
-                if( CompilerOption.m_Streams.m_bCompressBTN == false )
+                if( Streams.m_bCompressBTN == false )
                 {
                     Stream.m_ElementsType.m_Value       = 0;
 
                     Stream.m_VectorCount                = 3;
                     Stream.m_Format                     = xgeom::stream_info::format::FLOAT_3D;
                     Stream.m_ElementsType.m_bBTNs       = true;
-                    Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                    Stream.m_iStream                    = FinalGeom.m_nStreams;
 
                     Stream.m_Offset = xcore::bits::Align(Stream.m_Offset, alignof(xcore::vector3d));
                     MaxVertAligment = std::max( MaxVertAligment, alignof(xcore::vector3d) );
@@ -587,64 +2115,181 @@ namespace xgeom_compiler
                     Stream.m_VectorCount                = 3;
                     Stream.m_Format                     = xgeom::stream_info::format::SINT8_3D_NORMALIZED;
                     Stream.m_ElementsType.m_bBTNs       = true;
-                    Stream.m_iStream                    = m_FinalGeom.m_nStreams;
+                    Stream.m_iStream                    = FinalGeom.m_nStreams;
 
                     Stream.m_Offset = xcore::bits::Align(Stream.m_Offset, alignof(std::int8_t));
                     MaxVertAligment = std::max(MaxVertAligment, alignof(std::int8_t));
                 }
 
-                m_FinalGeom.m_nStreamInfos++;
-                m_FinalGeom.m_StreamTypes.m_bBTNs = true;
+                FinalGeom.m_nStreamInfos++;
+                FinalGeom.m_StreamTypes.m_bBTNs = true;
+
+                if (Streams.m_UseElementStreams) FinalGeom.m_nStreams++;
+            }
+
+            //
+            // Deal with material IDs
+            //
+            if( bHasMaterialIDs )
+            {
+                auto& Stream = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos];
+
+                // Make sure the base offset is set
+                Stream.m_Offset = FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_iStream != FinalGeom.m_nStreams
+                    ? 0
+                    : FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_Offset
+                    + FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].getSize();
+
+                const auto MaxSlice = FinalVertex.m_MaterialID.empty() ? 0 : *std::max_element( FinalVertex.m_MaterialID.begin(), FinalVertex.m_MaterialID.end() );
+
+                Stream.m_ElementsType.m_Value       = 0;
+                Stream.m_VectorCount                = 1;
+                Stream.m_ElementsType.m_bMaterialIDs= true;
+                Stream.m_iStream                    = FinalGeom.m_nStreams;
+
+                if( MaxSlice <= 0xff )
+                {
+                    Stream.m_Format                 = xgeom::stream_info::format::UINT8_1D;
+                    Stream.m_Offset                 = xcore::bits::Align(Stream.m_Offset, alignof(std::uint8_t));
+                    MaxVertAligment                 = std::max(MaxVertAligment, alignof(std::uint8_t));
+                }
+                else
+                {
+                    Stream.m_Format                 = xgeom::stream_info::format::UINT16_1D;
+                    Stream.m_Offset                 = xcore::bits::Align(Stream.m_Offset, alignof(std::uint16_t));
+                    MaxVertAligment                 = std::max(MaxVertAligment, alignof(std::uint16_t));
+                }
+
+                FinalGeom.m_nStreamInfos++;
+                FinalGeom.m_StreamTypes.m_bMaterialIDs = true;
 
-                if (CompilerOption.m_Streams.m_UseElementStreams) m_FinalGeom.m_nStreams++;
+                if (Streams.m_UseElementStreams) FinalGeom.m_nStreams++;
             }
 
             // We add another one if we are not doing streams
-            if (CompilerOption.m_Streams.m_UseElementStreams == false )
+            if (Streams.m_UseElementStreams == false )
             {
-                m_FinalGeom.m_nStreams++;
+                FinalGeom.m_nStreams++;
             }
 
             //
             // Fill up the rest of the info
             //
-            m_FinalGeom.m_nMaterials          = std::uint16_t(m_RawGeom.m_MaterialInstance.size());
-            m_FinalGeom.m_nMeshes             = std::uint16_t(FinalMeshes.size());
-            m_FinalGeom.m_nSubMeshs           = std::uint16_t(FinalSubmeshes.size());
-            m_FinalGeom.m_nIndices            = std::uint16_t(Indices32.size());
-            m_FinalGeom.m_nVertices           = std::uint32_t(FinalVertex.size());
-            m_FinalGeom.m_nLODs               = std::uint16_t(FinalLod.size());
-
-            m_FinalGeom.m_CompactedVertexSize = CompilerOption.m_Streams.m_UseElementStreams
+            FinalGeom.m_nMaterials          = std::uint16_t(m_nRawMaterials);
+            FinalGeom.m_nMeshes             = std::uint16_t(FinalMeshes.size());
+            FinalGeom.m_nSubMeshs           = std::uint16_t(FinalSubmeshes.size());
+            FinalGeom.m_nIndices            = std::uint32_t(Indices32.size());
+            FinalGeom.m_nVertices           = std::uint32_t(FinalVertex.size());
+            FinalGeom.m_nLODs               = std::uint16_t(FinalLod.size());
+
+            FinalGeom.m_CompactedVertexSize = Streams.m_UseElementStreams
                                                 ? std::uint8_t(0)
-                                                : std::uint8_t( xcore::bits::Align((std::uint32_t)m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].m_Offset
-                                                                                                + m_FinalGeom.m_StreamInfo[m_FinalGeom.m_nStreamInfos - 1].getSize()
+                                                : std::uint8_t( xcore::bits::Align((std::uint32_t)FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].m_Offset
+                                                                                                + FinalGeom.m_StreamInfo[FinalGeom.m_nStreamInfos - 1].getSize()
                                                                                                 , (int)MaxVertAligment ) );
-            m_FinalGeom.m_nBones        = 0;
-            m_FinalGeom.m_nDisplayLists = 0;
+
+            const bool bStreamGroups = Streams.m_StreamGroups.empty() == false && std::string_view( Streams.m_StreamGroups.data() ).find_first_not_of( " \t|" ) != std::string_view::npos;
+            if( bStreamGroups ) ApplyStreamGroups( Streams.m_StreamGroups.data(), FinalGeom );
+
+            //
+            // Stride of every stream. Streams with a single element are packed tight, the others are padded
+            // to the vertex alignment (the interleaved stream of the fixed layouts keeps its compacted size).
+            //
+            {
+                std::array<int, xgeom::max_stream_count_v> nElements{};
+                FinalGeom.m_StreamStride = {};
+                for( int i = 0; i < FinalGeom.m_nStreamInfos; ++i )
+                {
+                    const auto& Info   = FinalGeom.m_StreamInfo[i];
+                    auto&       Stride = FinalGeom.m_StreamStride[Info.m_iStream];
+                    Stride = std::max<std::uint8_t>( Stride, std::uint8_t( Info.m_Offset + Info.getSize() ) );
+                    nElements[Info.m_iStream]++;
+                }
+
+                for( int i = 1; i < FinalGeom.m_nStreams; ++i )
+                {
+                    if( nElements[i] > 1 ) FinalGeom.m_StreamStride[i] = std::uint8_t( xcore::bits::Align( std::uint32_t(FinalGeom.m_StreamStride[i]), int(MaxVertAligment) ) );
+                }
+
+                if( bStreamGroups == false && Streams.m_UseElementStreams == false )
+                    FinalGeom.m_StreamStride[FinalGeom.m_nStreams - 1] = FinalGeom.m_CompactedVertexSize;
+
+                // With groups the compacted size is the widest vertex, zero (stream based) when nothing shares a stream
+                if( bStreamGroups )
+                {
+                    FinalGeom.m_CompactedVertexSize = 0;
+                    if( FinalGeom.m_nStreamInfos != FinalGeom.m_nStreams )
+                        for( int i = 1; i < FinalGeom.m_nStreams; ++i ) FinalGeom.m_CompactedVertexSize = std::max( FinalGeom.m_CompactedVertexSize, FinalGeom.m_StreamStride[i] );
+                }
+            }
+            FinalGeom.m_nBones        = 0;
+            FinalGeom.m_nDisplayLists = 0;
+
+            //
+            // Render sort keys, the renderer radix sorts on these directly
+            //
+            {
+                // Stable hash of the stream layout (field by field so padding never gets in)
+                std::uint32_t FormatHash = 0x811c9dc5u;
+                auto          HashByte   = [&]( std::uint32_t V ) { FormatHash ^= V & 0xff; FormatHash *= 0x01000193u; };
+                HashByte( FinalGeom.m_nStreams );
+                HashByte( FinalGeom.m_CompactedVertexSize );
+                for( int i = 0; i < FinalGeom.m_nStreamInfos; ++i )
+                {
+                    const auto& Info = FinalGeom.m_StreamInfo[i];
+                    HashByte( Info.m_ElementsType.m_Value );
+                    HashByte( std::uint8_t(Info.m_Format) );
+                    HashByte( Info.m_VectorCount );
+                    HashByte( Info.m_Offset );
+                    HashByte( Info.m_iStream );
+                }
+
+                xgeom::sort_key_layout::values Values{};
+                auto Set = [&]( xgeom::sort_key_layout::field F, std::uint32_t V ) { Values[static_cast<int>(F)] = V; };
+
+                Set( xgeom::sort_key_layout::field::VERTEX_FORMAT, FormatHash );
+                Set( xgeom::sort_key_layout::field::SKINNED,       FinalGeom.m_StreamTypes.m_bBoneWeights ? 1u : 0u );
+                Set( xgeom::sort_key_layout::field::INDEX_WIDTH,   FinalGeom.m_StreamInfo[0].m_Format == xgeom::stream_info::format::UINT32_1D ? 1u : 0u );
+
+                for( const auto& Mesh : FinalMeshes )
+                {
+                    // The first LOD entry is LOD 0, m_nLODs counts the ones after it
+                    for( int iLOD = 0; iLOD <= Mesh.m_nLODs; ++iLOD )
+                    {
+                        const auto& LOD = FinalLod[Mesh.m_iLOD + iLOD];
+                        for( int iSub = LOD.m_iSubmesh; iSub < LOD.m_iSubmesh + LOD.m_nSubmesh; ++iSub )
+                        {
+                            Set( xgeom::sort_key_layout::field::MATERIAL, FinalSubmeshes[iSub].m_iMaterial );
+                            Set( xgeom::sort_key_layout::field::LOD,      std::uint32_t(iLOD) );
+                            FinalSubmeshes[iSub].m_BaseSortKey = m_SortKeyLayout.Pack( Values );
+                        }
+                    }
+                }
+            }
 
             //
             // Compute the size of the buffer
             //
             constexpr auto max_aligment_v = 16;
             using max_align_byte = std::byte alignas(max_aligment_v);
-            m_FinalGeom.m_DataSize  = 0;
-            m_FinalGeom.m_Stream[0] = 0;
-            for (int i = 0; i < m_FinalGeom.m_nStreams; ++i)
+            FinalGeom.m_DataSize  = 0;
+            FinalGeom.m_Stream[0] = 0;
+            for (int i = 0; i < FinalGeom.m_nStreams; ++i)
             {
-                if (i) m_FinalGeom.m_Stream[i] = m_FinalGeom.m_DataSize;
-                const auto Size = m_FinalGeom.getStreamSize(i);
-                m_FinalGeom.m_DataSize = xcore::bits::Align(m_FinalGeom.m_DataSize + Size, max_aligment_v);
+                if (i) FinalGeom.m_Stream[i] = FinalGeom.m_DataSize;
+                const auto Size = FinalGeom.getStreamSize(i);
+                FinalGeom.m_DataSize = xcore::bits::Align(FinalGeom.m_DataSize + Size, max_aligment_v);
             }
 
-            m_FinalGeom.m_pData = new max_align_byte[m_FinalGeom.m_DataSize];
+            FinalGeom.m_pData = new max_align_byte[FinalGeom.m_DataSize];
 
             //-----------------------------------------------------------------------------------
             // Create the streams and copy data
             //-----------------------------------------------------------------------------------
-            for( int i=0; i<m_FinalGeom.m_nStreamInfos; ++i )
+            const auto nVertices = FinalVertex.size();
+            for( int i=0; i<FinalGeom.m_nStreamInfos; ++i )
             {
-                const auto& StreamInfo = m_FinalGeom.m_StreamInfo[i];
+                const auto& StreamInfo = FinalGeom.m_StreamInfo[i];
 
                 switch( StreamInfo.m_ElementsType.m_Value )
                 {
@@ -655,19 +2300,13 @@ namespace xgeom_compiler
                 {
                     if (StreamInfo.m_Format == xgeom::stream_info::format::UINT32_1D)
                     {
-                        auto pIndexData = reinterpret_cast<std::uint32_t*>(m_FinalGeom.getStreamInfoData(i));
-                        for (auto i = 0u; i < Indices32.size(); ++i)
-                        {
-                            pIndexData[i] = Indices32[i];
-                        }
+                        std::memcpy( FinalGeom.getStreamInfoData(i), Indices32.data(), Indices32.size() * sizeof(std::uint32_t) );
                     }
                     else
                     {
-                        auto pIndexData = reinterpret_cast<std::uint16_t*>(m_FinalGeom.getStreamInfoData(i));
-                        for (auto i = 0u; i < Indices32.size(); ++i)
-                        {
-                            pIndexData[i] = std::uint16_t(Indices32[i]);
-                        }
+                        // The kernels saturate, the 32 bit restart would come out as 0
+                        if( bHasStrips ) std::replace( Indices32.begin(), Indices32.end(), strip_restart_v, std::uint32_t(0xffffu) );
+                        kernels::NarrowIndices( Indices32.data(), reinterpret_cast<std::uint16_t*>(FinalGeom.getStreamInfoData(i)), Indices32.size() );
                     }
                     break;
                 }
@@ -677,15 +2316,7 @@ namespace xgeom_compiler
                 case xgeom::stream_info::element_def::position_mask_v:
                 {
                     xassert(StreamInfo.getVectorElementSize() == 4);
-
-                    std::byte* pVertex = m_FinalGeom.getStreamInfoData(i);
-                    auto       Stride  = m_FinalGeom.getStreamInfoStride(i);
-                    for( auto i=0u; i< FinalVertex.size(); ++i )
-                    {
-                        *((xcore::vector3d*)pVertex) =  FinalVertex[i].m_Position;
-                        pVertex += Stride;
-                    }
-
+                    kernels::Scatter( FinalGeom.getStreamInfoData(i), FinalGeom.getStreamInfoStride(i), FinalVertex.m_Position.data(), sizeof(xcore::vector3d), sizeof(xcore::vector3d), nVertices );
                     break;
                 }
 
@@ -694,39 +2325,24 @@ namespace xgeom_compiler
                 //
                 case xgeom::stream_info::element_def::btn_mask_v:
                 {
-                    std::byte* pVertex = m_FinalGeom.getStreamInfoData(i);
-                    auto       Stride = m_FinalGeom.getStreamInfoStride(i);
+                    std::byte* pVertex = FinalGeom.getStreamInfoData(i);
+                    auto       Stride  = FinalGeom.getStreamInfoStride(i);
+                    const std::array<const std::vector<xcore::vector3d>*, 3> BTN{ &FinalVertex.m_Binormal, &FinalVertex.m_Tangent, &FinalVertex.m_Normal };
 
-                    if( CompilerOption.m_Streams.m_bCompressBTN == false )
+                    if( Streams.m_bCompressBTN == false )
                     {
                         xassert(StreamInfo.getVectorElementSize() == 4);
-                        for( auto i=0u; i< FinalVertex.size(); ++i )
-                        {
-                            std::memcpy(&pVertex[0 * sizeof(xcore::vector3d)], &FinalVertex[i].m_Binormal, sizeof(xcore::vector3d));
-                            std::memcpy(&pVertex[1 * sizeof(xcore::vector3d)], &FinalVertex[i].m_Tangent,  sizeof(xcore::vector3d));
-                            std::memcpy(&pVertex[2 * sizeof(xcore::vector3d)], &FinalVertex[i].m_Normal,   sizeof(xcore::vector3d));
-                            pVertex += Stride;
-                        }
+                        for( int k = 0; k < 3; ++k )
+                            kernels::Scatter( &pVertex[k * sizeof(xcore::vector3d)], Stride, BTN[k]->data(), sizeof(xcore::vector3d), sizeof(xcore::vector3d), nVertices );
                     }
                     else
                     {
                         xassert(StreamInfo.getVectorElementSize() == 1);
-                        Stride -= 3*3;
-                        for( auto i=0u; i< FinalVertex.size(); ++i )
+                        std::vector<std::uint8_t> Quantized( nVertices * 3 );
+                        for( int k = 0; k < 3; ++k )
                         {
-                            *pVertex = std::byte(FinalVertex[i].m_Binormal.m_X * (0xff >> 1)); pVertex++;
-                            *pVertex = std::byte(FinalVertex[i].m_Binormal.m_Y * (0xff >> 1)); pVertex++;
-                            *pVertex = std::byte(FinalVertex[i].m_Binormal.m_Z * (0xff >> 1)); pVertex++;
-
-                            *pVertex = std::byte(FinalVertex[i].m_Tangent.m_X * (0xff >> 1)); pVertex++;
-                            *pVertex = std::byte(FinalVertex[i].m_Tangent.m_Y * (0xff >> 1)); pVertex++;
-                            *pVertex = std::byte(FinalVertex[i].m_Tangent.m_Z * (0xff >> 1)); pVertex++;
-
-                            *pVertex = std::byte(FinalVertex[i].m_Normal.m_X * (0xff >> 1)); pVertex++;
-                            *pVertex = std::byte(FinalVertex[i].m_Normal.m_Y * (0xff >> 1)); pVertex++;
-                            *pVertex = std::byte(FinalVertex[i].m_Normal.m_Z * (0xff >> 1)); pVertex++;
-
-                            pVertex += Stride;
+                            kernels::QuantizeNorm8<true>( reinterpret_cast<const float*>( BTN[k]->data() ), Quantized.data(), Quantized.size() );
+                            kernels::Scatter( &pVertex[k * 3], Stride, Quantized.data(), 3, 3, nVertices );
                         }
                     }
             
@@ -739,19 +2355,14 @@ namespace xgeom_compiler
                 case xgeom::stream_info::element_def::uv_mask_v:
                 {
                     xassert(StreamInfo.getVectorElementSize() == 4);
-                    std::byte* pVertex = m_FinalGeom.getStreamInfoData(i);
-                    auto       Stride = m_FinalGeom.getStreamInfoStride(i);
+                    std::byte* pVertex = FinalGeom.getStreamInfoData(i);
+                    auto       Stride = FinalGeom.getStreamInfoStride(i);
 
-                    for( auto i = 0u; i < FinalVertex.size(); ++i )
+                    for( int j = 0, k = 0; j < UVDimensionCount; ++j )
                     {
-                        for( int j = 0, k = 0; j < UVDimensionCount; ++j )
-                        {
-                            if (CompilerOption.m_Cleanup.m_bRemoveUVs[j]) continue;
-                            std::memcpy(&pVertex[k*sizeof(xcore::vector2)], &FinalVertex[i].m_UVs[j], sizeof(xcore::vector2));
-                            k++;
-                        }
-
-                        pVertex += Stride;
+                        if (CompilerOption.m_Cleanup.m_bRemoveUVs[j]) continue;
+                        kernels::Scatter( &pVertex[k * sizeof(xcore::vector2)], Stride, FinalVertex.m_UVs[j].data(), sizeof(xcore::vector2), sizeof(xcore::vector2), nVertices );
+                        k++;
                     }
 
                     break;
@@ -763,15 +2374,7 @@ namespace xgeom_compiler
                 case xgeom::stream_info::element_def::color_mask_v:
                 {
                     xassert(StreamInfo.getVectorElementSize() == 1);
-                    std::byte* pVertex = m_FinalGeom.getStreamInfoData(i);
-                    auto       Stride = m_FinalGeom.getStreamInfoStride(i);
-
-                    for( auto i = 0u; i < FinalVertex.size(); ++i )
-                    {
-                        (*(xcore::icolor*)pVertex) = FinalVertex[i].m_Color;
-                        pVertex += Stride;
-                    }
-
+                    kernels::Scatter( FinalGeom.getStreamInfoData(i), FinalGeom.getStreamInfoStride(i), FinalVertex.m_Color.data(), sizeof(xcore::icolor), sizeof(xcore::icolor), nVertices );
                     break;
                 }
 
@@ -780,33 +2383,20 @@ namespace xgeom_compiler
                 //
                 case xgeom::stream_info::element_def::bone_weight_mask_v:
                 {
-                    std::byte* pVertex = m_FinalGeom.getStreamInfoData(i);
-                    auto       Stride = m_FinalGeom.getStreamInfoStride(i);
+                    std::byte*  pVertex = FinalGeom.getStreamInfoData(i);
+                    auto        Stride  = FinalGeom.getStreamInfoStride(i);
+                    const auto  nSlots  = std::tuple_size_v<std::array<float, 4>>;
 
                     if( StreamInfo.getVectorElementSize() == 1 )
                     {
-                        for (auto i = 0u; i < FinalVertex.size(); ++i)
-                        {
-                            for (int j = 0; j < StreamInfo.m_VectorCount; ++j)
-                            {
-                                pVertex[j] = std::byte(FinalVertex[i].m_Weights[j].m_Weight * 0xff);
-                            }
-
-                            pVertex += Stride;
-                        }
+                        std::vector<std::uint8_t> Quantized( nVertices * StreamInfo.m_VectorCount );
+                        kernels::QuantizeWeights8( reinterpret_cast<const float*>( FinalVertex.m_BoneWeight.data() ), nSlots, Quantized.data(), StreamInfo.m_VectorCount, nVertices );
+                        kernels::Scatter( pVertex, Stride, Quantized.data(), StreamInfo.m_VectorCount, StreamInfo.m_VectorCount, nVertices );
                     }
                     else
                     {
                         xassert(StreamInfo.getVectorElementSize() == 4);
-                        for( auto i = 0u; i < FinalVertex.size(); ++i )
-                        {
-                            for (int j = 0; j < StreamInfo.m_VectorCount; ++j)
-                            {
-                                ((float*)pVertex)[j] = FinalVertex[i].m_Weights[j].m_Weight;
-                            }
-
-                            pVertex += Stride;
-                        }
+                        kernels::Scatter( pVertex, Stride, FinalVertex.m_BoneWeight.data(), sizeof(float) * nSlots, sizeof(float) * StreamInfo.m_VectorCount, nVertices );
                     }
 
                     break;
@@ -817,59 +2407,140 @@ namespace xgeom_compiler
                 //
                 case xgeom::stream_info::element_def::bone_index_mask_v:
                 {
-                    std::byte* pVertex = m_FinalGeom.getStreamInfoData(i);
-                    auto       Stride = m_FinalGeom.getStreamInfoStride(i);
+                    std::byte*  pVertex = FinalGeom.getStreamInfoData(i);
+                    auto        Stride  = FinalGeom.getStreamInfoStride(i);
+                    const auto  nSlots  = std::tuple_size_v<std::array<std::int32_t, 4>>;
 
                     if( StreamInfo.getVectorElementSize() == 1 )
                     {
-                        for (auto i = 0u; i < FinalVertex.size(); ++i)
-                        {
-                            for (int j = 0; j < StreamInfo.m_VectorCount; ++j)
-                            {
-                                *pVertex = std::byte(FinalVertex[i].m_Weights[j].m_iBone);
-                            }
-
-                            pVertex += Stride;
-                        }
+                        kernels::NarrowStrided<std::uint8_t>( pVertex, Stride, reinterpret_cast<const std::int32_t*>( FinalVertex.m_BoneIndex.data() ), nSlots, StreamInfo.m_VectorCount, nVertices );
                     }
                     else
                     {
                         xassert(StreamInfo.getVectorElementSize() == 2);
-                        for( auto i = 0u; i < FinalVertex.size(); ++i )
-                        {
-                            for (int j = 0; j < StreamInfo.m_VectorCount; ++j)
-                            {
-                                ((std::uint16_t*)pVertex)[j] = FinalVertex[i].m_Weights[j].m_iBone;
-                            }
-
-                            pVertex += Stride;
-                        }
+                        kernels::NarrowStrided<std::uint16_t>( pVertex, Stride, reinterpret_cast<const std::int32_t*>( FinalVertex.m_BoneIndex.data() ), nSlots, StreamInfo.m_VectorCount, nVertices );
                     }
 
                     break;
                 } 
 
+                //
+                // Material IDs
+                //
+                case xgeom::stream_info::element_def::material_id_mask_v:
+                {
+                    if( StreamInfo.getVectorElementSize() == 1 )
+                    {
+                        kernels::NarrowStrided<std::uint8_t>( FinalGeom.getStreamInfoData(i), FinalGeom.getStreamInfoStride(i), FinalVertex.m_MaterialID.data(), 1, 1, nVertices );
+                    }
+                    else
+                    {
+                        xassert(StreamInfo.getVectorElementSize() == 2);
+                        kernels::Scatter( FinalGeom.getStreamInfoData(i), FinalGeom.getStreamInfoStride(i), FinalVertex.m_MaterialID.data(), sizeof(std::uint16_t), sizeof(std::uint16_t), nVertices );
+                    }
+
+                    break;
+                }
+
                 } // end case
             }// end for loop
 
             auto Transfer = []< typename T >( std::vector<T>& V )
             {
-                auto Own = std::make_unique<T[]>(V.size());
-                for( auto i=0u; i<V.size(); ++i ) Own[i] = V[i];
+                auto Own = std::make_unique_for_overwrite<T[]>(V.size());
+                std::copy( V.begin(), V.end(), Own.get() );
+                V = {};
                 return Own.release();
             };
 
+            //
+            // Tables for the O(1) mesh name and (mesh, material) queries
+            //
+            {
+                std::vector<std::pair<std::uint32_t, std::uint16_t>>    Entries;
+                std::vector<std::uint16_t>                              Lookup;
+                std::unordered_map<std::string, std::uint16_t>          Names;
+
+                for( std::size_t i = 0; i < FinalMeshes.size(); ++i )
+                {
+                    // findMeshIndex returns the first mesh with a given name
+                    if( Names.try_emplace( FinalMeshes[i].m_Name.data(), std::uint16_t(i) ).second )
+                        Entries.emplace_back( xgeom::HashName( FinalMeshes[i].m_Name.data() ), std::uint16_t(i) );
+                }
+                FinalGeom.m_MeshNameTable = BuildLookupTable( Entries, Lookup );
+                if( FinalGeom.m_MeshNameTable.m_nSlots == 0 && FinalMeshes.size() ) printf( "WARNING: Could not build the mesh name table, lookups will be linear\n" );
+
+                Entries.clear();
+                for( std::size_t i = 0; i < FinalMeshes.size(); ++i )
+                {
+                    const auto& LOD        = FinalLod[ FinalMeshes[i].m_iLOD ];
+                    const auto  iMeshFirst = Entries.size();
+                    for( int iSub = LOD.m_iSubmesh; iSub < LOD.m_iSubmesh + LOD.m_nSubmesh; ++iSub )
+                    {
+                        // Keys only repeat inside the same mesh, getSubMeshIndex returns the first one
+                        const auto Key = xgeom::SubmeshKey( int(i), FinalSubmeshes[iSub].m_iMaterial );
+                        if( std::find_if( Entries.begin() + iMeshFirst, Entries.end(), [&]( const auto& E ) { return E.first == Key; } ) == Entries.end() )
+                            Entries.emplace_back( Key, std::uint16_t(iSub) );
+                    }
+                }
+                FinalGeom.m_SubmeshTable = BuildLookupTable( Entries, Lookup );
+                if( FinalGeom.m_SubmeshTable.m_nSlots == 0 && Entries.size() ) printf( "WARNING: Could not build the submesh table, lookups will be linear\n" );
+
+                FinalGeom.m_nLookups = std::uint32_t(Lookup.size());
+                FinalGeom.m_pLookup  = Transfer(Lookup);
+            }
+
             //
             // Set the rest of the pointers
             //
-            m_FinalGeom.m_pLOD      = Transfer(FinalLod);
-            m_FinalGeom.m_pMesh     = Transfer(FinalMeshes);
-            m_FinalGeom.m_pSubMesh  = Transfer(FinalSubmeshes);
-            m_FinalGeom.m_pBone     = nullptr;
-            m_FinalGeom.m_pDList    = nullptr;
+            FinalGeom.m_pLOD      = Transfer(FinalLod);
+            FinalGeom.m_pMesh     = Transfer(FinalMeshes);
+            FinalGeom.m_pSubMesh  = Transfer(FinalSubmeshes);
+            FinalGeom.m_pBone     = nullptr;
+            FinalGeom.m_pDList    = nullptr;
+
+            FinalGeom.m_nBVHs         = std::uint16_t(FinalBVH.size());
+            FinalGeom.m_nBVHNodes     = std::uint32_t(FinalBVHNodes.size());
+            FinalGeom.m_nBVHTriangles = std::uint32_t(FinalBVHTriangles.size());
+            FinalGeom.m_pBVH          = FinalBVH.empty()          ? nullptr : Transfer(FinalBVH);
+            FinalGeom.m_pBVHNode      = FinalBVHNodes.empty()     ? nullptr : Transfer(FinalBVHNodes);
+            FinalGeom.m_pBVHTriangle  = FinalBVHTriangles.empty() ? nullptr : Transfer(FinalBVHTriangles);
+
+            FinalGeom.m_nClusterDAGs  = std::uint16_t(FinalClusterDAGs.size());
+            FinalGeom.m_nClusters     = std::uint32_t(FinalClusters.size());
+            FinalGeom.m_pClusterDAG   = FinalClusterDAGs.empty()  ? nullptr : Transfer(FinalClusterDAGs);
+            FinalGeom.m_pCluster      = FinalClusters.empty()     ? nullptr : Transfer(FinalClusters);
+
+            // Instances are shared by every target
+            auto Instances          = m_Instances;
+            FinalGeom.m_nInstances  = std::uint16_t(Instances.size());
+            FinalGeom.m_pInstance   = Instances.empty() ? nullptr : Transfer(Instances);
+
+            // So are the collision proxies
+            auto CollisionShapes            = m_CollisionShapes;
+            auto CollisionVertices          = m_CollisionVertices;
+            auto CollisionIndices           = m_CollisionIndices;
+            FinalGeom.m_nCollisionShapes    = std::uint16_t(CollisionShapes.size());
+            FinalGeom.m_nCollisionVertices  = std::uint32_t(CollisionVertices.size() / 3);
+            FinalGeom.m_nCollisionIndices   = std::uint32_t(CollisionIndices.size());
+            FinalGeom.m_pCollisionShape     = CollisionShapes.empty()   ? nullptr : Transfer(CollisionShapes);
+            FinalGeom.m_pCollisionVertex    = CollisionVertices.empty() ? nullptr : Transfer(CollisionVertices);
+            FinalGeom.m_pCollisionIndex     = CollisionIndices.empty()  ? nullptr : Transfer(CollisionIndices);
+
+            // And the occluders
+            auto Occluders                  = m_Occluders;
+            auto OccluderVertices           = m_OccluderVertices;
+            auto OccluderIndices            = m_OccluderIndices;
+            FinalGeom.m_nOccluders          = std::uint16_t(Occluders.size());
+            FinalGeom.m_nOccluderVertices   = std::uint32_t(OccluderVertices.size() / 3);
+            FinalGeom.m_nOccluderIndices    = std::uint32_t(OccluderIndices.size());
+            FinalGeom.m_pOccluder           = Occluders.empty()        ? nullptr : Transfer(Occluders);
+            FinalGeom.m_pOccluderVertex     = OccluderVertices.empty() ? nullptr : Transfer(OccluderVertices);
+            FinalGeom.m_pOccluderIndex      = OccluderIndices.empty()  ? nullptr : Transfer(OccluderIndices);
         }
 
-        virtual void Compile( const xgeom_compiler::descriptor& CompilerOption ) override
+        // Everything that does not depend on the target layout (import cleanup, LODs, cache optimization)
+        void CompileSharedFrontHalf( const xgeom_compiler::descriptor& CompilerOption )
         {
             if (CompilerOption.m_Cleanup.m_bForceAddColorIfNone) m_RawGeom.ForceAddColorIfNone();
             if (CompilerOption.m_Cleanup.m_bMergeMeshes) m_RawGeom.CollapseMeshes(CompilerOption.m_Cleanup.m_RenameMesh.c_str());
@@ -880,29 +2551,199 @@ namespace xgeom_compiler
             // Convert to mesh
             //
             m_FinalGeom.Reset();
+            m_CompilerMesh.clear();
+            m_Instances.clear();
+            m_CollisionShapes.clear();
+            m_CollisionVertices.clear();
+            m_CollisionIndices.clear();
+            m_Occluders.clear();
+            m_OccluderVertices.clear();
+            m_OccluderIndices.clear();
             ConvertToCompilerMesh(CompilerOption);
+            if( m_bLeanMemory ) m_RawGeom = {};
+            if( CompilerOption.m_Cleanup.m_bDeduplicateMeshes ) DeduplicateMeshes();
+            GenerateCollision(CompilerOption);
+            GenerateOccluders(CompilerOption);
             GenenateLODs(CompilerOption);
+            GenerateClusterLODs(CompilerOption);
             optimizeFacesAndVerts(CompilerOption);
-            GenerateFinalMesh(CompilerOption);
         }
 
-        virtual void Serialize(const std::string_view FilePath) override
+        virtual void Compile( const xgeom_compiler::descriptor& CompilerOption ) override
+        {
+            CompileSharedFrontHalf(CompilerOption);
+            GenerateFinalMesh(CompilerOption, CompilerOption.m_Streams, m_FinalGeom, m_bLeanMemory);
+            if( m_bLeanMemory ) m_CompilerMesh = {};
+        }
+
+        virtual void CompileTargets( const xgeom_compiler::descriptor& CompilerOption, std::span<const target_output> Targets ) override
+        {
+            CompileSharedFrontHalf(CompilerOption);
+
+            // A single target is the only reader of the compiler meshes, in lean mode it can consume them
+            const bool bConsume = m_bLeanMemory && Targets.size() == 1;
+
+            //
+            // Only the stream packing changes per target, run those (and their file writes) in parallel
+            //
+            auto CompileTarget = [&]( const target_output& Target )
+            {
+                xgeom FinalGeom;
+                FinalGeom.Initialize();
+
+                try
+                {
+                    GenerateFinalMesh( CompilerOption, Target.m_pStreams ? *Target.m_pStreams : CompilerOption.m_Streams, FinalGeom, bConsume );
+                    WriteGeom( FinalGeom, Target.m_FilePath );
+                }
+                catch(...)
+                {
+                    FinalGeom.Kill();
+                    throw;
+                }
+
+                FinalGeom.Kill();
+            };
+
+            std::vector<std::future<void>> Jobs;
+            for( std::size_t i = 1; i < Targets.size(); ++i )
+                Jobs.push_back( std::async( std::launch::async, CompileTarget, std::cref(Targets[i]) ) );
+
+            if( Targets.empty() == false ) CompileTarget( Targets[0] );
+
+            for( auto& J : Jobs ) J.get();
+
+            if( m_bLeanMemory ) m_CompilerMesh = {};
+        }
+
+        static bool SyncFile( std::FILE* pFile, write_options::fsync_policy Policy ) noexcept
+        {
+            if( Policy == write_options::fsync_policy::NONE ) return true;
+            if( std::fflush(pFile) ) return false;
+
+        #if defined(_WIN32)
+            return _commit( _fileno(pFile) ) == 0;
+        #else
+            return ( Policy == write_options::fsync_policy::DATA ? fdatasync( fileno(pFile) ) : fsync( fileno(pFile) ) ) == 0;
+        #endif
+        }
+
+        static void SerializeGeom( const xgeom& FinalGeom, const std::string_view FilePath, write_options::fsync_policy Policy )
         {
             xcore::serializer::stream Stream;
-            if( auto Err = Stream.Save( xcore::string::To<wchar_t>(FilePath), m_FinalGeom, {}, false ); Err )
+            if( auto Err = Stream.Save( xcore::string::To<wchar_t>(FilePath), FinalGeom, {}, false ); Err )
                 throw(std::runtime_error( xcore::string::Fmt("Failed to serialize geometry (%s)", Err.getCode().m_pString).data() ));
+
+            if( Policy == write_options::fsync_policy::NONE ) return;
+
+            std::FILE* pFile = std::fopen( std::string(FilePath).c_str(), "r+b" );
+            const bool bOk   = pFile && SyncFile( pFile, Policy );
+            if( pFile ) std::fclose( pFile );
+            if( !bOk ) throw(std::runtime_error( xcore::string::Fmt("Failed to flush (%s) to disk", std::string(FilePath).c_str()).data() ));
+        }
+
+        // The image is handed over to the writer so the caller can carry on with the next target
+        static void WriteImageFile( const std::vector<std::byte>& Image, const std::string& FilePath, write_options::fsync_policy Policy )
+        {
+            std::FILE* pFile = std::fopen( FilePath.c_str(), "wb" );
+            if( pFile == nullptr ) throw(std::runtime_error( xcore::string::Fmt("Failed to open (%s) for writing", FilePath.c_str()).data() ));
+
+            // Unbuffered, the whole image goes out in a single write straight from our buffer
+            std::setvbuf( pFile, nullptr, _IONBF, 0 );
+
+            bool bOk = std::fwrite( Image.data(), 1, Image.size(), pFile ) == Image.size();
+            bOk      = bOk && SyncFile( pFile, Policy );
+            bOk      = ( std::fclose(pFile) == 0 ) && bOk;
+
+            if( !bOk ) throw(std::runtime_error( xcore::string::Fmt("Failed to write geometry (%s)", FilePath.c_str()).data() ));
+        }
+
+        void WriteGeom( const xgeom& FinalGeom, const std::string_view FilePath )
+        {
+            if( m_WriteOptions.m_Format == write_options::format::SERIALIZER )
+            {
+                SerializeGeom( FinalGeom, FilePath, m_WriteOptions.m_Fsync );
+                return;
+            }
+
+            std::vector<std::byte> Image( FinalGeom.getImageSize() );
+            FinalGeom.WriteImage( Image.data() );
+
+            std::scoped_lock Lk( m_PendingWritesLock );
+            m_PendingWrites.push_back( std::async( std::launch::async, WriteImageFile, std::move(Image), std::string(FilePath), m_WriteOptions.m_Fsync ) );
+        }
+
+        virtual void Serialize(const std::string_view FilePath) override
+        {
+            WriteGeom( m_FinalGeom, FilePath );
+        }
+
+        virtual void SetLeanMemory( bool bLean ) override
+        {
+            m_bLeanMemory = bLean;
+        }
+
+        virtual void SetMaxThreads( std::size_t nThreads ) override
+        {
+            m_MaxThreads = nThreads ? nThreads : default_max_threads_v;
+        }
+
+        virtual void SetSortKeyLayout( const xgeom::sort_key_layout& Layout ) override
+        {
+            m_SortKeyLayout = Layout;
+        }
+
+        virtual void SetWriteOptions( const write_options& Options ) override
+        {
+            m_WriteOptions = Options;
+        }
+
+        virtual void Flush( void ) override
+        {
+            std::vector<std::future<void>> Writes;
+            {
+                std::scoped_lock Lk( m_PendingWritesLock );
+                Writes = std::move(m_PendingWrites);
+                m_PendingWrites.clear();
+            }
+
+            // Wait for all of them before reporting the first error
+            std::exception_ptr Error;
+            for( auto& W : Writes )
+            {
+                try         { W.get(); }
+                catch(...)  { if( !Error ) Error = std::current_exception(); }
+            }
+
+            if( Error ) std::rethrow_exception( Error );
+        }
+
+        virtual ~implementation( void ) override
+        {
+            try { Flush(); } catch( const std::exception& Error ) { printf( "ERROR: %s\n", Error.what() ); }
         }
 
-        meshopt_VertexCacheStatistics   m_VertCacheAMDStats;
-        meshopt_VertexCacheStatistics   m_VertCacheNVidiaStats;
-        meshopt_VertexCacheStatistics   m_VertCacheIntelStats;
-        meshopt_VertexCacheStatistics   m_VertCacheStats;
-        meshopt_VertexFetchStatistics   m_VertFetchStats;
-        meshopt_OverdrawStatistics      m_OverdrawStats;
         xgeom                           m_FinalGeom;
         std::vector<mesh>               m_CompilerMesh;
-        xraw3d::anim                    m_RawAnim;
+        std::vector<xgeom::instance>    m_Instances;
+        std::vector<xgeom::collision_shape> m_CollisionShapes;
+        std::vector<float>              m_CollisionVertices;            // xyz
+        std::vector<std::uint32_t>      m_CollisionIndices;
+        std::vector<xgeom::occluder>    m_Occluders;
+        std::vector<float>              m_OccluderVertices;             // xyz
+        std::vector<std::uint16_t>      m_OccluderIndices;
         xraw3d::geom                    m_RawGeom;
+        std::list<raw_cache_entry>      m_RawCache;
+        std::size_t                     m_RawCacheMaxEntries { 0 };
+        std::unordered_map<std::string, skeleton_cache_entry> m_SkeletonCache;
+        std::size_t                     m_nRawBones          { 0 };
+        std::size_t                     m_nRawMaterials      { 0 };
+        bool                            m_bLeanMemory        { false };
+        std::size_t                     m_MaxThreads         { default_max_threads_v };
+        xgeom::sort_key_layout          m_SortKeyLayout      { xgeom::default_sort_key_layout_v };
+        write_options                   m_WriteOptions       {};
+        std::mutex                      m_PendingWritesLock;
+        std::vector<std::future<void>>  m_PendingWrites;
     };
 
     //------------------------------------------------------------------------------------
@@ -0,0 +1,247 @@
+#ifndef XGEOM_COMPILER_KERNELS_H
+#define XGEOM_COMPILER_KERNELS_H
+#pragma once
+
+//
+// Bulk kernels used to turn the intermediate (structure of arrays) vertex data into the final streams.
+// The instruction set is chosen at compile time: AVX2 when the compiler targets it (/arch:AVX2, -mavx2),
+// SSE2 on any x64 build, otherwise plain C++. All the versions give the same results.
+//
+#if defined(__AVX2__)
+    #define XGEOM_COMPILER_KERNELS_AVX2
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define XGEOM_COMPILER_KERNELS_SSE2
+    #include <emmintrin.h>
+#endif
+
+namespace xgeom_compiler::kernels
+{
+    //------------------------------------------------------------------------------------
+    // Min/Max of a tightly packed array of vector3d. Keeps one accumulator per register and
+    // only sorts the lanes back into x,y,z at the end, so the loop has no shuffles.
+
+    inline void ComputeBBox( std::span<const xcore::vector3d> Positions, xcore::vector3d& Min, xcore::vector3d& Max ) noexcept
+    {
+        static_assert( sizeof(xcore::vector3d) == 3 * sizeof(float) );
+
+        const float*        pSrc    = reinterpret_cast<const float*>( Positions.data() );
+        const std::size_t   nFloats = Positions.size() * 3;
+        std::size_t         i       = 0;
+        std::array<float,3> Lo      { Min.m_X, Min.m_Y, Min.m_Z };
+        std::array<float,3> Hi      { Max.m_X, Max.m_Y, Max.m_Z };
+
+    #if defined(XGEOM_COMPILER_KERNELS_AVX2) || defined(XGEOM_COMPILER_KERNELS_SSE2)
+        #if defined(XGEOM_COMPILER_KERNELS_AVX2)
+            using           reg        = __m256;
+            constexpr auto  lanes_v    = 8;
+            auto            Load       = []( const float* p ) { return _mm256_loadu_ps(p); };
+            auto            Store      = []( float* p, reg R ) { _mm256_storeu_ps( p, R ); };
+            auto            RegMin     = []( reg A, reg B ) { return _mm256_min_ps( A, B ); };
+            auto            RegMax     = []( reg A, reg B ) { return _mm256_max_ps( A, B ); };
+        #else
+            using           reg        = __m128;
+            constexpr auto  lanes_v    = 4;
+            auto            Load       = []( const float* p ) { return _mm_loadu_ps(p); };
+            auto            Store      = []( float* p, reg R ) { _mm_storeu_ps( p, R ); };
+            auto            RegMin     = []( reg A, reg B ) { return _mm_min_ps( A, B ); };
+            auto            RegMax     = []( reg A, reg B ) { return _mm_max_ps( A, B ); };
+        #endif
+
+        // 3 registers hold a whole number of vertices
+        constexpr auto block_v = 3 * lanes_v;
+        if( nFloats >= block_v )
+        {
+            reg RMin[3] = { Load(pSrc), Load(pSrc + lanes_v), Load(pSrc + 2 * lanes_v) };
+            reg RMax[3] = { RMin[0], RMin[1], RMin[2] };
+
+            for( i = block_v; i + block_v <= nFloats; i += block_v )
+            {
+                for( int r = 0; r < 3; ++r )
+                {
+                    const auto V = Load( pSrc + i + r * lanes_v );
+                    RMin[r] = RegMin( RMin[r], V );
+                    RMax[r] = RegMax( RMax[r], V );
+                }
+            }
+
+            std::array<float, block_v> FMin, FMax;
+            for( int r = 0; r < 3; ++r )
+            {
+                Store( &FMin[r * lanes_v], RMin[r] );
+                Store( &FMax[r * lanes_v], RMax[r] );
+            }
+
+            for( int k = 0; k < block_v; ++k )
+            {
+                Lo[k % 3] = std::min( Lo[k % 3], FMin[k] );
+                Hi[k % 3] = std::max( Hi[k % 3], FMax[k] );
+            }
+        }
+    #endif
+
+        for( ; i < nFloats; ++i )
+        {
+            Lo[i % 3] = std::min( Lo[i % 3], pSrc[i] );
+            Hi[i % 3] = std::max( Hi[i % 3], pSrc[i] );
+        }
+
+        Min = xcore::vector3d{ Lo[0], Lo[1], Lo[2] };
+        Max = xcore::vector3d{ Hi[0], Hi[1], Hi[2] };
+    }
+
+    //------------------------------------------------------------------------------------
+    // Float to 8 bits. Truncates toward zero (same as a C cast) and saturates.
+    //      SNorm8: [-1,1] -> [-127,127]
+    //      UNorm8: [ 0,1] -> [   0,255]
+
+    template< bool T_SIGNED_V >
+    inline void QuantizeNorm8( const float* pSrc, std::uint8_t* pDst, std::size_t Count ) noexcept
+    {
+        constexpr float scale_v = T_SIGNED_V ? float(0xff >> 1) : float(0xff);
+        std::size_t     i       = 0;
+
+    #if defined(XGEOM_COMPILER_KERNELS_AVX2)
+        const auto Scale  = _mm256_set1_ps( scale_v );
+        const auto Unzip  = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+        for( ; i + 32 <= Count; i += 32 )
+        {
+            const auto A  = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_loadu_ps( pSrc + i +  0 ), Scale ) );
+            const auto B  = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_loadu_ps( pSrc + i +  8 ), Scale ) );
+            const auto C  = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_loadu_ps( pSrc + i + 16 ), Scale ) );
+            const auto D  = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_loadu_ps( pSrc + i + 24 ), Scale ) );
+            const auto AB = _mm256_packs_epi32( A, B );
+            const auto CD = _mm256_packs_epi32( C, D );
+            const auto R  = T_SIGNED_V ? _mm256_packs_epi16( AB, CD ) : _mm256_packus_epi16( AB, CD );
+
+            // The packs work per 128 bit lane, put the 4 byte groups back in order
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst + i), _mm256_permutevar8x32_epi32( R, Unzip ) );
+        }
+    #elif defined(XGEOM_COMPILER_KERNELS_SSE2)
+        const auto Scale = _mm_set1_ps( scale_v );
+        for( ; i + 16 <= Count; i += 16 )
+        {
+            const auto A  = _mm_cvttps_epi32( _mm_mul_ps( _mm_loadu_ps( pSrc + i +  0 ), Scale ) );
+            const auto B  = _mm_cvttps_epi32( _mm_mul_ps( _mm_loadu_ps( pSrc + i +  4 ), Scale ) );
+            const auto C  = _mm_cvttps_epi32( _mm_mul_ps( _mm_loadu_ps( pSrc + i +  8 ), Scale ) );
+            const auto D  = _mm_cvttps_epi32( _mm_mul_ps( _mm_loadu_ps( pSrc + i + 12 ), Scale ) );
+            const auto AB = _mm_packs_epi32( A, B );
+            const auto CD = _mm_packs_epi32( C, D );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst + i), T_SIGNED_V ? _mm_packs_epi16( AB, CD ) : _mm_packus_epi16( AB, CD ) );
+        }
+    #endif
+
+        for( ; i < Count; ++i )
+        {
+            const auto V = std::clamp( static_cast<int>( pSrc[i] * scale_v ), T_SIGNED_V ? -128 : 0, T_SIGNED_V ? 127 : 255 );
+            pDst[i] = static_cast<std::uint8_t>(V);
+        }
+    }
+
+    //------------------------------------------------------------------------------------
+    // 32 bit indices to 16 bits, the caller guarantees they all fit
+
+    inline void NarrowIndices( const std::uint32_t* pSrc, std::uint16_t* pDst, std::size_t Count ) noexcept
+    {
+        std::size_t i = 0;
+
+    #if defined(XGEOM_COMPILER_KERNELS_AVX2)
+        for( ; i + 16 <= Count; i += 16 )
+        {
+            const auto A = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc + i + 0) );
+            const auto B = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc + i + 8) );
+            const auto R = _mm256_permute4x64_epi64( _mm256_packus_epi32( A, B ), 0b11'01'10'00 );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst + i), R );
+        }
+    #elif defined(XGEOM_COMPILER_KERNELS_SSE2)
+        // SSE2 only has the signed pack, bias the values into the signed range and back
+        const auto Bias32 = _mm_set1_epi32( 0x8000 );
+        const auto Bias16 = _mm_set1_epi16( std::int16_t(-0x8000) );
+        for( ; i + 8 <= Count; i += 8 )
+        {
+            const auto A = _mm_sub_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>(pSrc + i + 0) ), Bias32 );
+            const auto B = _mm_sub_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>(pSrc + i + 4) ), Bias32 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst + i), _mm_xor_si128( _mm_packs_epi32( A, B ), Bias16 ) );
+        }
+    #endif
+
+        for( ; i < Count; ++i ) pDst[i] = static_cast<std::uint16_t>(pSrc[i]);
+    }
+
+    //------------------------------------------------------------------------------------
+    // Copies Count elements of ElementSize bytes from a packed (or strided) source into an
+    // interleaved stream. The common element sizes get a fixed size copy the compiler turns
+    // into plain moves instead of a memcpy call per vertex.
+
+    template< std::size_t T_SIZE_V >
+    inline void ScatterFixed( std::byte* pDst, std::size_t DstStride, const std::byte* pSrc, std::size_t SrcStride, std::size_t Count ) noexcept
+    {
+        for( std::size_t i = 0; i < Count; ++i, pDst += DstStride, pSrc += SrcStride )
+            std::memcpy( pDst, pSrc, T_SIZE_V );
+    }
+
+    inline void Scatter( std::byte* pDst, std::size_t DstStride, const void* pSrcData, std::size_t SrcStride, std::size_t ElementSize, std::size_t Count ) noexcept
+    {
+        auto pSrc = static_cast<const std::byte*>(pSrcData);
+
+        // Separated streams are just a copy
+        if( DstStride == ElementSize && SrcStride == ElementSize )
+        {
+            std::memcpy( pDst, pSrc, ElementSize * Count );
+            return;
+        }
+
+        switch( ElementSize )
+        {
+        case 1:  ScatterFixed<1> ( pDst, DstStride, pSrc, SrcStride, Count ); break;
+        case 2:  ScatterFixed<2> ( pDst, DstStride, pSrc, SrcStride, Count ); break;
+        case 3:  ScatterFixed<3> ( pDst, DstStride, pSrc, SrcStride, Count ); break;
+        case 4:  ScatterFixed<4> ( pDst, DstStride, pSrc, SrcStride, Count ); break;
+        case 8:  ScatterFixed<8> ( pDst, DstStride, pSrc, SrcStride, Count ); break;
+        case 12: ScatterFixed<12>( pDst, DstStride, pSrc, SrcStride, Count ); break;
+        case 16: ScatterFixed<16>( pDst, DstStride, pSrc, SrcStride, Count ); break;
+        default:
+            for( std::size_t i = 0; i < Count; ++i, pDst += DstStride, pSrc += SrcStride )
+                std::memcpy( pDst, pSrc, ElementSize );
+        }
+    }
+
+    //------------------------------------------------------------------------------------
+    // Skin weights to UNorm8. Rounds the running sum instead of each weight so the rounding error
+    // carries to the next influence and the bytes of a vertex add up to exactly 255 (when the
+    // weights add up to one). Count vectors of Dimensions values each.
+
+    inline void QuantizeWeights8( const float* pSrc, std::size_t SrcDimensions, std::uint8_t* pDst, std::size_t Dimensions, std::size_t Count ) noexcept
+    {
+        for( std::size_t i = 0; i < Count; ++i, pSrc += SrcDimensions, pDst += Dimensions )
+        {
+            float Sum    = 0;
+            int   Before = 0;
+            for( std::size_t j = 0; j < Dimensions; ++j )
+            {
+                Sum += pSrc[j];
+                const auto After = std::clamp( static_cast<int>( Sum * 255.0f + 0.5f ), Before, 255 );
+                pDst[j] = static_cast<std::uint8_t>( After - Before );
+                Before  = After;
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------------
+    // Strided integer narrowing (bone indices), Count vectors of Dimensions values each
+
+    template< typename T_DST, typename T_SRC >
+    inline void NarrowStrided( std::byte* pDst, std::size_t DstStride, const T_SRC* pSrc, std::size_t SrcDimensions, std::size_t Dimensions, std::size_t Count ) noexcept
+    {
+        for( std::size_t i = 0; i < Count; ++i, pDst += DstStride, pSrc += SrcDimensions )
+        {
+            for( std::size_t j = 0; j < Dimensions; ++j )
+            {
+                const auto V = static_cast<T_DST>(pSrc[j]);
+                std::memcpy( pDst + j * sizeof(T_DST), &V, sizeof(T_DST) );
+            }
+        }
+    }
+}
+
+#endif
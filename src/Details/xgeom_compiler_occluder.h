@@ -0,0 +1,206 @@
+#ifndef XGEOM_COMPILER_OCCLUDER_H
+#define XGEOM_COMPILER_OCCLUDER_H
+#pragma once
+
+//
+// Boxes fitted inside a closed mesh (xgeom::occluder). The mesh is voxelized solid by casting one ray per
+// column and filling between crossings, the inside is eroded by a voxel so the boxes stay clear of the
+// surface, and then boxes are grown greedily from the biggest free cube left.
+//
+namespace xgeom_compiler::occluder
+{
+    using vec3 = std::array<float, 3>;
+
+    struct box
+    {
+        vec3                    m_Min;
+        vec3                    m_Max;
+    };
+
+    //------------------------------------------------------------------------------------
+    // Every edge is used once in each direction, so the triangles enclose something
+
+    inline bool isClosed( std::span<const std::uint32_t> Indices )
+    {
+        std::unordered_map<std::uint64_t, int> Edges;
+        Edges.reserve( Indices.size() );
+
+        auto Key = []( std::uint32_t A, std::uint32_t B ) { return (std::uint64_t(A) << 32) | B; };
+        for( std::size_t t = 0; t + 2 < Indices.size(); t += 3 )
+        {
+            for( int e = 0; e < 3; ++e )
+            {
+                const auto A = Indices[t + e], B = Indices[t + (e + 1) % 3];
+                if( A == B ) continue;
+                if( ++Edges[ Key( A, B ) ] > 1 ) return false;
+            }
+        }
+
+        for( const auto& [K, Count] : Edges )
+        {
+            const auto It = Edges.find( Key( std::uint32_t(K), std::uint32_t(K >> 32) ) );
+            if( It == Edges.end() || It->second != 1 ) return false;
+        }
+
+        return Edges.empty() == false;
+    }
+
+    //------------------------------------------------------------------------------------
+    // Boxes inside the closed mesh, FillRatio returns how much of the mesh bounds they cover
+
+    inline std::vector<box> FitInnerBoxes( std::span<const vec3> Points, std::span<const std::uint32_t> Indices, int Resolution, int MaxBoxes, float& FillRatio )
+    {
+        FillRatio = 0;
+        if( Points.empty() || Indices.size() < 3 ) return {};
+
+        vec3 Min = Points[0], Max = Points[0];
+        for( const auto& P : Points ) for( int a = 0; a < 3; ++a ) { Min[a] = std::min( Min[a], P[a] ); Max[a] = std::max( Max[a], P[a] ); }
+
+        const float Longest = std::max( { Max[0] - Min[0], Max[1] - Min[1], Max[2] - Min[2] } );
+        if( Longest <= 0 ) return {};
+
+        Resolution = std::clamp( Resolution, 4, 256 );
+        const float             VoxelSize = Longest / Resolution;
+        std::array<int, 3>      N;
+        for( int a = 0; a < 3; ++a ) N[a] = std::clamp( int( std::ceil( (Max[a] - Min[a]) / VoxelSize ) ), 1, Resolution );
+
+        auto Index = [&]( int X, int Y, int Z ) { return (std::size_t(Z) * N[1] + Y) * N[0] + X; };
+        std::vector<std::uint8_t> Solid( std::size_t(N[0]) * N[1] * N[2], 0 );
+
+        //
+        // Crossings of every column along Z, the columns are offset a little so they do not run along edges
+        //
+        constexpr float         jitter_v = 0.0137f;
+        std::vector<std::vector<float>> Crossings( std::size_t(N[0]) * N[1] );
+        for( std::size_t t = 0; t + 2 < Indices.size(); t += 3 )
+        {
+            const auto& A = Points[Indices[t]];
+            const auto& B = Points[Indices[t + 1]];
+            const auto& C = Points[Indices[t + 2]];
+
+            const float Area = (B[0] - A[0]) * (C[1] - A[1]) - (B[1] - A[1]) * (C[0] - A[0]);
+            if( Area == 0 ) continue;
+
+            const int X0 = std::max( 0,        int( std::floor( (std::min( { A[0], B[0], C[0] } ) - Min[0]) / VoxelSize - 0.5f - jitter_v ) ) );
+            const int X1 = std::min( N[0] - 1, int( std::ceil ( (std::max( { A[0], B[0], C[0] } ) - Min[0]) / VoxelSize - 0.5f - jitter_v ) ) );
+            const int Y0 = std::max( 0,        int( std::floor( (std::min( { A[1], B[1], C[1] } ) - Min[1]) / VoxelSize - 0.5f - jitter_v ) ) );
+            const int Y1 = std::min( N[1] - 1, int( std::ceil ( (std::max( { A[1], B[1], C[1] } ) - Min[1]) / VoxelSize - 0.5f - jitter_v ) ) );
+
+            for( int Y = Y0; Y <= Y1; ++Y ) for( int X = X0; X <= X1; ++X )
+            {
+                const float PX = Min[0] + (X + 0.5f + jitter_v) * VoxelSize;
+                const float PY = Min[1] + (Y + 0.5f + jitter_v) * VoxelSize;
+
+                // Barycentrics in the XY projection
+                const float U = ( (B[0] - PX) * (C[1] - PY) - (B[1] - PY) * (C[0] - PX) ) / Area;
+                const float V = ( (C[0] - PX) * (A[1] - PY) - (C[1] - PY) * (A[0] - PX) ) / Area;
+                const float W = 1.0f - U - V;
+                if( U < 0 || V < 0 || W < 0 ) continue;
+
+                Crossings[ std::size_t(Y) * N[0] + X ].push_back( U * A[2] + V * B[2] + W * C[2] );
+            }
+        }
+
+        for( int Y = 0; Y < N[1]; ++Y ) for( int X = 0; X < N[0]; ++X )
+        {
+            auto& Z = Crossings[ std::size_t(Y) * N[0] + X ];
+            std::sort( Z.begin(), Z.end() );
+
+            // An odd count means the column grazed something, the last crossing is left out
+            for( std::size_t i = 0; i + 1 < Z.size(); i += 2 )
+            {
+                for( int k = 0; k < N[2]; ++k )
+                {
+                    const float PZ = Min[2] + (k + 0.5f) * VoxelSize;
+                    if( PZ >= Z[i] && PZ <= Z[i + 1] ) Solid[ Index( X, Y, k ) ] = 1;
+                }
+            }
+        }
+
+        //
+        // Erode, a voxel stays when its whole 3x3x3 neighborhood is solid
+        //
+        std::vector<std::uint8_t> Inside( Solid.size(), 0 );
+        for( int Z = 1; Z < N[2] - 1; ++Z ) for( int Y = 1; Y < N[1] - 1; ++Y ) for( int X = 1; X < N[0] - 1; ++X )
+        {
+            bool bKeep = true;
+            for( int dz = -1; bKeep && dz <= 1; ++dz ) for( int dy = -1; bKeep && dy <= 1; ++dy ) for( int dx = -1; bKeep && dx <= 1; ++dx )
+                bKeep = Solid[ Index( X + dx, Y + dy, Z + dz ) ] != 0;
+            Inside[ Index( X, Y, Z ) ] = bKeep;
+        }
+
+        //
+        // Greedy boxes, seeded at the biggest cube of inside voxels no box covers yet
+        //
+        std::vector<std::uint8_t>   Covered( Solid.size(), 0 );
+        std::vector<std::uint16_t>  Cube( Solid.size() );
+        std::vector<box>            Boxes;
+        std::size_t                 nCovered = 0;
+
+        auto isInside = [&]( std::array<int, 3> Lo, std::array<int, 3> Hi )
+        {
+            for( int a = 0; a < 3; ++a ) if( Lo[a] < 0 || Hi[a] >= N[a] ) return false;
+            for( int Z = Lo[2]; Z <= Hi[2]; ++Z ) for( int Y = Lo[1]; Y <= Hi[1]; ++Y ) for( int X = Lo[0]; X <= Hi[0]; ++X )
+                if( Inside[ Index( X, Y, Z ) ] == 0 ) return false;
+            return true;
+        };
+
+        while( int(Boxes.size()) < std::max( 1, MaxBoxes ) )
+        {
+            int                 BestSize = 0;
+            std::array<int, 3>  BestEnd{};
+            for( int Z = 0; Z < N[2]; ++Z ) for( int Y = 0; Y < N[1]; ++Y ) for( int X = 0; X < N[0]; ++X )
+            {
+                const auto i = Index( X, Y, Z );
+                if( Inside[i] == 0 || Covered[i] ) { Cube[i] = 0; continue; }
+
+                int Smallest = 0;
+                if( X && Y && Z )
+                {
+                    Smallest = std::min( { Cube[Index( X-1, Y, Z )], Cube[Index( X, Y-1, Z )], Cube[Index( X, Y, Z-1 )], Cube[Index( X-1, Y-1, Z )]
+                                         , Cube[Index( X-1, Y, Z-1 )], Cube[Index( X, Y-1, Z-1 )], Cube[Index( X-1, Y-1, Z-1 )] } );
+                }
+                Cube[i] = std::uint16_t( Smallest + 1 );
+                if( Cube[i] > BestSize ) { BestSize = Cube[i]; BestEnd = { X, Y, Z }; }
+            }
+
+            // Single voxels are only worth it when there is nothing else
+            if( BestSize == 0 || (BestSize < 2 && Boxes.empty() == false) ) break;
+
+            std::array<int, 3> Lo{ BestEnd[0] - BestSize + 1, BestEnd[1] - BestSize + 1, BestEnd[2] - BestSize + 1 }, Hi = BestEnd;
+            for( bool bGrew = true; bGrew; )
+            {
+                bGrew = false;
+                for( int a = 0; a < 3; ++a )
+                {
+                    auto L = Lo, H = Hi;
+                    L[a] = H[a] = Lo[a] - 1;
+                    if( isInside( L, H ) ) { Lo[a]--; bGrew = true; }
+
+                    L = Lo; H = Hi;
+                    L[a] = H[a] = Hi[a] + 1;
+                    if( isInside( L, H ) ) { Hi[a]++; bGrew = true; }
+                }
+            }
+
+            for( int Z = Lo[2]; Z <= Hi[2]; ++Z ) for( int Y = Lo[1]; Y <= Hi[1]; ++Y ) for( int X = Lo[0]; X <= Hi[0]; ++X )
+            {
+                auto& C = Covered[ Index( X, Y, Z ) ];
+                nCovered += C == 0;
+                C = 1;
+            }
+
+            box& B = Boxes.emplace_back();
+            for( int a = 0; a < 3; ++a )
+            {
+                B.m_Min[a] = Min[a] + Lo[a] * VoxelSize;
+                B.m_Max[a] = Min[a] + (Hi[a] + 1) * VoxelSize;
+            }
+        }
+
+        FillRatio = float(nCovered) / float( Solid.size() );
+        return Boxes;
+    }
+}
+
+#endif
@@ -0,0 +1,2 @@
+#include "xanim_compiler.h"
+#include "Details/xanim_compiler_instance.cpp"
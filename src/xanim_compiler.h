@@ -0,0 +1,16 @@
+#ifndef XANIM_COMPILER_H
+#define XANIM_COMPILER_H
+#pragma once
+
+#include "xresource_pipeline.h"
+#include "../src_runtime/xanim.h"
+
+namespace xanim_compiler
+{
+    using string = xcore::string::ref<char>;
+}
+
+#include "xanim_compiler_descriptor.h"
+#include "xanim_compiler_instance.h"
+
+#endif
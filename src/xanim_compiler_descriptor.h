@@ -0,0 +1,70 @@
+namespace xanim_compiler
+{
+    constexpr int version_major_v    = 1;
+    constexpr int version_minor_v    = 0;
+
+    struct descriptor : xresource_pipeline::descriptor::base
+    {
+        using parent = xresource_pipeline::descriptor::base;
+
+        struct main
+        {
+            string                  m_AnimAsset             {};                             // File name of the animation to load
+        };
+
+        // How far a removed key may be from what the remaining keys interpolate to
+        struct compression
+        {
+            float                   m_RotationTolerance     = 0.0005f;                      // Radians
+            float                   m_TranslationTolerance  = 0.0001f;                      // World units
+            float                   m_ScaleTolerance        = 0.0001f;
+        };
+
+        descriptor() : xresource_pipeline::descriptor::base
+        { .m_Version
+            { .m_Major = version_major_v
+            , .m_Minor = version_minor_v
+            }
+        }
+        {}
+
+        inline
+        static xcore::err Serialize(descriptor& Options, std::string_view FilePath, bool isRead) noexcept;
+
+        main                        m_Main;
+        compression                 m_Compression;
+    };
+
+    //-------------------------------------------------------------------------------------------------------
+
+    xcore::err descriptor::Serialize( descriptor& Options, std::string_view FilePath, bool isRead ) noexcept
+    {
+        xcore::textfile::stream Stream;
+        xcore::err              Error;
+
+        // Open file
+        if( auto Err = Stream.Open(isRead, FilePath, xcore::textfile::file_type::TEXT ); Err )
+            return Err;
+
+        if( auto Err = Options.parent::Serialize( Stream, isRead ); Err )
+            return Err;
+
+        if (Stream.Record(Error, "MainOptions"
+            , [&](std::size_t, xcore::err& Err)
+            {
+                Err = Stream.Field("AnimAsset",                 Options.m_Main.m_AnimAsset);
+            })) return Error;
+
+        if (Stream.Record(Error, "CompressionOptions"
+            , [&](std::size_t, xcore::err& Err)
+            {
+                0
+                || (Err = Stream.Field("RotationTolerance",     Options.m_Compression.m_RotationTolerance))
+                || (Err = Stream.Field("TranslationTolerance",  Options.m_Compression.m_TranslationTolerance))
+                || (Err = Stream.Field("ScaleTolerance",        Options.m_Compression.m_ScaleTolerance))
+                ;
+            })) return Error;
+
+        return {};
+    }
+}
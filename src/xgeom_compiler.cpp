@@ -1,4 +1,6 @@
 
 #include "xgeom_compiler.h"
 #include "Details/xgeom_compiler_instance.cpp"
+#include "Details/xgeom_compiler_daemon.cpp"
+#include "Details/xgeom_compiler_distributed.cpp"
 
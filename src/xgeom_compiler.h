@@ -3,6 +3,7 @@
 #pragma once
 
 #include "xresource_pipeline.h"
+#include "../src_runtime/xgeom.h"
 
 namespace xgeom_compiler
 {
@@ -11,5 +12,7 @@ namespace xgeom_compiler
 
 #include "xgeom_compiler_descriptor.h"
 #include "xgeom_compiler_instance.h"
+#include "xgeom_compiler_daemon.h"
+#include "xgeom_compiler_distributed.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+namespace xgeom_compiler::daemon
+{
+    //
+    // Long running compiler process. Jobs are the same command line arguments the resource pipeline
+    // gives to the compiler, sent over a local socket. Imported geometry and compiled results are kept
+    // in memory and the source assets are watched so changed assets get recompiled automatically.
+    //
+    // Address format:  "unix:<path>"           Unix domain socket (also available on Windows 10 and up)
+    //                  "tcp:<host>:<port>"     TCP socket, used by build farm workers (see xgeom_compiler_distributed.h)
+    //                                          An empty host is loopback. Listening on any other address needs the
+    //                                          shared XGEOM_DAEMON_TOKEN environment variable set on every machine.
+    //
+    // Protocol (one line per message, fields separated by tabs). Every connection first sends HELLO <Token>
+    // (empty without XGEOM_DAEMON_TOKEN) and then a single request:
+    //      COMPILE <WorkingDir> <Arg0> <Arg1> ...      ->  OK [cached] | ERROR <Message>
+    //                                                      An empty WorkingDir uses the one the daemon started in
+    //      PING                                        ->  OK
+    //      STATS                                       ->  OK <Message>
+    //      SHUTDOWN                                    ->  OK
+    //
+    struct settings
+    {
+        std::string                 m_Address           {};
+        int                         m_WatchIntervalMS   = 500;          // How often the source assets are checked for changes
+        int                         m_ClientTimeoutMS   = 10000;        // How long a client may take to send its request or read the reply
+        std::size_t                 m_ResultCacheSize   = 64;           // How many compiled results to keep in memory
+    };
+
+    struct job_result
+    {
+        xcore::err                  m_Error             {};
+        std::vector<std::string>    m_Dependencies      {};             // Files that trigger a recompile when they change
+        std::vector<std::string>    m_Outputs           {};             // Files written by the job
+    };
+
+    using job_function = std::function<job_result( const std::vector<std::string>& Args )>;
+
+    xcore::err  Serve       ( const settings& Settings, job_function JobFunction ) noexcept;
+    xcore::err  Submit      ( std::string_view Address, const std::vector<std::string>& Args, bool& bDaemonReached ) noexcept;
+    xcore::err  Ping        ( std::string_view Address ) noexcept;
+    xcore::err  Shutdown    ( std::string_view Address ) noexcept;
+}
@@ -1,7 +1,23 @@
 namespace xgeom_compiler
 {
+    //
+    // The minor version goes up with every schema change. Descriptors of an older minor version skip what was
+    // added after them, which keeps its defaults, and are written back with the current version.
+    //      2   TargetLayouts, VertexAlignment
+    //      3   SplitTriangleCount
+    //      4   SkinningOptions
+    //      5   MaterialBatches
+    //      6   bDeduplicateMeshes
+    //      7   RaycastOptions
+    //      8   CollisionOptions
+    //      9   OccluderOptions
+    //     10   ClusterLODOptions
+    //     11   StreamGroups
+    //     12   bTriangleStrips
+    //     13   VertexCacheProfile
+    //
     constexpr int version_major_v    = 1;
-    constexpr int version_minor_v    = 1;
+    constexpr int version_minor_v    = 13;
 
     struct descriptor : xresource_pipeline::descriptor::base
     {
@@ -10,7 +26,7 @@ namespace xgeom_compiler
         struct main
         {
             string                  m_MeshAsset             {};                             // File name of the mesh to load
-            string                  m_UseSkeletonFile       {};                             // Use a different skeleton file from the one found in the mesh data
+            string                  m_UseSkeletonFile       {};                             // Use a different skeleton file from the one found in the mesh data, bones are remapped by name
 //            xcore::guid::rcfull<>   m_UseSkeletonResource{};
         };
 
@@ -23,6 +39,14 @@ namespace xgeom_compiler
             std::array<bool,4>      m_bRemoveUVs            {};
             bool                    m_bRemoveBTN            = true;
             bool                    m_bRemoveBones          = true;
+            int                     m_SplitTriangleCount    = 0;                            // Split meshes into chunks of at most this many triangles (0 = off)
+            bool                    m_bDeduplicateMeshes    = false;                        // Meshes that only differ by a rigid transform become xgeom::instance
+        };
+
+        struct skinning
+        {
+            float                   m_WeightThreshold       = 1.0f / 255.0f;                // Influences below this are dropped before renormalizing
+            int                     m_MaxInfluences         = 4;                            // Per vertex, the strongest ones are kept (1 to 4)
         };
 
         struct lod
@@ -32,6 +56,38 @@ namespace xgeom_compiler
             int                     m_MaxLODs               = 5;
         };
 
+        struct cluster_lod
+        {
+            bool                    m_bGenerate             = false;                        // Cluster DAG per submesh for continuous LOD (xgeom::cluster_dag)
+            int                     m_ClusterTriangles      = 128;                          // Max triangles per cluster (4 to 512)
+            int                     m_ClusterVertices       = 64;                           // Max vertices per cluster (3 to 255)
+            int                     m_GroupSize             = 4;                            // Clusters simplified together
+        };
+
+        struct raycast
+        {
+            bool                    m_bBuildBVH             = false;                        // Triangle BVH per LOD for xgeom::RayCast/QueryBox
+            int                     m_BVHLeafSize           = 4;                            // Triangles per leaf (1 to 15)
+        };
+
+        struct collision
+        {
+            bool                    m_bGenerateMesh         = false;                        // Simplified triangle mesh for physics
+            float                   m_MeshReduction         = 0.1f;                         // Fraction of the triangles kept
+            float                   m_MeshMaxError          = 0.05f;                        // Relative to the mesh size
+            bool                    m_bGenerateHulls        = false;                        // Convex hulls around the mesh
+            int                     m_MaxHulls              = 1;                            // More than one splits the mesh in pieces and wraps each one
+            int                     m_MaxHullVertices       = 32;
+        };
+
+        struct occluder
+        {
+            bool                    m_bGenerate             = false;                        // Boxes inside each mesh for software occlusion culling
+            int                     m_Resolution            = 32;                           // Voxels along the longest side of the mesh
+            int                     m_MaxBoxes              = 4;
+            float                   m_MinVolumeRatio        = 0.1f;                         // Meshes whose boxes fill less of their bounds are flagged
+        };
+
         struct streams
         {
             bool                    m_UseElementStreams     = false;
@@ -40,6 +96,25 @@ namespace xgeom_compiler
             bool                    m_bCompressBTN          = true;
             std::array<bool, 4>     m_bCompressUV           {};
             bool                    m_bCompressWeights      = true;
+            int                     m_VertexAlignment       = 1;                            // Minimum alignment of the interleaved vertex
+            bool                    m_bTriangleStrips       = false;                        // Submesh indices as strips with primitive restart when shorter than the list
+            string                  m_VertexCacheProfile    {};                             // Index order tuned for NVIDIA, AMD, INTEL or FIFO (16 entry) caches, empty keeps the generic one
+            string                  m_StreamGroups          {};                             // Overrides the layout flags, vertex streams separated by '|' ("Position | Position BoneWeights BoneIndices | UVs BTN Color")
+        };
+
+        // Material instances that can be drawn with another one (texture array slices, atlases...). Their facets
+        // join the submesh of m_iBatchMaterial and every vertex gets m_Slice in a material id stream.
+        struct material_batch
+        {
+            int                     m_iMaterial             = 0;                            // Material instance to fold
+            int                     m_iBatchMaterial        = 0;                            // Material instance drawn instead
+            int                     m_Slice                 = 0;                            // Written in the material id stream
+        };
+
+        struct target_layout
+        {
+            string                  m_Platform              {};                             // Platform name as the pipeline knows it ("WINDOWS", ...)
+            streams                 m_Streams               {};                             // Stream layout used for that platform
         };
 
         descriptor() : xresource_pipeline::descriptor::base
@@ -53,10 +128,17 @@ namespace xgeom_compiler
         inline
         static xcore::err Serialize(descriptor& Options, std::string_view FilePath, bool isRead) noexcept;
 
-        main        m_Main;
-        cleanup     m_Cleanup;
-        lod         m_LOD;
-        streams     m_Streams;
+        main                        m_Main;
+        cleanup                     m_Cleanup;
+        skinning                    m_Skinning;
+        lod                         m_LOD;
+        cluster_lod                 m_ClusterLOD;
+        raycast                     m_Raycast;
+        collision                   m_Collision;
+        occluder                    m_Occluder;
+        streams                     m_Streams;
+        std::vector<target_layout>  m_TargetLayouts;                // Per platform overrides of m_Streams
+        std::vector<material_batch> m_MaterialBatches;              // Fewer submeshes (draw calls) at the cost of a material id stream
     };
 
     //-------------------------------------------------------------------------------------------------------
@@ -73,6 +155,9 @@ namespace xgeom_compiler
         if( auto Err = Options.parent::Serialize( Stream, isRead ); Err )
             return Err;
 
+        // Minor version of the file, only what it already had is read (see version_minor_v)
+        const int Minor = isRead ? Options.m_Version.m_Minor : version_minor_v;
+
         if (Stream.Record(Error, "MainOptions"
             , [&](std::size_t, xcore::err& Err)
             {   
@@ -92,6 +177,8 @@ namespace xgeom_compiler
                 || (Err = Stream.Field("bRemoveColor",          Options.m_Cleanup.m_bRemoveColor))
                 || (Err = Stream.Field("m_bRemoveBTN",          Options.m_Cleanup.m_bRemoveBTN))
                 || (Err = Stream.Field("m_bRemoveBones",        Options.m_Cleanup.m_bRemoveBones))
+                || (Minor >= 3 && (Err = Stream.Field("SplitTriangleCount",    Options.m_Cleanup.m_SplitTriangleCount)))
+                || (Minor >= 6 && (Err = Stream.Field("bDeduplicateMeshes",    Options.m_Cleanup.m_bDeduplicateMeshes)))
                 ;
             })) return Error;
 
@@ -106,6 +193,15 @@ namespace xgeom_compiler
             Err = Stream.Field( "bRemoveUVs", Options.m_Cleanup.m_bRemoveUVs[I] );
         }) ) return Error;
 
+        if (Minor >= 4 && Stream.Record(Error, "SkinningOptions"
+            , [&](std::size_t, xcore::err& Err)
+            {
+                0
+                || (Err = Stream.Field("WeightThreshold",       Options.m_Skinning.m_WeightThreshold))
+                || (Err = Stream.Field("MaxInfluences",         Options.m_Skinning.m_MaxInfluences))
+                ;
+            })) return Error;
+
         if (Stream.Record(Error, "LODOptions"
             , [&](std::size_t, xcore::err& Err)
             {
@@ -116,6 +212,50 @@ namespace xgeom_compiler
                 ;
             })) return Error;
 
+        if (Minor >= 10 && Stream.Record(Error, "ClusterLODOptions"
+            , [&](std::size_t, xcore::err& Err)
+            {
+                0
+                || (Err = Stream.Field("bGenerate",             Options.m_ClusterLOD.m_bGenerate))
+                || (Err = Stream.Field("ClusterTriangles",      Options.m_ClusterLOD.m_ClusterTriangles))
+                || (Err = Stream.Field("ClusterVertices",       Options.m_ClusterLOD.m_ClusterVertices))
+                || (Err = Stream.Field("GroupSize",             Options.m_ClusterLOD.m_GroupSize))
+                ;
+            })) return Error;
+
+        if (Minor >= 7 && Stream.Record(Error, "RaycastOptions"
+            , [&](std::size_t, xcore::err& Err)
+            {
+                0
+                || (Err = Stream.Field("bBuildBVH",             Options.m_Raycast.m_bBuildBVH))
+                || (Err = Stream.Field("BVHLeafSize",           Options.m_Raycast.m_BVHLeafSize))
+                ;
+            })) return Error;
+
+        if (Minor >= 8 && Stream.Record(Error, "CollisionOptions"
+            , [&](std::size_t, xcore::err& Err)
+            {
+                0
+                || (Err = Stream.Field("bGenerateMesh",         Options.m_Collision.m_bGenerateMesh))
+                || (Err = Stream.Field("MeshReduction",         Options.m_Collision.m_MeshReduction))
+                || (Err = Stream.Field("MeshMaxError",          Options.m_Collision.m_MeshMaxError))
+                || (Err = Stream.Field("bGenerateHulls",        Options.m_Collision.m_bGenerateHulls))
+                || (Err = Stream.Field("MaxHulls",              Options.m_Collision.m_MaxHulls))
+                || (Err = Stream.Field("MaxHullVertices",       Options.m_Collision.m_MaxHullVertices))
+                ;
+            })) return Error;
+
+        if (Minor >= 9 && Stream.Record(Error, "OccluderOptions"
+            , [&](std::size_t, xcore::err& Err)
+            {
+                0
+                || (Err = Stream.Field("bGenerate",             Options.m_Occluder.m_bGenerate))
+                || (Err = Stream.Field("Resolution",            Options.m_Occluder.m_Resolution))
+                || (Err = Stream.Field("MaxBoxes",              Options.m_Occluder.m_MaxBoxes))
+                || (Err = Stream.Field("MinVolumeRatio",        Options.m_Occluder.m_MinVolumeRatio))
+                ;
+            })) return Error;
+
         if (Stream.Record(Error, "StreamOptions"
             , [&](std::size_t, xcore::err& Err)
             {
@@ -125,6 +265,10 @@ namespace xgeom_compiler
                 || (Err = Stream.Field("m_bCompressPosition",   Options.m_Streams.m_bCompressPosition))
                 || (Err = Stream.Field("m_bCompressBTN",        Options.m_Streams.m_bCompressBTN))
                 || (Err = Stream.Field("m_bCompressWeights",    Options.m_Streams.m_bCompressWeights))
+                || (Minor >= 2 && (Err = Stream.Field("VertexAlignment",       Options.m_Streams.m_VertexAlignment)))
+                || (Minor >= 11 && (Err = Stream.Field("StreamGroups",          Options.m_Streams.m_StreamGroups)))
+                || (Minor >= 12 && (Err = Stream.Field("bTriangleStrips",       Options.m_Streams.m_bTriangleStrips)))
+                || (Minor >= 13 && (Err = Stream.Field("VertexCacheProfile",    Options.m_Streams.m_VertexCacheProfile)))
                 ;
             })) return Error;
 
@@ -139,6 +283,65 @@ namespace xgeom_compiler
             Err = Stream.Field( "bCompressUV", Options.m_Streams.m_bCompressUV[I] );
         }) ) return Error;
 
+        if( Minor >= 2 && Stream.Record( Error, "TargetLayouts"
+        , [&]( std::size_t& Count, xcore::err& Err )
+        {
+            if( isRead ) Options.m_TargetLayouts.resize(Count);
+            else         Count = Options.m_TargetLayouts.size();
+        }
+        , [&]( std::size_t I, xcore::err& Err )
+        {
+            auto& Layout = Options.m_TargetLayouts[I];
+            0
+            || (Err = Stream.Field("Platform",              Layout.m_Platform))
+            || (Err = Stream.Field("UseElementStreams",     Layout.m_Streams.m_UseElementStreams))
+            || (Err = Stream.Field("SeparatePosition",      Layout.m_Streams.m_SeparatePosition))
+            || (Err = Stream.Field("m_bCompressPosition",   Layout.m_Streams.m_bCompressPosition))
+            || (Err = Stream.Field("m_bCompressBTN",        Layout.m_Streams.m_bCompressBTN))
+            || (Err = Stream.Field("m_bCompressWeights",    Layout.m_Streams.m_bCompressWeights))
+            || (Err = Stream.Field("VertexAlignment",       Layout.m_Streams.m_VertexAlignment))
+            || (Minor >= 11 && (Err = Stream.Field("StreamGroups",          Layout.m_Streams.m_StreamGroups)))
+            || (Minor >= 12 && (Err = Stream.Field("bTriangleStrips",       Layout.m_Streams.m_bTriangleStrips)))
+            || (Minor >= 13 && (Err = Stream.Field("VertexCacheProfile",    Layout.m_Streams.m_VertexCacheProfile)))
+            || (Err = Stream.Field("bCompressUV0",          Layout.m_Streams.m_bCompressUV[0]))
+            || (Err = Stream.Field("bCompressUV1",          Layout.m_Streams.m_bCompressUV[1]))
+            || (Err = Stream.Field("bCompressUV2",          Layout.m_Streams.m_bCompressUV[2]))
+            || (Err = Stream.Field("bCompressUV3",          Layout.m_Streams.m_bCompressUV[3]))
+            ;
+        }) ) return Error;
+
+        if( Minor >= 5 && Stream.Record( Error, "MaterialBatches"
+        , [&]( std::size_t& Count, xcore::err& Err )
+        {
+            if( isRead ) Options.m_MaterialBatches.resize(Count);
+            else         Count = Options.m_MaterialBatches.size();
+        }
+        , [&]( std::size_t I, xcore::err& Err )
+        {
+            auto& Batch = Options.m_MaterialBatches[I];
+            0
+            || (Err = Stream.Field("iMaterial",             Batch.m_iMaterial))
+            || (Err = Stream.Field("iBatchMaterial",        Batch.m_iBatchMaterial))
+            || (Err = Stream.Field("Slice",                 Batch.m_Slice))
+            ;
+        }) ) return Error;
+
+        // The compiler aligns with xcore::bits::Align which only takes powers of two
+        if( isRead )
+        {
+            // Migrated, saving it again writes the current layout
+            Options.m_Version.m_Major = version_major_v;
+            Options.m_Version.m_Minor = version_minor_v;
+
+            auto isPowerOfTwo = []( int Value ) { return Value > 0 && (Value & (Value - 1)) == 0; };
+            if( isPowerOfTwo( Options.m_Streams.m_VertexAlignment ) == false )
+                return xerr_failure_s( "StreamOptions VertexAlignment must be a power of two" );
+
+            for( const auto& Layout : Options.m_TargetLayouts )
+                if( isPowerOfTwo( Layout.m_Streams.m_VertexAlignment ) == false )
+                    return xerr_failure_s( "TargetLayouts VertexAlignment must be a power of two" );
+        }
+
         return {};
     }
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+namespace xgeom_compiler::distributed
+{
+    //
+    // Build farm support. Every compile is a pure function of its inputs (descriptor, mesh asset and
+    // the pipeline switches) so outputs are stored in a shared artifact directory under a hash of those
+    // inputs, any worker that compiled a resource makes it available to everyone else.
+    //
+    // Workers are daemons listening in a TCP address (-DAEMON "tcp:<host>:<port>", remote ones need the
+    // XGEOM_DAEMON_TOKEN environment variable). The coordinator enumerates the xgeom descriptors of the
+    // project, hashes their inputs and hands the jobs to the workers, most expensive first, so the load
+    // stays balanced.
+    //
+    // Store layout:    <StorePath>/<InputKey>/<iTarget>.xgeom
+    //
+    // The key also covers the descriptor and runtime versions and the compiler output version. ComputeInputKey fails
+    // when an input can not be read, such a resource is compiled without the store.
+    //
+    struct job
+    {
+        std::vector<std::string>    m_Args;                             // Command line given to the worker
+        std::string                 m_Name;                             // Resource name for the logs
+        std::uint64_t               m_InputKey          { 0 };
+        std::uint64_t               m_Cost              { 0 };          // Estimated cost, cached artifacts are almost free
+    };
+
+    struct settings
+    {
+        std::vector<std::string>    m_Workers           {};             // Worker addresses "tcp:<host>:<port>"
+        int                         m_nLocalWorkers     = 0;            // Worker processes to spawn in this machine
+        int                         m_LocalBasePort     = 47100;        // First port used by the local workers
+        std::string                 m_ExePath           {};             // Compiler executable used to spawn local workers
+        std::string                 m_StorePath         {};             // Shared artifact directory
+    };
+
+    bool                ComputeInputKey     ( std::uint64_t& InputKey, std::string_view DescriptorPath, std::string_view AssetsRootPath, const std::vector<std::string>& Args ) noexcept;
+    bool                FetchArtifact       ( std::string_view StorePath, std::uint64_t InputKey, int iTarget, std::string_view DestinationPath ) noexcept;
+    void                PublishArtifact     ( std::string_view StorePath, std::uint64_t InputKey, int iTarget, std::string_view SourcePath ) noexcept;
+    std::vector<job>    EnumerateJobs       ( std::string_view ProjectPath, std::string_view AssetsRootPath, std::string_view StorePath, const std::vector<std::string>& Args ) noexcept;
+    xcore::err          RunCoordinator      ( const settings& Settings, std::vector<job> Jobs ) noexcept;
+}
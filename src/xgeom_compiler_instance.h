@@ -1,11 +1,43 @@
 namespace xgeom_compiler
 {
+    struct target_output
+    {
+        std::string                 m_FilePath;
+        const descriptor::streams*  m_pStreams;                                 // Stream layout of this target, null uses the descriptor's one
+    };
+
+    struct write_options
+    {
+        enum class format : std::uint8_t
+        { SERIALIZER                                                            // xcore::serializer stream, field by field
+        , IMAGE                                                                 // Single block loaded in place (see xgeom::LoadImageInPlace)
+        };
+
+        enum class fsync_policy : std::uint8_t
+        { NONE                                                                  // Leave it to the OS
+        , DATA                                                                  // Flush the file data before reporting the write as done
+        , FULL                                                                  // Flush the file data and metadata
+        };
+
+        format                      m_Format    = format::SERIALIZER;
+        fsync_policy                m_Fsync     = fsync_policy::NONE;
+    };
+
     struct instance
     {
-        virtual void LoadRaw        ( const std::string_view FilePath ) = 0;
+        virtual     ~instance       ( void ) = default;
+        virtual void LoadRaw        ( const std::string_view FilePath, const descriptor& Options ) = 0;   // Only keeps what compiling with Options uses
+        virtual void BindSkeleton   ( const std::string_view FilePath ) = 0;   // Remaps the loaded mesh bones onto a shared skeleton file (cached between compiles)
         virtual void Compile        ( const descriptor& Options ) = 0;
+        virtual void CompileTargets ( const descriptor& Options, std::span<const target_output> Targets ) = 0;    // Compile + Serialize for several layouts at once
         virtual void Serialize      ( const std::string_view FilePath ) = 0;
+        virtual void SetRawCacheSize( std::size_t MaxEntries ) = 0;           // How many imported raw geometries to keep around (long running processes)
+        virtual void SetLeanMemory  ( bool bLean ) = 0;                         // Release raw and intermediate data as soon as each stage is done with it
+        virtual void SetMaxThreads  ( std::size_t nThreads ) = 0;               // Threads one compile may use for the mesh conversion, 0 goes back to the default (4)
+        virtual void SetWriteOptions( const write_options& Options ) = 0;
+        virtual void SetSortKeyLayout( const xgeom::sort_key_layout& Layout ) = 0; // How submesh::m_BaseSortKey is packed, must match the renderer
+        virtual void Flush          ( void ) = 0;                               // Waits for the queued image writes, throws if any of them failed
     };
 
     std::unique_ptr<instance> MakeInstance();
-}
\ No newline at end of file
+}
@@ -0,0 +1,307 @@
+#ifndef XANIM_COMPILER_RUNTIME_HPP
+#define XANIM_COMPILER_RUNTIME_HPP
+
+#include "xcore.h"
+
+//
+// Compressed animation clip. Every bone has one track per channel (rotation, translation, scale) and
+// each track only has the keys the compiler could not rebuild by interpolating its neighbours.
+//
+// Keys are stored as structure of arrays, component c of key k is m_pKeyValue[ c * m_nKeys + k ], so
+// decoding walks three tight uint16 arrays:
+//      Rotation    - smallest three. The largest component is dropped (and made positive), the other
+//                    three keep 15 bits in [-1/sqrt(2), 1/sqrt(2)]. The top bits of components 0 and 1
+//                    say which one was dropped.
+//      Translation - 16 bits per component inside m_TranslationRange
+//      Scale       - 16 bits per component inside m_ScaleRange
+//
+struct xanim
+{
+    enum
+    {
+        VERSION = 1
+    };
+
+    enum channel : std::uint8_t
+    { ROTATION
+    , TRANSLATION
+    , SCALE
+    , CHANNEL_COUNT
+    };
+
+    struct bone
+    {
+        std::array<char, 32>    m_Name;
+        std::int16_t            m_iParent;          // -1 for the root
+    };
+
+    struct track
+    {
+        std::uint32_t           m_iKey;             // First key in m_pKeyTime/m_pKeyValue
+        std::uint32_t           m_nKeys;            // At least one
+    };
+
+    struct range
+    {
+        std::array<float, 3>    m_Min;
+        std::array<float, 3>    m_Extent;           // Max - Min
+    };
+
+    struct pose
+    {
+        std::array<float, 4>    m_Rotation;         // Quaternion X Y Z W
+        std::array<float, 3>    m_Translation;
+        std::array<float, 3>    m_Scale;
+    };
+
+    static constexpr float          smallest_three_range_v  = 0.70710678f;  // 1/sqrt(2)
+    static constexpr std::uint16_t  smallest_three_max_v    = 0x7fff;
+
+    //-------------------------------------------------------------------------
+
+                    xanim                       ( void ) = default;
+    inline          xanim                       ( xcore::serializer::stream& Steaming ) noexcept;
+    inline
+    void            Initialize                  ( void ) noexcept;
+    inline
+    void            Kill                        ( void ) noexcept;
+    inline
+    const track&    getTrack                    ( int iBone, channel Channel ) const noexcept { return m_pTrack[ iBone * CHANNEL_COUNT + Channel ]; }
+    inline
+    float           getDuration                 ( void ) const noexcept { return m_FPS > 0 ? float(m_nFrames - 1) / m_FPS : 0; }
+    inline
+    void            SampleLocalPose             ( float Frame, std::span<pose> Pose ) const noexcept;   // Frame in [0, m_nFrames-1], one pose per bone
+
+    // Helpers shared with the compiler
+    inline static
+    void            EncodeRotation              ( const std::array<float, 4>& Q, std::uint16_t& A, std::uint16_t& B, std::uint16_t& C ) noexcept;
+    inline static
+    std::array<float, 4> DecodeRotation         ( std::uint16_t A, std::uint16_t B, std::uint16_t C ) noexcept;
+    inline static
+    std::uint16_t   EncodeRange                 ( float V, float Min, float Extent ) noexcept;
+    inline static
+    float           DecodeRange                 ( std::uint16_t V, float Min, float Extent ) noexcept;
+
+    bone*                                           m_pBone;
+    track*                                          m_pTrack;           // m_nBones * CHANNEL_COUNT, bone major
+    std::uint16_t*                                  m_pKeyTime;         // Frame of each key
+    std::uint16_t*                                  m_pKeyValue;        // 3 * m_nKeys, see above
+    std::uint32_t                                   m_nKeys;
+    range                                           m_TranslationRange;
+    range                                           m_ScaleRange;
+    float                                           m_FPS;
+    std::uint16_t                                   m_nFrames;
+    std::uint16_t                                   m_nBones;
+    std::array<char, 32>                            m_Name;
+};
+
+//-------------------------------------------------------------------------
+
+xanim::xanim( xcore::serializer::stream& Steaming ) noexcept
+{
+    //xassert( Steaming.getResourceVersion() == xanim::VERSION );
+}
+
+//-------------------------------------------------------------------------
+
+void xanim::Initialize( void ) noexcept
+{
+    std::memset( this, 0, sizeof(*this) );
+}
+
+//-------------------------------------------------------------------------
+
+void xanim::Kill( void ) noexcept
+{
+    if( m_pBone )       delete[] m_pBone;
+    if( m_pTrack )      delete[] m_pTrack;
+    if( m_pKeyTime )    delete[] m_pKeyTime;
+    if( m_pKeyValue )   delete[] m_pKeyValue;
+}
+
+//-------------------------------------------------------------------------
+
+void xanim::EncodeRotation( const std::array<float, 4>& Q, std::uint16_t& A, std::uint16_t& B, std::uint16_t& C ) noexcept
+{
+    int iLargest = 0;
+    for( int i = 1; i < 4; ++i ) if( std::abs(Q[i]) > std::abs(Q[iLargest]) ) iLargest = i;
+
+    // q and -q are the same rotation, keep the dropped one positive so it can be rebuilt
+    const float     Sign = Q[iLargest] < 0 ? -1.0f : 1.0f;
+    std::uint16_t   Out[3];
+    for( int i = 0, k = 0; i < 4; ++i )
+    {
+        if( i == iLargest ) continue;
+        const auto V = std::clamp( Q[i] * Sign / smallest_three_range_v, -1.0f, 1.0f );
+        Out[k++] = std::uint16_t( (V * 0.5f + 0.5f) * smallest_three_max_v + 0.5f );
+    }
+
+    A = std::uint16_t( Out[0] | ((iLargest & 1) << 15) );
+    B = std::uint16_t( Out[1] | ((iLargest >> 1) << 15) );
+    C = Out[2];
+}
+
+//-------------------------------------------------------------------------
+
+std::array<float, 4> xanim::DecodeRotation( std::uint16_t A, std::uint16_t B, std::uint16_t C ) noexcept
+{
+    const int   iLargest    = (A >> 15) | ((B >> 15) << 1);
+    const float In[3]       = { float(A & smallest_three_max_v), float(B & smallest_three_max_v), float(C & smallest_three_max_v) };
+
+    std::array<float, 4> Q;
+    float                Sum = 0;
+    for( int i = 0, k = 0; i < 4; ++i )
+    {
+        if( i == iLargest ) continue;
+        Q[i] = ( In[k++] / smallest_three_max_v * 2.0f - 1.0f ) * smallest_three_range_v;
+        Sum += Q[i] * Q[i];
+    }
+    Q[iLargest] = std::sqrt( std::max( 0.0f, 1.0f - Sum ) );
+    return Q;
+}
+
+//-------------------------------------------------------------------------
+
+std::uint16_t xanim::EncodeRange( float V, float Min, float Extent ) noexcept
+{
+    if( Extent <= 0 ) return 0;
+    return std::uint16_t( std::clamp( (V - Min) / Extent, 0.0f, 1.0f ) * 0xffff + 0.5f );
+}
+
+//-------------------------------------------------------------------------
+
+float xanim::DecodeRange( std::uint16_t V, float Min, float Extent ) noexcept
+{
+    return Min + float(V) * (Extent / 0xffff);
+}
+
+//-------------------------------------------------------------------------
+
+void xanim::SampleLocalPose( float Frame, std::span<pose> Pose ) const noexcept
+{
+    xassert( Pose.size() >= m_nBones );
+
+    const auto pA = m_pKeyValue;
+    const auto pB = m_pKeyValue + m_nKeys;
+    const auto pC = m_pKeyValue + m_nKeys * 2;
+
+    // Keys around Frame and how far between them it is
+    auto Find = [&]( const track& Track, std::uint32_t& i0, std::uint32_t& i1, float& T ) noexcept
+    {
+        const auto pBegin = m_pKeyTime + Track.m_iKey;
+        const auto pEnd   = pBegin + Track.m_nKeys;
+        const auto pNext  = std::upper_bound( pBegin, pEnd, std::uint16_t( std::max( 0.0f, Frame ) ) );
+
+        if( pNext == pBegin ) { i0 = i1 = Track.m_iKey;                        T = 0; return; }
+        if( pNext == pEnd   ) { i0 = i1 = Track.m_iKey + Track.m_nKeys - 1;    T = 0; return; }
+
+        i1 = std::uint32_t( pNext - m_pKeyTime );
+        i0 = i1 - 1;
+        T  = std::clamp( (Frame - m_pKeyTime[i0]) / float(m_pKeyTime[i1] - m_pKeyTime[i0]), 0.0f, 1.0f );
+    };
+
+    auto SampleRange = [&]( const track& Track, const range& Range, std::array<float, 3>& Out ) noexcept
+    {
+        std::uint32_t i0, i1;
+        float         T;
+        Find( Track, i0, i1, T );
+
+        const std::uint16_t* p[3] = { pA, pB, pC };
+        for( int c = 0; c < 3; ++c )
+        {
+            const auto V0 = DecodeRange( p[c][i0], Range.m_Min[c], Range.m_Extent[c] );
+            const auto V1 = DecodeRange( p[c][i1], Range.m_Min[c], Range.m_Extent[c] );
+            Out[c] = V0 + (V1 - V0) * T;
+        }
+    };
+
+    for( int iBone = 0; iBone < m_nBones; ++iBone )
+    {
+        auto& Out = Pose[iBone];
+
+        //
+        // Rotation, normalized lerp on the shortest path
+        //
+        {
+            std::uint32_t i0, i1;
+            float         T;
+            Find( getTrack( iBone, ROTATION ), i0, i1, T );
+
+            const auto Q0  = DecodeRotation( pA[i0], pB[i0], pC[i0] );
+            auto       Q1  = DecodeRotation( pA[i1], pB[i1], pC[i1] );
+            const auto Dot = Q0[0]*Q1[0] + Q0[1]*Q1[1] + Q0[2]*Q1[2] + Q0[3]*Q1[3];
+            if( Dot < 0 ) for( auto& V : Q1 ) V = -V;
+
+            float Len = 0;
+            for( int c = 0; c < 4; ++c ) { Out.m_Rotation[c] = Q0[c] + (Q1[c] - Q0[c]) * T; Len += Out.m_Rotation[c] * Out.m_Rotation[c]; }
+
+            Len = Len > 0 ? 1.0f / std::sqrt(Len) : 0.0f;
+            for( auto& V : Out.m_Rotation ) V *= Len;
+        }
+
+        SampleRange( getTrack( iBone, TRANSLATION ), m_TranslationRange, Out.m_Translation );
+        SampleRange( getTrack( iBone, SCALE ),       m_ScaleRange,       Out.m_Scale );
+    }
+}
+
+//-------------------------------------------------------------------------
+// serializer
+//-------------------------------------------------------------------------
+namespace xcore::serializer::io_functions
+{
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xanim::bone>(xcore::serializer::stream& Stream, const xanim::bone& Bone ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(Bone.m_Name          ))
+        || (Err = Stream.Serialize(Bone.m_iParent       ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xanim::track>(xcore::serializer::stream& Stream, const xanim::track& Track ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(Track.m_iKey         ))
+        || (Err = Stream.Serialize(Track.m_nKeys        ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xanim>(xcore::serializer::stream& Stream, const xanim& Anim ) noexcept
+    {
+        xcore::err Err;
+        const auto nTracks  = std::uint32_t(Anim.m_nBones) * xanim::CHANNEL_COUNT;
+        const auto nValues  = Anim.m_nKeys * 3;
+        false
+        || (Err = Stream.Serialize( Anim.m_pBone,       Anim.m_nBones   ))
+        || (Err = Stream.Serialize( Anim.m_pTrack,      nTracks         ))
+        || (Err = Stream.Serialize( Anim.m_pKeyTime,    Anim.m_nKeys    ))
+        || (Err = Stream.Serialize( Anim.m_pKeyValue,   nValues         ))
+        || (Err = Stream.Serialize( Anim.m_nKeys                        ))
+        || (Err = Stream.Serialize( Anim.m_TranslationRange.m_Min       ))
+        || (Err = Stream.Serialize( Anim.m_TranslationRange.m_Extent    ))
+        || (Err = Stream.Serialize( Anim.m_ScaleRange.m_Min             ))
+        || (Err = Stream.Serialize( Anim.m_ScaleRange.m_Extent          ))
+        || (Err = Stream.Serialize( Anim.m_FPS                          ))
+        || (Err = Stream.Serialize( Anim.m_nFrames                      ))
+        || (Err = Stream.Serialize( Anim.m_nBones                       ))
+        || (Err = Stream.Serialize( Anim.m_Name                         ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+}
+
+#endif
@@ -7,7 +7,7 @@ struct xgeom
 {
     enum
     {
-        VERSION = 1
+        VERSION = 12
     };
 
     struct bone
@@ -31,14 +31,138 @@ struct xgeom
         std::uint16_t           m_iLOD;
     };
 
+    //
+    // Copy of a mesh that had the same geometry up to a rigid transform, the compiler keeps the geometry
+    // of m_iMesh only. Draw m_iMesh with this transform on top (hardware instancing when there are many).
+    //
+    struct instance
+    {
+        std::array<char, 32>    m_Name;             // Name of the mesh this copy replaced
+        std::array<float, 12>   m_Transform;        // Row major 3x4 rotation | translation, from m_iMesh to the copy
+        std::uint16_t           m_iMesh;            // Mesh with the geometry
+    };
+
+    //
+    // Triangle BVH for CPU queries (picking, line of sight, decals...), one per entry of m_pLOD over the
+    // triangles of that LOD, when the compiler built them. Nodes are 4 wide with the child boxes as one array
+    // per axis, so a node is tested with a few 4 lane operations. Leaves have their own copy of the triangles,
+    // queries never decode the vertex streams (which may be quantized or interleaved with other attributes).
+    //
+    static constexpr std::uint32_t  bvh_leaf_bit_v          = 1u << 31;
+    static constexpr int            bvh_leaf_count_shift_v  = 27;               // Leaf: count in bits 27..30, first triangle below
+    static constexpr std::uint32_t  bvh_empty_v             = bvh_leaf_bit_v;   // Leaf with no triangles, its box is empty too
+    static constexpr int            bvh_max_leaf_size_v     = 15;
+    static constexpr int            bvh_stack_size_v        = 256;              // The compiler keeps the trees shallow enough for this
+
+    struct bvh_node
+    {
+        std::array<float, 4>            m_MinX, m_MinY, m_MinZ;
+        std::array<float, 4>            m_MaxX, m_MaxY, m_MaxZ;
+        std::array<std::uint32_t, 4>    m_Child;    // Node index in m_pBVHNode, or a leaf (bvh_leaf_bit_v)
+    };
+
+    struct bvh_triangle
+    {
+        std::array<float, 3>    m_V0;
+        std::array<float, 3>    m_Edge1;            // V1 - V0
+        std::array<float, 3>    m_Edge2;            // V2 - V0
+        std::uint32_t           m_iIndex;           // Where its three indices start in the index stream (strips too, every other one wound backwards)
+    };
+
+    struct bvh
+    {
+        std::uint32_t           m_iRoot;            // Root node in m_pBVHNode
+        std::uint32_t           m_nNodes;           // Zero when the LOD has no triangles
+    };
+
+    //
+    // Physics proxies generated from the render geometry, sorted by mesh. Every shape has its own vertices
+    // (3 floats each in m_pCollisionVertex) and triangles (m_pCollisionIndex, relative to m_iVertex), a mesh
+    // can have a simplified triangle mesh and any number of convex hulls (a rough convex decomposition).
+    //
+    struct collision_shape
+    {
+        enum class type : std::uint8_t
+        { TRIANGLE_MESH
+        , CONVEX_HULL
+        };
+
+        std::uint32_t           m_iVertex;
+        std::uint32_t           m_nVertices;
+        std::uint32_t           m_iIndex;
+        std::uint32_t           m_nIndices;
+        std::uint16_t           m_iMesh;
+        type                    m_Type;
+    };
+
+    //
+    // Software occlusion culling proxy of a mesh (same order as m_pMesh): a few boxes fitted strictly
+    // inside the closed parts of the mesh, so whatever they cover is really hidden. Meshes that can not
+    // hide anything reliably are flagged and have no triangles.
+    //
+    struct occluder
+    {
+        static constexpr std::uint8_t usable_mask_v     = 1<<0;     // Has triangles
+        static constexpr std::uint8_t not_closed_mask_v = 1<<1;     // Open surface, it has no inside
+        static constexpr std::uint8_t too_thin_mask_v   = 1<<2;     // Closed but the boxes inside would hide too little
+
+        std::uint32_t           m_iVertex;          // First vertex in m_pOccluderVertex (3 floats each)
+        std::uint32_t           m_iIndex;           // First index in m_pOccluderIndex, relative to m_iVertex
+        std::uint16_t           m_nVertices;
+        std::uint16_t           m_nIndices;
+        std::uint8_t            m_Flags;
+    };
+
+    //
+    // Cluster LOD DAG of a LOD 0 submesh (continuous LOD). Clusters are small runs of the index stream, a group
+    // of neighbor clusters was simplified together into the clusters of the next level with its border locked,
+    // so any cut through the DAG stitches without cracks. SelectClusters picks the cut for a screen space
+    // error: a cluster is drawn when it is precise enough and the clusters made from it are not.
+    //
+    struct cluster
+    {
+        std::array<float, 4>    m_Bounds;           // Sphere (xyz radius) the error was measured over
+        std::array<float, 4>    m_ParentBounds;
+        float                   m_Error;            // Object space, 0 for the original triangles
+        float                   m_ParentError;      // std::numeric_limits<float>::max() for the roots
+        std::uint32_t           m_iIndex;           // Where its indices start in the index stream
+        std::uint16_t           m_nIndices;
+        std::uint8_t            m_Level;            // 0 for the original triangles
+    };
+
+    struct cluster_dag
+    {
+        std::uint32_t           m_iCluster;         // First cluster in m_pCluster
+        std::uint32_t           m_nClusters;
+        std::uint16_t           m_iSubmesh;         // LOD 0 submesh it replaces (material, vertices)
+        std::uint8_t            m_nLevels;
+    };
+
+    struct ray_hit
+    {
+        float                   m_T;                // Hit point is From + Dir * m_T
+        float                   m_U, m_V;           // Barycentrics, V0 + Edge1 * m_U + Edge2 * m_V
+        std::uint32_t           m_iIndex;           // bvh_triangle::m_iIndex of the triangle
+    };
+
     struct submesh
     {
+        enum class topology : std::uint8_t
+        { TRIANGLE_LIST
+        , TRIANGLE_STRIP                            // Primitive restart at the all ones index (0xffff or 0xffffffff, as the index format)
+        };
+
+        xcore::bbox             m_BBox;             // Tight bounds of the vertices referenced by this submesh
+        xcore::vector3d         m_SphereCenter;     // Bounding sphere, tighter than the box for long diagonal pieces
+        float                   m_SphereRadius;
         std::uint32_t           m_BaseSortKey;      // used internally by the rendering system
         std::uint32_t           m_iIndex;           // Where the index starts
         std::uint32_t           m_nIndices;         // Where the index starts
         std::uint16_t           m_iDList;           // Index into list of display lists
         std::uint16_t           m_nDLists;          // Number of display lists
         std::uint16_t           m_iMaterial;        // Index of the Material that this SubMesh uses
+        std::uint8_t            m_nWeights;         // Bone influences its vertices use, can be less than the stream has (skinning shader variant)
+        topology                m_Topology;         // How to draw its indices
     };
 
     enum class cmd_type : std::uint8_t
@@ -76,6 +200,7 @@ struct xgeom
     {
         union element_def
         {
+            static constexpr auto material_id_mask_v = 1<<7;
             static constexpr auto btn_mask_v         = 1<<6;
             static constexpr auto bone_weight_mask_v = 1<<5;
             static constexpr auto bone_index_mask_v  = 1<<4;
@@ -94,6 +219,7 @@ struct xgeom
                 ,            m_bBoneIndices :1      // Indices
                 ,            m_bBoneWeights :1      // weights
                 ,            m_bBTNs        :1      // binormal tangents and normals
+                ,            m_bMaterialIDs :1      // which material of a batch (texture array slice...)
                 ;
             };
         };
@@ -161,7 +287,127 @@ struct xgeom
         std::uint8_t    m_iStream;
     };
 
-    static constexpr auto max_stream_count_v = 6;
+    static constexpr auto max_stream_count_v      = 8;
+    static constexpr auto max_stream_info_count_v = 16;     // An element can be in more than one stream (see descriptor stream groups)
+
+    //
+    // Perfect hash tables compiled into m_pLookup (hash and displace). A key picks a bucket, the bucket
+    // has the seed that sends its keys to distinct slots, and the slot has the value. Lookups are two
+    // reads plus one check of the candidate. A table with no slots means the compiler did not build it.
+    //
+    struct lookup_table
+    {
+        std::uint32_t           m_iData;            // Bucket seeds start here in m_pLookup, the slots follow them
+        std::uint32_t           m_nBuckets;         // Power of two
+        std::uint32_t           m_nSlots;           // Power of two, zero when there is no table
+    };
+
+    static constexpr std::uint16_t lookup_empty_v = 0xffff;
+
+    static constexpr std::uint32_t HashName( const char* pName ) noexcept
+    {
+        std::uint32_t Hash = 0x811c9dc5u;
+        while( *pName ) { Hash ^= std::uint8_t(*pName++); Hash *= 0x01000193u; }
+        return Hash;
+    }
+
+    static constexpr std::uint32_t HashMix( std::uint32_t Key, std::uint32_t Seed ) noexcept
+    {
+        Key ^= Seed * 0x9e3779b9u;
+        Key ^= Key >> 16; Key *= 0x85ebca6bu;
+        Key ^= Key >> 13; Key *= 0xc2b2ae35u;
+        Key ^= Key >> 16;
+        return Key;
+    }
+
+    static constexpr std::uint32_t SubmeshKey( int iMesh, int iMaterial ) noexcept
+    {
+        return (std::uint32_t(iMesh) << 16) | std::uint16_t(iMaterial);
+    }
+
+    //
+    // How the compiler packs submesh::m_BaseSortKey. Fields go from the most significant bits down,
+    // values that do not fit are clamped (hashes keep their low bits). The renderer and the compiler
+    // must use the same layout.
+    //
+    struct sort_key_layout
+    {
+        enum class field : std::uint8_t
+        { MATERIAL                          // Material index
+        , VERTEX_FORMAT                     // Hash of the stream layout
+        , SKINNED                           // 1 when the geometry has bone weights
+        , INDEX_WIDTH                       // 1 for 32 bit indices
+        , LOD                               // LOD level of the submesh
+        , ENUM_COUNT
+        };
+
+        struct entry
+        {
+            field               m_Field;
+            std::uint8_t        m_nBits;
+        };
+
+        using values = std::array<std::uint32_t, static_cast<int>(field::ENUM_COUNT)>;
+
+        constexpr std::uint32_t Pack( const values& Values ) const noexcept
+        {
+            std::uint32_t Key = 0;
+            for( int i = 0; i < m_nEntries; ++i )
+            {
+                const auto& E   = m_Entries[i];
+                const auto  Max = E.m_nBits >= 32 ? ~0u : ((1u << E.m_nBits) - 1);
+                const auto  V   = Values[static_cast<int>(E.m_Field)];
+                Key = (E.m_nBits >= 32 ? 0 : (Key << E.m_nBits)) | ( E.m_Field == field::VERTEX_FORMAT ? (V & Max) : std::min( V, Max ) );
+            }
+            return Key;
+        }
+
+        std::array<entry, static_cast<int>(field::ENUM_COUNT)>  m_Entries;
+        std::uint8_t                                            m_nEntries;
+    };
+
+    static constexpr sort_key_layout default_sort_key_layout_v
+    { .m_Entries  = {{ { sort_key_layout::field::MATERIAL,       16 }
+                     , { sort_key_layout::field::VERTEX_FORMAT,   8 }
+                     , { sort_key_layout::field::SKINNED,         1 }
+                     , { sort_key_layout::field::INDEX_WIDTH,     1 }
+                     , { sort_key_layout::field::LOD,             4 }
+                    }}
+    , .m_nEntries = 5
+    };
+
+    //
+    // Image format, the whole xgeom in one block of memory. The arrays follow the xgeom structure
+    // (each aligned to image_alignment_v) and the pointers are saved as offsets from the start of
+    // the image, so loading is just fixing the pointers. Images are only valid for the pointer size
+    // they were written with. Do not call Kill on an xgeom loaded from an image, use FreeImage instead.
+    //
+    static constexpr std::uint32_t  image_magic_v       = 0x4D494758;   // "XGIM"
+    static constexpr std::size_t    image_alignment_v   = 16;
+
+    struct image_header
+    {
+        std::uint32_t           m_Magic;
+        std::uint16_t           m_Version;
+        std::uint16_t           m_PointerSize;
+        std::uint64_t           m_ImageSize;
+    };
+
+    //
+    // Where LoadImage gets its memory from, a whole xgeom is a single allocation so streaming
+    // systems can hand out blocks from their own pools and unloading is a single free
+    //
+    struct allocator
+    {
+        virtual std::byte*      Alloc                   ( std::size_t Size, std::size_t Alignment ) noexcept = 0;
+        virtual void            Free                    ( std::byte* pData ) noexcept = 0;
+    };
+
+    struct heap_allocator final : allocator
+    {
+        std::byte*              Alloc                   ( std::size_t Size, [[maybe_unused]] std::size_t Alignment ) noexcept override { xassert( Alignment <= image_alignment_v ); return static_cast<std::byte*>( ::operator new( Size, std::align_val_t{image_alignment_v}, std::nothrow ) ); }
+        void                    Free                    ( std::byte* pData ) noexcept override { ::operator delete( pData, std::align_val_t{image_alignment_v} ); }
+    };
 
     //-------------------------------------------------------------------------
             
@@ -174,7 +420,17 @@ struct xgeom
     inline 
     int             findMeshIndex               ( const char* pName ) const noexcept;
     inline 
-    int             getSubMeshIndex             ( int iMesh, int iMaterial ) const noexcept;
+    int             getSubMeshIndex             ( int iMesh, int iMaterial ) const noexcept;     // LOD 0 submesh of the mesh that uses the material, -1 if none
+    inline
+    int             Lookup                      ( const lookup_table& Table, std::uint32_t Key ) const noexcept;
+    inline
+    bool            hasBVH                      ( void ) const noexcept;
+    inline
+    bool            RayCast                     ( int iLOD, const xcore::vector3d& From, const xcore::vector3d& Dir, float MaxT, ray_hit& Hit ) const noexcept;  // Closest hit in [0, MaxT], iLOD indexes m_pLOD
+    template< typename T_PROJECT, typename T_CALLBACK > inline
+    void            SelectClusters              ( int iDAG, float Threshold, T_PROJECT&& ProjectError, T_CALLBACK&& CallBack ) const noexcept;  // ProjectError( Sphere, Error ) to screen space, CallBack( const cluster& ) for the cut
+    template< typename T_CALLBACK > inline
+    void            QueryBox                    ( int iLOD, const xcore::bbox& Box, T_CALLBACK&& CallBack ) const noexcept;  // CallBack( const bvh_triangle& ) for the triangles whose bounds touch Box
     inline 
     void            Initialize                  ( void ) noexcept;
     inline
@@ -195,6 +451,43 @@ struct xgeom
     std::byte*      getStreamInfoData           ( int iStreamInfo ) noexcept;
     inline
     int             getStreamInfoStride         ( int iStreamInfo ) noexcept;
+    inline
+    std::size_t     getImageSize                ( void ) const noexcept;
+    inline
+    void            WriteImage                  ( std::byte* pImage ) const noexcept;
+    inline static
+    xgeom*          LoadImageInPlace            ( std::byte* pImage, std::size_t ImageSize ) noexcept;
+    template< typename T_READ > inline static
+    xgeom*          LoadImage                   ( T_READ&& Read, allocator& Allocator ) noexcept;
+    inline static
+    xgeom*          LoadImage                   ( const char* pFileName, allocator& Allocator ) noexcept;
+    inline static
+    void            FreeImage                   ( xgeom* pGeom, allocator& Allocator ) noexcept;
+
+    // Visits every dynamic array as (Pointer&, Count), shared by the image writer and loader
+    template< typename T_CALLBACK >
+    void            ForEachArray                ( T_CALLBACK&& CallBack ) noexcept
+    {
+        CallBack( m_pBone,      std::size_t(m_nBones)           );
+        CallBack( m_pMesh,      std::size_t(m_nMeshes)          );
+        CallBack( m_pSubMesh,   std::size_t(m_nSubMeshs)        );
+        CallBack( m_pLOD,       std::size_t(m_nLODs)            );
+        CallBack( m_pDList,     std::size_t(m_nDisplayLists)    );
+        CallBack( m_pData,      std::size_t(m_DataSize)         );
+        CallBack( m_pLookup,    std::size_t(m_nLookups)         );
+        CallBack( m_pInstance,  std::size_t(m_nInstances)       );
+        CallBack( m_pBVH,       std::size_t(m_nBVHs)            );
+        CallBack( m_pBVHNode,   std::size_t(m_nBVHNodes)        );
+        CallBack( m_pBVHTriangle, std::size_t(m_nBVHTriangles)  );
+        CallBack( m_pCollisionShape,  std::size_t(m_nCollisionShapes)       );
+        CallBack( m_pCollisionVertex, std::size_t(m_nCollisionVertices) * 3 );
+        CallBack( m_pCollisionIndex,  std::size_t(m_nCollisionIndices)      );
+        CallBack( m_pOccluder,        std::size_t(m_nOccluders)             );
+        CallBack( m_pOccluderVertex,  std::size_t(m_nOccluderVertices) * 3  );
+        CallBack( m_pOccluderIndex,   std::size_t(m_nOccluderIndices)       );
+        CallBack( m_pClusterDAG,      std::size_t(m_nClusterDAGs)           );
+        CallBack( m_pCluster,         std::size_t(m_nClusters)              );
+    }
 
     bone*                                           m_pBone;
     mesh*                                           m_pMesh;
@@ -202,8 +495,32 @@ struct xgeom
     lod*                                            m_pLOD;
     cmd*                                            m_pDList;
     std::byte*                                      m_pData;
+    std::uint16_t*                                  m_pLookup;
+    instance*                                       m_pInstance;
+    bvh*                                            m_pBVH;             // m_nLODs of them when built
+    bvh_node*                                       m_pBVHNode;
+    bvh_triangle*                                   m_pBVHTriangle;
+    std::uint32_t                                   m_nBVHNodes;
+    std::uint32_t                                   m_nBVHTriangles;
+    collision_shape*                                m_pCollisionShape;
+    float*                                          m_pCollisionVertex;
+    std::uint32_t*                                  m_pCollisionIndex;
+    std::uint32_t                                   m_nCollisionVertices;
+    std::uint32_t                                   m_nCollisionIndices;
+    occluder*                                       m_pOccluder;        // m_nMeshes of them when built
+    float*                                          m_pOccluderVertex;
+    std::uint16_t*                                  m_pOccluderIndex;
+    std::uint32_t                                   m_nOccluderVertices;
+    std::uint32_t                                   m_nOccluderIndices;
+    cluster_dag*                                    m_pClusterDAG;
+    cluster*                                        m_pCluster;
+    std::uint32_t                                   m_nClusters;
     std::uint32_t                                   m_DataSize;
+    std::uint32_t                                   m_nLookups;
+    lookup_table                                    m_MeshNameTable;
+    lookup_table                                    m_SubmeshTable;
     std::array<std::uint32_t, max_stream_count_v>   m_Stream;
+    std::array<std::uint8_t, max_stream_count_v>    m_StreamStride;     // Bytes per vertex (per index for stream 0)
     xcore::bbox                                     m_BBox;
     std::uint32_t                                   m_nIndices;
     std::uint32_t                                   m_nVertices;
@@ -213,11 +530,16 @@ struct xgeom
     std::uint16_t                                   m_nSubMeshs;
     std::uint16_t                                   m_nMaterials;
     std::uint16_t                                   m_nDisplayLists;
+    std::uint16_t                                   m_nInstances;
+    std::uint16_t                                   m_nBVHs;
+    std::uint16_t                                   m_nCollisionShapes;
+    std::uint16_t                                   m_nOccluders;
+    std::uint16_t                                   m_nClusterDAGs;
     stream_info::element_def                        m_StreamTypes;
     std::uint8_t                                    m_nStreams;
     std::uint8_t                                    m_nStreamInfos;
     std::uint8_t                                    m_CompactedVertexSize;
-    std::array<stream_info, max_stream_count_v>     m_StreamInfo;
+    std::array<stream_info, max_stream_info_count_v> m_StreamInfo;
 };
 
 //-------------------------------------------------------------------------
@@ -244,6 +566,19 @@ void xgeom::Kill(void) noexcept
     if (m_pLOD)     delete[] m_pLOD;
     if (m_pDList)   delete[] m_pDList;
     if( m_pData)    delete[] m_pData;
+    if( m_pLookup ) delete[] m_pLookup;
+    if( m_pInstance ) delete[] m_pInstance;
+    if( m_pBVH )    delete[] m_pBVH;
+    if( m_pBVHNode ) delete[] m_pBVHNode;
+    if( m_pBVHTriangle ) delete[] m_pBVHTriangle;
+    if( m_pCollisionShape )  delete[] m_pCollisionShape;
+    if( m_pCollisionVertex ) delete[] m_pCollisionVertex;
+    if( m_pCollisionIndex )  delete[] m_pCollisionIndex;
+    if( m_pOccluder )        delete[] m_pOccluder;
+    if( m_pOccluderVertex )  delete[] m_pOccluderVertex;
+    if( m_pOccluderIndex )   delete[] m_pOccluderIndex;
+    if( m_pClusterDAG )      delete[] m_pClusterDAG;
+    if( m_pCluster )         delete[] m_pCluster;
 }
 
 //-------------------------------------------------------------------------
@@ -255,10 +590,29 @@ void xgeom::Reset(void) noexcept
 }
 
 
+//-------------------------------------------------------------------------
+
+int xgeom::Lookup( const lookup_table& Table, std::uint32_t Key ) const noexcept
+{
+    if( Table.m_nSlots == 0 ) return -1;
+
+    const auto pData = &m_pLookup[Table.m_iData];
+    const auto Seed  = pData[ HashMix( Key, 0 ) & (Table.m_nBuckets - 1) ];
+    const auto Value = pData[ Table.m_nBuckets + (HashMix( Key, Seed ) & (Table.m_nSlots - 1)) ];
+    return Value == lookup_empty_v ? -1 : int(Value);
+}
+
 //-------------------------------------------------------------------------
 
 int xgeom::findMeshIndex( const char* pName ) const noexcept
 {
+    if( m_MeshNameTable.m_nSlots )
+    {
+        // The table only tells us which mesh it could be
+        const auto i = Lookup( m_MeshNameTable, HashName(pName) );
+        return ( i >= 0 && !std::strcmp( m_pMesh[i].m_Name.data(), pName ) ) ? i : -1;
+    }
+
     for ( auto i = 0u; i < m_nMeshes; i++ )
     {
         if ( !std::strcmp(m_pMesh[i].m_Name.data(), pName) )
@@ -272,50 +626,233 @@ int xgeom::findMeshIndex( const char* pName ) const noexcept
 
 //-------------------------------------------------------------------------
 
-bool xgeom::isStreamBased(void) const noexcept 
-{ 
-    return !m_CompactedVertexSize; 
+int xgeom::getSubMeshIndex( int iMesh, int iMaterial ) const noexcept
+{
+    xassert( iMesh >= 0 && iMesh < m_nMeshes );
+    const auto& LOD = m_pLOD[ m_pMesh[iMesh].m_iLOD ];
+
+    if( m_SubmeshTable.m_nSlots )
+    {
+        const auto i = Lookup( m_SubmeshTable, SubmeshKey( iMesh, iMaterial ) );
+        return ( i >= LOD.m_iSubmesh && i < LOD.m_iSubmesh + LOD.m_nSubmesh && m_pSubMesh[i].m_iMaterial == iMaterial ) ? i : -1;
+    }
+
+    for( int i = LOD.m_iSubmesh; i < LOD.m_iSubmesh + LOD.m_nSubmesh; ++i )
+    {
+        if( m_pSubMesh[i].m_iMaterial == iMaterial ) return i;
+    }
+
+    return -1;
 }
 
 //-------------------------------------------------------------------------
 
-bool xgeom::hasSeparatedPositions(void) const noexcept 
-{ 
-    return isStreamBased() || (isStreamBased() == false && m_nStreams == 3); 
+bool xgeom::hasBVH( void ) const noexcept
+{
+    return m_nBVHs != 0;
 }
 
 //-------------------------------------------------------------------------
+// Nearest first traversal, children are pushed far to near so the closest one is visited next and
+// whatever is behind the current hit gets culled when popped. Möller-Trumbore for the triangles.
 
-int xgeom::getVertexSize(int iStream)  const noexcept
+bool xgeom::RayCast( int iLOD, const xcore::vector3d& From, const xcore::vector3d& Dir, float MaxT, ray_hit& Hit ) const noexcept
 {
-    xassert(iStream < m_nStreams);
-    if (m_CompactedVertexSize)
+    xassert( iLOD >= 0 && iLOD < m_nLODs );
+    if( m_nBVHs == 0 || m_pBVH[iLOD].m_nNodes == 0 ) return false;
+
+    const std::array<float, 3> O   { From.m_X, From.m_Y, From.m_Z };
+    const std::array<float, 3> D   { Dir.m_X,  Dir.m_Y,  Dir.m_Z  };
+    const std::array<float, 3> InvD{ 1.0f / D[0], 1.0f / D[1], 1.0f / D[2] };
+
+    struct entry { std::uint32_t m_Child; float m_TEnter; };
+    std::array<entry, bvh_stack_size_v> Stack;
+    int                                 nStack = 0;
+    float                               BestT  = MaxT;
+    bool                                bHit   = false;
+
+    auto TestLeaf = [&]( std::uint32_t Child )
     {
-        if (m_nStreams == 3)
+        const auto iFirst = Child & ((1u << bvh_leaf_count_shift_v) - 1);
+        const auto nTris  = (Child & ~bvh_leaf_bit_v) >> bvh_leaf_count_shift_v;
+        for( auto i = iFirst; i < iFirst + nTris; ++i )
         {
-            if (iStream == 1) return m_StreamInfo[iStream].getSize();
-            return m_CompactedVertexSize;
+            const auto& T = m_pBVHTriangle[i];
+            const std::array<float, 3> P{ D[1]*T.m_Edge2[2] - D[2]*T.m_Edge2[1], D[2]*T.m_Edge2[0] - D[0]*T.m_Edge2[2], D[0]*T.m_Edge2[1] - D[1]*T.m_Edge2[0] };
+            const float Det = T.m_Edge1[0]*P[0] + T.m_Edge1[1]*P[1] + T.m_Edge1[2]*P[2];
+            if( std::abs(Det) < 1e-12f ) continue;
+
+            const float InvDet = 1.0f / Det;
+            const std::array<float, 3> S{ O[0] - T.m_V0[0], O[1] - T.m_V0[1], O[2] - T.m_V0[2] };
+            const float U = (S[0]*P[0] + S[1]*P[1] + S[2]*P[2]) * InvDet;
+            if( U < 0 || U > 1 ) continue;
+
+            const std::array<float, 3> Q{ S[1]*T.m_Edge1[2] - S[2]*T.m_Edge1[1], S[2]*T.m_Edge1[0] - S[0]*T.m_Edge1[2], S[0]*T.m_Edge1[1] - S[1]*T.m_Edge1[0] };
+            const float V = (D[0]*Q[0] + D[1]*Q[1] + D[2]*Q[2]) * InvDet;
+            if( V < 0 || U + V > 1 ) continue;
+
+            const float HitT = (T.m_Edge2[0]*Q[0] + T.m_Edge2[1]*Q[1] + T.m_Edge2[2]*Q[2]) * InvDet;
+            if( HitT < 0 || HitT > BestT ) continue;
+
+            BestT = HitT;
+            bHit  = true;
+            Hit   = ray_hit{ .m_T = HitT, .m_U = U, .m_V = V, .m_iIndex = T.m_iIndex };
         }
-        else
+    };
+
+    Stack[nStack++] = entry{ m_pBVH[iLOD].m_iRoot, 0.0f };
+    while( nStack )
+    {
+        const auto E = Stack[--nStack];
+        if( E.m_TEnter > BestT ) continue;
+
+        const auto& Node = m_pBVHNode[E.m_Child];
+
+        // Slab test of the 4 children, written lane by lane so it vectorizes
+        std::array<float, 4> TEnter, TExit;
+        for( int l = 0; l < 4; ++l )
         {
-            xassert(m_nStreams == 2);
-            return m_CompactedVertexSize;
+            const float X0 = (Node.m_MinX[l] - O[0]) * InvD[0], X1 = (Node.m_MaxX[l] - O[0]) * InvD[0];
+            const float Y0 = (Node.m_MinY[l] - O[1]) * InvD[1], Y1 = (Node.m_MaxY[l] - O[1]) * InvD[1];
+            const float Z0 = (Node.m_MinZ[l] - O[2]) * InvD[2], Z1 = (Node.m_MaxZ[l] - O[2]) * InvD[2];
+            TEnter[l] = std::max( std::max( std::min(X0, X1), std::min(Y0, Y1) ), std::max( std::min(Z0, Z1), 0.0f ) );
+            TExit[l]  = std::min( std::min( std::max(X0, X1), std::max(Y0, Y1) ), std::min( std::max(Z0, Z1), BestT ) );
+        }
+
+        // Hit lanes sorted near to far (at most 4, insertion sort)
+        std::array<int, 4> Order;
+        int                nHits = 0;
+        for( int l = 0; l < 4; ++l )
+        {
+            if( TEnter[l] > TExit[l] || Node.m_Child[l] == bvh_empty_v ) continue;
+
+            int i = nHits++;
+            while( i && TEnter[Order[i - 1]] > TEnter[l] ) { Order[i] = Order[i - 1]; --i; }
+            Order[i] = l;
+        }
+
+        for( int i = nHits - 1; i >= 0; --i )
+        {
+            const auto Child = Node.m_Child[Order[i]];
+            if( Child & bvh_leaf_bit_v ) TestLeaf( Child );
+            else
+            {
+                xassert( nStack < bvh_stack_size_v );
+                Stack[nStack++] = entry{ Child, TEnter[Order[i]] };
+            }
         }
     }
-    else
+
+    return bHit;
+}
+
+//-------------------------------------------------------------------------
+// Each cluster decides on its own, the errors only grow going up the DAG so the clusters picked always
+// form one complete surface. Both spheres of a cluster are shared by its whole group, so the group
+// switches levels at once.
+
+template< typename T_PROJECT, typename T_CALLBACK >
+void xgeom::SelectClusters( int iDAG, float Threshold, T_PROJECT&& ProjectError, T_CALLBACK&& CallBack ) const noexcept
+{
+    xassert( iDAG >= 0 && iDAG < m_nClusterDAGs );
+    const auto& DAG = m_pClusterDAG[iDAG];
+
+    for( auto i = DAG.m_iCluster; i < DAG.m_iCluster + DAG.m_nClusters; ++i )
+    {
+        const auto& C = m_pCluster[i];
+        if( C.m_Level && ProjectError( C.m_Bounds, C.m_Error ) > Threshold ) continue;
+        if( C.m_ParentError != std::numeric_limits<float>::max() && ProjectError( C.m_ParentBounds, C.m_ParentError ) <= Threshold ) continue;
+        CallBack( C );
+    }
+}
+
+//-------------------------------------------------------------------------
+
+template< typename T_CALLBACK >
+void xgeom::QueryBox( int iLOD, const xcore::bbox& Box, T_CALLBACK&& CallBack ) const noexcept
+{
+    xassert( iLOD >= 0 && iLOD < m_nLODs );
+    if( m_nBVHs == 0 || m_pBVH[iLOD].m_nNodes == 0 ) return;
+
+    const std::array<float, 3> BMin{ Box.m_Min.m_X, Box.m_Min.m_Y, Box.m_Min.m_Z };
+    const std::array<float, 3> BMax{ Box.m_Max.m_X, Box.m_Max.m_Y, Box.m_Max.m_Z };
+
+    std::array<std::uint32_t, bvh_stack_size_v> Stack;
+    int                                          nStack = 0;
+
+    Stack[nStack++] = m_pBVH[iLOD].m_iRoot;
+    while( nStack )
     {
-        return m_StreamInfo[iStream].getSize();
+        const auto& Node = m_pBVHNode[ Stack[--nStack] ];
+        for( int l = 0; l < 4; ++l )
+        {
+            if( Node.m_MinX[l] > BMax[0] || Node.m_MaxX[l] < BMin[0]
+             || Node.m_MinY[l] > BMax[1] || Node.m_MaxY[l] < BMin[1]
+             || Node.m_MinZ[l] > BMax[2] || Node.m_MaxZ[l] < BMin[2] ) continue;
+
+            const auto Child = Node.m_Child[l];
+            if( (Child & bvh_leaf_bit_v) == 0 )
+            {
+                xassert( nStack < bvh_stack_size_v );
+                Stack[nStack++] = Child;
+                continue;
+            }
+
+            const auto iFirst = Child & ((1u << bvh_leaf_count_shift_v) - 1);
+            const auto nTris  = (Child & ~bvh_leaf_bit_v) >> bvh_leaf_count_shift_v;
+            for( auto i = iFirst; i < iFirst + nTris; ++i )
+            {
+                const auto& T = m_pBVHTriangle[i];
+                bool bOverlap = true;
+                for( int a = 0; bOverlap && a < 3; ++a )
+                {
+                    const float V1 = T.m_V0[a] + T.m_Edge1[a], V2 = T.m_V0[a] + T.m_Edge2[a];
+                    bOverlap = std::min( { T.m_V0[a], V1, V2 } ) <= BMax[a] && std::max( { T.m_V0[a], V1, V2 } ) >= BMin[a];
+                }
+                if( bOverlap ) CallBack( T );
+            }
+        }
     }
 }
 
 //-------------------------------------------------------------------------
 
+bool xgeom::isStreamBased(void) const noexcept 
+{ 
+    return !m_CompactedVertexSize; 
+}
+
+//-------------------------------------------------------------------------
+
+bool xgeom::hasSeparatedPositions(void) const noexcept 
+{ 
+    // Some stream has the positions and nothing else (stream groups can put them in more than one)
+    for( int i = 1; i < m_nStreamInfos; ++i )
+    {
+        if( m_StreamInfo[i].m_ElementsType.m_bPosition == false ) continue;
+
+        bool bAlone = true;
+        for( int j = 1; bAlone && j < m_nStreamInfos; ++j )
+            bAlone = j == i || m_StreamInfo[j].m_iStream != m_StreamInfo[i].m_iStream;
+        if( bAlone ) return true;
+    }
+    return false;
+}
+
+//-------------------------------------------------------------------------
+
+int xgeom::getVertexSize(int iStream)  const noexcept
+{
+    xassert(iStream < m_nStreams);
+    return m_StreamStride[iStream];
+}
+
+//-------------------------------------------------------------------------
+
 std::uint32_t xgeom::getStreamSize(int iStream) const noexcept
 {
     xassert(iStream < m_nStreams);
-    if (iStream == 0 || isStreamBased()) return m_StreamInfo[iStream].getSize() * (iStream == 0 ? m_nIndices : m_nVertices);
-    if (m_nStreams == 3) return m_nVertices * ((iStream == 1) ? m_StreamInfo[1].getSize() : static_cast<std::uint32_t>(m_CompactedVertexSize));
-    return static_cast<std::uint32_t>(m_CompactedVertexSize) * m_nVertices;
+    return static_cast<std::uint32_t>(m_StreamStride[iStream]) * (iStream == 0 ? m_nIndices : m_nVertices);
 }
 
 //-------------------------------------------------------------------------
@@ -338,9 +875,131 @@ std::byte* xgeom::getStreamInfoData(int iStreamInfo) noexcept
 
 int xgeom::getStreamInfoStride(int iStreamInfo) noexcept
 {
-    if (iStreamInfo == 0 || isStreamBased()) return m_StreamInfo[iStreamInfo].getSize();
-    if (m_nStreams == 3) return (iStreamInfo == 1) ? m_StreamInfo[1].getSize() : static_cast<std::uint32_t>(m_CompactedVertexSize);
-    return static_cast<std::uint32_t>(m_CompactedVertexSize);
+    xassert(iStreamInfo < m_nStreamInfos);
+    return m_StreamStride[m_StreamInfo[iStreamInfo].m_iStream];
+}
+
+//-------------------------------------------------------------------------
+
+std::size_t xgeom::getImageSize( void ) const noexcept
+{
+    std::size_t Size = xcore::bits::Align( sizeof(image_header), image_alignment_v ) + xcore::bits::Align( sizeof(xgeom), image_alignment_v );
+
+    auto Copy = *this;
+    Copy.ForEachArray( [&]( auto*& p, std::size_t Count )
+    {
+        Size += xcore::bits::Align( sizeof(*p) * Count, image_alignment_v );
+    });
+
+    return Size;
+}
+
+//-------------------------------------------------------------------------
+
+void xgeom::WriteImage( std::byte* pImage ) const noexcept
+{
+    const auto ImageSize = getImageSize();
+    std::memset( pImage, 0, ImageSize );
+
+    auto& Header = *reinterpret_cast<image_header*>(pImage);
+    Header.m_Magic          = image_magic_v;
+    Header.m_Version        = VERSION;
+    Header.m_PointerSize    = sizeof(void*);
+    Header.m_ImageSize      = ImageSize;
+
+    const auto  GeomOffset = xcore::bits::Align( sizeof(image_header), image_alignment_v );
+    std::size_t Offset     = GeomOffset + xcore::bits::Align( sizeof(xgeom), image_alignment_v );
+
+    auto Copy = *this;
+    Copy.ForEachArray( [&]( auto*& p, std::size_t Count )
+    {
+        using t = std::remove_reference_t<decltype(*p)>;
+        const auto Bytes = sizeof(t) * Count;
+
+        if( Bytes ) std::memcpy( pImage + Offset, p, Bytes );
+        p       = reinterpret_cast<t*>( Bytes ? Offset : 0 );
+        Offset += xcore::bits::Align( Bytes, image_alignment_v );
+    });
+
+    std::memcpy( pImage + GeomOffset, &Copy, sizeof(xgeom) );
+}
+
+//-------------------------------------------------------------------------
+
+xgeom* xgeom::LoadImageInPlace( std::byte* pImage, std::size_t ImageSize ) noexcept
+{
+    xassert( (reinterpret_cast<std::uintptr_t>(pImage) % image_alignment_v) == 0 );
+
+    const auto GeomOffset = xcore::bits::Align( sizeof(image_header), image_alignment_v );
+    if( ImageSize < GeomOffset + sizeof(xgeom) ) return nullptr;
+
+    auto& Header = *reinterpret_cast<const image_header*>(pImage);
+    if( Header.m_Magic          != image_magic_v
+     || Header.m_Version        != VERSION
+     || Header.m_PointerSize    != sizeof(void*)
+     || Header.m_ImageSize      >  ImageSize ) return nullptr;
+
+    auto pGeom  = reinterpret_cast<xgeom*>( pImage + GeomOffset );
+    bool bValid = true;
+    pGeom->ForEachArray( [&]( auto*& p, std::size_t Count )
+    {
+        using t = std::remove_reference_t<decltype(*p)>;
+        const auto Offset = reinterpret_cast<std::uintptr_t>(p);
+
+        if( Offset + sizeof(t) * Count > Header.m_ImageSize ) { bValid = false; p = nullptr; return; }
+        p = Offset ? reinterpret_cast<t*>( pImage + Offset ) : nullptr;
+    });
+
+    return bValid ? pGeom : nullptr;
+}
+
+//-------------------------------------------------------------------------
+// Read( void* pDestination, std::size_t Size ) -> bool, reads the next Size bytes of the image
+
+template< typename T_READ >
+xgeom* xgeom::LoadImage( T_READ&& Read, allocator& Allocator ) noexcept
+{
+    image_header Header;
+    if( !Read( &Header, sizeof(Header) ) ) return nullptr;
+    if( Header.m_Magic != image_magic_v || Header.m_ImageSize < sizeof(Header) ) return nullptr;
+
+    // One allocation for the whole thing, sized by the header
+    auto pImage = Allocator.Alloc( static_cast<std::size_t>(Header.m_ImageSize), image_alignment_v );
+    if( pImage == nullptr ) return nullptr;
+
+    std::memcpy( pImage, &Header, sizeof(Header) );
+    if( Read( pImage + sizeof(Header), static_cast<std::size_t>(Header.m_ImageSize) - sizeof(Header) ) )
+    {
+        if( auto pGeom = LoadImageInPlace( pImage, static_cast<std::size_t>(Header.m_ImageSize) ); pGeom ) return pGeom;
+    }
+
+    Allocator.Free( pImage );
+    return nullptr;
+}
+
+//-------------------------------------------------------------------------
+
+xgeom* xgeom::LoadImage( const char* pFileName, allocator& Allocator ) noexcept
+{
+    std::FILE* pFile = std::fopen( pFileName, "rb" );
+    if( pFile == nullptr ) return nullptr;
+
+    auto pGeom = LoadImage( [&]( void* pDestination, std::size_t Size )
+    {
+        return std::fread( pDestination, 1, Size, pFile ) == Size;
+    }, Allocator );
+
+    std::fclose( pFile );
+    return pGeom;
+}
+
+//-------------------------------------------------------------------------
+// The xgeom sits at a fixed offset inside its image, so this is a single free
+
+void xgeom::FreeImage( xgeom* pGeom, allocator& Allocator ) noexcept
+{
+    if( pGeom == nullptr ) return;
+    Allocator.Free( reinterpret_cast<std::byte*>(pGeom) - xcore::bits::Align( sizeof(image_header), image_alignment_v ) );
 }
 
 //-------------------------------------------------------------------------
@@ -410,17 +1069,155 @@ namespace xcore::serializer::io_functions
 
     //-------------------------------------------------------------------------
 
+    template<>
+    xcore::err SerializeIO<xgeom::instance>(xcore::serializer::stream& Stream, const xgeom::instance& Instance ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(Instance.m_Name          ))
+        || (Err = Stream.Serialize(Instance.m_Transform     ))
+        || (Err = Stream.Serialize(Instance.m_iMesh         ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xgeom::collision_shape>(xcore::serializer::stream& Stream, const xgeom::collision_shape& Shape ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(Shape.m_iVertex          ))
+        || (Err = Stream.Serialize(Shape.m_nVertices        ))
+        || (Err = Stream.Serialize(Shape.m_iIndex           ))
+        || (Err = Stream.Serialize(Shape.m_nIndices         ))
+        || (Err = Stream.Serialize(Shape.m_iMesh            ))
+        || (Err = Stream.Serialize(Shape.m_Type             ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xgeom::occluder>(xcore::serializer::stream& Stream, const xgeom::occluder& Occluder ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(Occluder.m_iVertex       ))
+        || (Err = Stream.Serialize(Occluder.m_iIndex        ))
+        || (Err = Stream.Serialize(Occluder.m_nVertices     ))
+        || (Err = Stream.Serialize(Occluder.m_nIndices      ))
+        || (Err = Stream.Serialize(Occluder.m_Flags         ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xgeom::cluster>(xcore::serializer::stream& Stream, const xgeom::cluster& Cluster ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(Cluster.m_Bounds        ))
+        || (Err = Stream.Serialize(Cluster.m_ParentBounds  ))
+        || (Err = Stream.Serialize(Cluster.m_Error         ))
+        || (Err = Stream.Serialize(Cluster.m_ParentError   ))
+        || (Err = Stream.Serialize(Cluster.m_iIndex        ))
+        || (Err = Stream.Serialize(Cluster.m_nIndices      ))
+        || (Err = Stream.Serialize(Cluster.m_Level         ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xgeom::cluster_dag>(xcore::serializer::stream& Stream, const xgeom::cluster_dag& DAG ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(DAG.m_iCluster          ))
+        || (Err = Stream.Serialize(DAG.m_nClusters         ))
+        || (Err = Stream.Serialize(DAG.m_iSubmesh          ))
+        || (Err = Stream.Serialize(DAG.m_nLevels           ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xgeom::bvh>(xcore::serializer::stream& Stream, const xgeom::bvh& BVH ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(BVH.m_iRoot              ))
+        || (Err = Stream.Serialize(BVH.m_nNodes             ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xgeom::bvh_node>(xcore::serializer::stream& Stream, const xgeom::bvh_node& Node ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(Node.m_MinX              ))
+        || (Err = Stream.Serialize(Node.m_MinY              ))
+        || (Err = Stream.Serialize(Node.m_MinZ              ))
+        || (Err = Stream.Serialize(Node.m_MaxX              ))
+        || (Err = Stream.Serialize(Node.m_MaxY              ))
+        || (Err = Stream.Serialize(Node.m_MaxZ              ))
+        || (Err = Stream.Serialize(Node.m_Child             ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
+    template<>
+    xcore::err SerializeIO<xgeom::bvh_triangle>(xcore::serializer::stream& Stream, const xgeom::bvh_triangle& Triangle ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize(Triangle.m_V0            ))
+        || (Err = Stream.Serialize(Triangle.m_Edge1         ))
+        || (Err = Stream.Serialize(Triangle.m_Edge2         ))
+        || (Err = Stream.Serialize(Triangle.m_iIndex        ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
     template<>
     xcore::err SerializeIO<xgeom::submesh>(xcore::serializer::stream& Stream, const xgeom::submesh& Submesh ) noexcept
     {
         xcore::err Err;
         false
+        || (Err = Stream.Serialize(Submesh.m_BBox.m_Min.m_X   ))
+        || (Err = Stream.Serialize(Submesh.m_BBox.m_Min.m_Y   ))
+        || (Err = Stream.Serialize(Submesh.m_BBox.m_Min.m_Z   ))
+        || (Err = Stream.Serialize(Submesh.m_BBox.m_Max.m_X   ))
+        || (Err = Stream.Serialize(Submesh.m_BBox.m_Max.m_Y   ))
+        || (Err = Stream.Serialize(Submesh.m_BBox.m_Max.m_Z   ))
+        || (Err = Stream.Serialize(Submesh.m_SphereCenter.m_X ))
+        || (Err = Stream.Serialize(Submesh.m_SphereCenter.m_Y ))
+        || (Err = Stream.Serialize(Submesh.m_SphereCenter.m_Z ))
+        || (Err = Stream.Serialize(Submesh.m_SphereRadius     ))
         || (Err = Stream.Serialize(Submesh.m_BaseSortKey ))
         || (Err = Stream.Serialize(Submesh.m_iIndex      ))
         || (Err = Stream.Serialize(Submesh.m_nIndices    ))
         || (Err = Stream.Serialize(Submesh.m_iDList      ))
         || (Err = Stream.Serialize(Submesh.m_nDLists     ))
         || (Err = Stream.Serialize(Submesh.m_iMaterial   ))
+        || (Err = Stream.Serialize(Submesh.m_nWeights    ))
+        || (Err = Stream.Serialize(Submesh.m_Topology    ))
         ;
         return Err;
     }
@@ -456,6 +1253,20 @@ namespace xcore::serializer::io_functions
 
     //-------------------------------------------------------------------------
 
+    template<>
+    xcore::err SerializeIO<xgeom::lookup_table>(xcore::serializer::stream& Stream, const xgeom::lookup_table& Table ) noexcept
+    {
+        xcore::err Err;
+        false
+        || (Err = Stream.Serialize( Table.m_iData       ))
+        || (Err = Stream.Serialize( Table.m_nBuckets    ))
+        || (Err = Stream.Serialize( Table.m_nSlots      ))
+        ;
+        return Err;
+    }
+
+    //-------------------------------------------------------------------------
+
     template<>
     xcore::err SerializeIO<xgeom>(xcore::serializer::stream& Stream, const xgeom& Geom ) noexcept
     {
@@ -469,6 +1280,7 @@ namespace xcore::serializer::io_functions
         || (Err = Stream.Serialize( Geom.m_pData,    Geom.m_DataSize, mem_type::Flags(mem_type::flags::UNIQUE)))
         || (Err = Stream.Serialize( Geom.m_DataSize             ))
         || (Err = Stream.Serialize( Geom.m_Stream               ))
+        || (Err = Stream.Serialize( Geom.m_StreamStride         ))
         || (Err = Stream.Serialize( Geom.m_BBox.m_Min.m_X       ))
         || (Err = Stream.Serialize( Geom.m_BBox.m_Min.m_Y       ))
         || (Err = Stream.Serialize( Geom.m_BBox.m_Max.m_X       ))
@@ -485,6 +1297,34 @@ namespace xcore::serializer::io_functions
         || (Err = Stream.Serialize( Geom.m_nStreamInfos         ))
         || (Err = Stream.Serialize( Geom.m_CompactedVertexSize  ))
         || (Err = Stream.Serialize( Geom.m_StreamInfo           ))
+        || (Err = Stream.Serialize( Geom.m_pLookup,  Geom.m_nLookups        ))
+        || (Err = Stream.Serialize( Geom.m_nLookups             ))
+        || (Err = Stream.Serialize( Geom.m_MeshNameTable        ))
+        || (Err = Stream.Serialize( Geom.m_SubmeshTable         ))
+        || (Err = Stream.Serialize( Geom.m_pInstance, Geom.m_nInstances     ))
+        || (Err = Stream.Serialize( Geom.m_nInstances           ))
+        || (Err = Stream.Serialize( Geom.m_pBVH,     Geom.m_nBVHs           ))
+        || (Err = Stream.Serialize( Geom.m_nBVHs                ))
+        || (Err = Stream.Serialize( Geom.m_pBVHNode, Geom.m_nBVHNodes       ))
+        || (Err = Stream.Serialize( Geom.m_nBVHNodes            ))
+        || (Err = Stream.Serialize( Geom.m_pBVHTriangle, Geom.m_nBVHTriangles ))
+        || (Err = Stream.Serialize( Geom.m_nBVHTriangles        ))
+        || (Err = Stream.Serialize( Geom.m_pCollisionShape,  Geom.m_nCollisionShapes ))
+        || (Err = Stream.Serialize( Geom.m_nCollisionShapes     ))
+        || (Err = Stream.Serialize( Geom.m_pCollisionVertex, std::size_t(Geom.m_nCollisionVertices) * 3 ))
+        || (Err = Stream.Serialize( Geom.m_nCollisionVertices   ))
+        || (Err = Stream.Serialize( Geom.m_pCollisionIndex,  Geom.m_nCollisionIndices ))
+        || (Err = Stream.Serialize( Geom.m_nCollisionIndices    ))
+        || (Err = Stream.Serialize( Geom.m_pOccluder,        Geom.m_nOccluders ))
+        || (Err = Stream.Serialize( Geom.m_nOccluders           ))
+        || (Err = Stream.Serialize( Geom.m_pOccluderVertex,  std::size_t(Geom.m_nOccluderVertices) * 3 ))
+        || (Err = Stream.Serialize( Geom.m_nOccluderVertices    ))
+        || (Err = Stream.Serialize( Geom.m_pOccluderIndex,   Geom.m_nOccluderIndices ))
+        || (Err = Stream.Serialize( Geom.m_nOccluderIndices     ))
+        || (Err = Stream.Serialize( Geom.m_pClusterDAG,      Geom.m_nClusterDAGs ))
+        || (Err = Stream.Serialize( Geom.m_nClusterDAGs         ))
+        || (Err = Stream.Serialize( Geom.m_pCluster,         Geom.m_nClusters ))
+        || (Err = Stream.Serialize( Geom.m_nClusters            ))
         ;
         return Err;
     }